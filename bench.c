@@ -0,0 +1,359 @@
+/*
+ * This file is part of FuzzyLibrary thats implements common fuzzy system.
+ * Copyright (C) 2014, Petr Kačer <kacerpetr@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief Micro benchmark of fzzlib library
+ * Every configuration prints one JSON object per line for every stage
+ * (fuzzify, infer, defuzzify), for whole output calculation (total) and
+ * for incremental calculation when only the first input changes (update),
+ * scaling of parallel batch calculation is reported for increasing 
+ * number of threads (stage batch); usage: bench [max threads]
+ */
+
+///////////////////////////////////////////////////
+//////// Includes /////////////////////////////////
+///////////////////////////////////////////////////
+
+#define _POSIX_C_SOURCE 199309L
+#include "fzzlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+///////////////////////////////////////////////////
+//////// Defines //////////////////////////////////
+///////////////////////////////////////////////////
+
+#define SAMPLES 20000
+#define WARMUP 1000
+#define BATCH 200000
+
+///////////////////////////////////////////////////
+//////// Data types ///////////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Benchmarked fuzzy system configuration
+ */
+typedef struct{
+    int inputs;
+    int sets;
+    int rules;
+    TDefuzzMethod defuzz;
+}TBenchConfig;
+
+///////////////////////////////////////////////////
+//////// Global variables /////////////////////////
+///////////////////////////////////////////////////
+
+//pseudo random generator state
+unsigned int benchSeed = 12345;
+
+//names of defuzzification methods (indexed by TDefuzzMethod)
+const char* benchDefuzzNames[] = {"cog_step", "cog_exact", "mom", "bisector", "weighted_average"};
+
+//prevents calculation from being optimized out
+volatile double benchSink = 0;
+
+///////////////////////////////////////////////////
+//////// Functions ////////////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Deterministic pseudo random number generator
+ * @return number in range <0, 1)
+ */
+double benchRandom(){
+    benchSeed = benchSeed*1103515245u + 12345u;
+    return (double)((benchSeed >> 8) & 0xFFFFFF) / 16777216.0;
+}
+
+/**
+ * @brief Monotonic time
+ * @return time in nanoseconds
+ */
+long long benchNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+/**
+ * @brief Compares two times, used for sorting
+ */
+int benchCompare(const void* a, const void* b){
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Creates fuzzy system of given configuration
+ * Inputs are uniformly partitioned on <0, 1> by triangles, output has
+ * 7 fuzzy sets, rules have random antecedent over all inputs
+ * @param cfg system configuration
+ * @return created fuzzy system
+ */
+TFzzSystem* benchCreate(const TBenchConfig* cfg){
+    TFzzSystem* sys = fzz_create(cfg->inputs, 1);
+    char name[32];
+    char rule[1024];
+    double step = 1.0 / (cfg->sets - 1);
+    int len = 0;
+    int i = 0;
+    int j = 0;
+
+    //inputs
+    for(i = 0; i < cfg->inputs; i++){
+        sprintf(name, "in%d", i);
+        fzz_initInputFcnsEx(sys, i, cfg->sets, name);
+        for(j = 0; j < cfg->sets; j++){
+            sprintf(name, "s%d", j);
+            fzz_setInputFcnEx(sys, j, i, (j-1)*step, j*step, (j+1)*step, name);
+        }
+    }
+
+    //output
+    fzz_initOutputFcnsEx(sys, 0, 7, "out");
+    for(j = 0; j < 7; j++){
+        sprintf(name, "o%d", j);
+        fzz_setOutputFcnEx(sys, j, 0, (j-1)/6.0, j/6.0, (j+1)/6.0, name);
+    }
+    fzz_setDefuzzMethodEx(sys, 0, cfg->defuzz);
+
+    //rules
+    for(i = 0; i < cfg->rules; i++){
+        len = sprintf(rule, "if");
+        for(j = 0; j < cfg->inputs; j++)
+            len += sprintf(rule + len, "%s in%d is s%d", j == 0 ? "" : " and", j, (int)(benchRandom()*cfg->sets));
+        sprintf(rule + len, " then out is o%d", (int)(benchRandom()*7));
+        fzz_addRuleEx(sys, rule);
+    }
+
+    return sys;
+}
+
+/**
+ * @brief Prints statistics of measured times as JSON line
+ * @param cfg system configuration
+ * @param stage name of measured stage
+ * @param times measured times in nanoseconds (sorted by this function)
+ * @param count number of measured times
+ */
+void benchReport(const TBenchConfig* cfg, const char* stage, long long* times, int count){
+    long long sum = 0;
+    double mean = 0;
+    int i = 0;
+
+    qsort(times, count, sizeof(long long), benchCompare);
+    for(i = 0; i < count; i++) sum += times[i];
+    mean = (double)sum / count;
+
+    printf("{\"inputs\":%d,\"sets\":%d,\"rules\":%d,\"defuzz\":\"%s\",\"stage\":\"%s\","
+           "\"evals\":%d,\"ns_per_eval\":%.1f,\"evals_per_sec\":%.0f,"
+           "\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld}\n",
+        cfg->inputs, cfg->sets, cfg->rules,
+        benchDefuzzNames[cfg->defuzz],
+        stage, count, mean, mean > 0 ? 1e9 / mean : 0.0,
+        times[count/2], times[count*9/10], times[count*99/100], times[count-1]
+    );
+}
+
+/**
+ * @brief Benchmarks one configuration
+ * Stages and whole calculation are measured separately for every sample
+ * @param cfg system configuration
+ */
+void benchRun(const TBenchConfig* cfg){
+    TFzzSystem* sys = benchCreate(cfg);
+    TFzzContext* ctx = fzz_createContext(sys);
+    double* inputs = (double*)malloc(sizeof(double)*SAMPLES*cfg->inputs);
+    long long* fuzzify = (long long*)malloc(sizeof(long long)*SAMPLES);
+    long long* infer = (long long*)malloc(sizeof(long long)*SAMPLES);
+    long long* defuzzify = (long long*)malloc(sizeof(long long)*SAMPLES);
+    long long* total = (long long*)malloc(sizeof(long long)*SAMPLES);
+    long long* update = (long long*)malloc(sizeof(long long)*SAMPLES);
+    double* last = (double*)malloc(sizeof(double)*cfg->inputs);
+    const double* input = NULL;
+    double output = 0;
+    long long t0 = 0;
+    long long t1 = 0;
+    long long t2 = 0;
+    long long t3 = 0;
+    int i = 0;
+
+    //random input vectors
+    for(i = 0; i < SAMPLES*cfg->inputs; i++) inputs[i] = benchRandom();
+
+    //warm up of caches
+    for(i = 0; i < WARMUP; i++){
+        fzz_calculateOutputEx(sys, ctx, inputs + (i % SAMPLES)*cfg->inputs, &output);
+        benchSink += output;
+    }
+
+    //stages
+    for(i = 0; i < SAMPLES; i++){
+        input = inputs + i*cfg->inputs;
+        t0 = benchNow();
+        fzz_fuzzifyEx(sys, ctx, input);
+        t1 = benchNow();
+        fzz_inferEx(sys, ctx);
+        t2 = benchNow();
+        fzz_defuzzifyEx(sys, ctx, &output);
+        t3 = benchNow();
+        benchSink += output;
+        fuzzify[i] = t1 - t0;
+        infer[i] = t2 - t1;
+        defuzzify[i] = t3 - t2;
+    }
+
+    //whole calculation
+    for(i = 0; i < SAMPLES; i++){
+        input = inputs + i*cfg->inputs;
+        t0 = benchNow();
+        fzz_calculateOutputEx(sys, ctx, input, &output);
+        t1 = benchNow();
+        benchSink += output;
+        total[i] = t1 - t0;
+    }
+    
+    //incremental calculation, only the first input changes
+    memcpy(last, inputs, sizeof(double)*cfg->inputs);
+    fzz_updateOutputEx(sys, ctx, last, &output);
+    for(i = 0; i < SAMPLES; i++){
+        last[0] = inputs[i*cfg->inputs];
+        t0 = benchNow();
+        fzz_updateOutputEx(sys, ctx, last, &output);
+        t1 = benchNow();
+        benchSink += output;
+        update[i] = t1 - t0;
+    }
+
+    benchReport(cfg, "fuzzify", fuzzify, SAMPLES);
+    benchReport(cfg, "infer", infer, SAMPLES);
+    benchReport(cfg, "defuzzify", defuzzify, SAMPLES);
+    benchReport(cfg, "total", total, SAMPLES);
+    benchReport(cfg, "update", update, SAMPLES);
+
+    free(inputs);
+    free(fuzzify);
+    free(infer);
+    free(defuzzify);
+    free(total);
+    free(update);
+    free(last);
+    fzz_destroyContext(ctx);
+    fzz_destroy(sys);
+}
+
+/**
+ * @brief Benchmarks parallel batch calculation of one configuration
+ * Speedup and efficiency are relative to pool with one thread
+ * @param cfg system configuration
+ * @param maxThreads maximal number of threads
+ */
+void benchScaling(const TBenchConfig* cfg, int maxThreads){
+    TFzzSystem* sys = benchCreate(cfg);
+    TFzzPool* pool = NULL;
+    double* inputs = (double*)malloc(sizeof(double)*BATCH*cfg->inputs);
+    double* outputs = (double*)malloc(sizeof(double)*BATCH);
+    double single = 0;
+    double ns = 0;
+    long long t0 = 0;
+    int threads = 1;
+    int i = 0;
+
+    //random input vectors
+    for(i = 0; i < BATCH*cfg->inputs; i++) inputs[i] = benchRandom();
+
+    //number of threads is doubled up to maximum
+    while(1){
+        pool = fzz_createPool(threads);
+        fzz_calculateBatchPoolEx(sys, pool, WARMUP, inputs, outputs);
+        t0 = benchNow();
+        fzz_calculateBatchPoolEx(sys, pool, BATCH, inputs, outputs);
+        ns = (double)(benchNow() - t0) / BATCH;
+        benchSink += outputs[BATCH-1];
+        if(threads == 1) single = ns;
+
+        printf("{\"inputs\":%d,\"sets\":%d,\"rules\":%d,\"defuzz\":\"%s\",\"stage\":\"batch\","
+               "\"threads\":%d,\"evals\":%d,\"ns_per_eval\":%.1f,\"evals_per_sec\":%.0f,"
+               "\"speedup\":%.2f,\"efficiency\":%.2f}\n",
+            cfg->inputs, cfg->sets, cfg->rules,
+            benchDefuzzNames[cfg->defuzz],
+            fzz_poolThreads(pool), BATCH, ns, ns > 0 ? 1e9 / ns : 0.0,
+            ns > 0 ? single / ns : 0.0, ns > 0 ? single / ns / fzz_poolThreads(pool) : 0.0
+        );
+        fzz_destroyPool(pool);
+
+        if(threads == maxThreads) break;
+        threads = 2*threads < maxThreads ? 2*threads : maxThreads;
+    }
+
+    free(inputs);
+    free(outputs);
+    fzz_destroy(sys);
+}
+
+/**
+ * @brief Main function
+ * Runs all benchmark configurations
+ */
+int main(int argc, const char* argv[]){
+    const TBenchConfig configs[] = {
+        {2, 3, 9, FZZ_COG_STEP},
+        {2, 3, 9, FZZ_COG_EXACT},
+        {2, 10, 100, FZZ_COG_STEP},
+        {2, 10, 100, FZZ_COG_EXACT},
+        {4, 5, 100, FZZ_COG_STEP},
+        {4, 5, 100, FZZ_COG_EXACT},
+        {3, 10, 1000, FZZ_COG_STEP},
+        {3, 10, 1000, FZZ_COG_EXACT},
+        {6, 5, 1000, FZZ_COG_STEP},
+        {6, 5, 1000, FZZ_COG_EXACT},
+        {2, 10, 100, FZZ_MOM},
+        {2, 10, 100, FZZ_BISECTOR},
+        {2, 10, 100, FZZ_WEIGHTED_AVERAGE},
+        {4, 5, 100, FZZ_MOM},
+        {4, 5, 100, FZZ_BISECTOR},
+        {4, 5, 100, FZZ_WEIGHTED_AVERAGE},
+        {2, 100, 1000, FZZ_COG_STEP},
+        {2, 500, 1000, FZZ_COG_STEP}
+    };
+    TFzzPool* pool = NULL;
+    int maxThreads = 0;
+    int i = 0;
+
+    //maximal number of threads, number of processors by default
+    if(argc > 1) maxThreads = atoi(argv[1]);
+    if(maxThreads <= 0){
+        pool = fzz_createPool(0);
+        maxThreads = fzz_poolThreads(pool);
+        fzz_destroyPool(pool);
+    }
+
+    for(i = 0; i < (int)(sizeof(configs)/sizeof(configs[0])); i++)
+        benchRun(&configs[i]);
+
+    //parallel batch calculation
+    benchScaling(&configs[2], maxThreads);
+    benchScaling(&configs[7], maxThreads);
+
+    return 0;
+}
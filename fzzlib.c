@@ -32,310 +32,1580 @@
 #include <stdio.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
+#include <time.h>
+
+//vector instructions used for fuzzification (define FZZ_NO_SIMD for scalar code),
+//vector code works with double precision only; on x86-64 all versions are built
+//and chosen when library is loaded (define FZZ_NO_DISPATCH for instructions
+//enabled for compiler only)
+#if defined(FZZ_FLOAT) && !defined(FZZ_NO_SIMD)
+#define FZZ_NO_SIMD
+#endif
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(FZZ_NO_SIMD) && !defined(FZZ_NO_DISPATCH)
+#include <immintrin.h>
+#define FZZ_SIMD_DISPATCH
+#define FZZ_SIMD_AVX2
+#define FZZ_TARGET_AVX2 __attribute__((target("avx2")))
+#define FZZ_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__AVX2__) && !defined(FZZ_NO_SIMD)
+#include <immintrin.h>
+#define FZZ_SIMD_AVX2
+#define FZZ_TARGET_AVX2
+#elif defined(__ARM_NEON) && defined(__aarch64__) && !defined(FZZ_NO_SIMD)
+#include <arm_neon.h>
+#define FZZ_SIMD_NEON
+#endif
+
+//hot loops of defuzzification are cloned for instruction sets, clone is chosen
+//when library is loaded (needs ifunc of GNU toolchain), multiply-add is not fused
+//so that every clone calculates the same outputs
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && defined(__linux__) && !defined(FZZ_NO_DISPATCH)
+#define FZZ_CLONES __attribute__((target_clones("avx512f", "avx2", "default"), optimize("fp-contract=off")))
+#else
+#define FZZ_CLONES
+#endif
+
+//saved systems are loaded by memory mapping where available
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FZZ_MMAP
+#endif
+
+//batch calculation by pool of threads (define FZZ_NO_THREADS for single thread)
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(FZZ_NO_THREADS)
+#include <pthread.h>
+#define FZZ_THREADS
+#endif
+
+//batch calculation on GPU by OpenCL (define FZZ_OPENCL and link OpenCL library)
+#ifdef FZZ_OPENCL
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+//shared systems are published and pinned by atomic pointers, revisions are counted atomically
+#ifdef FZZ_THREADS
+#define ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(p, value) __atomic_store_n(p, value, __ATOMIC_SEQ_CST)
+#define ATOMIC_INCREMENT(p) __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST)
+#else
+#define ATOMIC_LOAD(p) (*(p))
+#define ATOMIC_STORE(p, value) (*(p) = (value))
+#define ATOMIC_INCREMENT(p) (++*(p))
+#endif
 
 ///////////////////////////////////////////////////
 //////// Defines //////////////////////////////////
 ///////////////////////////////////////////////////
 
 /**
- * @brief Maximal length of name of fuzzy set and input / output set string
+ * @brief Size of integration step during defuzzification
+ * Used when searching for center of gravity of area
+ */
+#define COG_STEP ((TFzzReal)0.02)
+
+/**
+ * @brief Number of fuzzy sets rounded up to whole vector registers
+ * Size of arrays processed by vector fuzzification
  */
-#define NAME_LENGTH 16
+#define FSETS_PAD(length) (((length) + 3) / 4 * 4)
 
 /**
- * @brief Maximal lengths of inferential mechanism rule string
+ * @brief Number of samples of center of gravity integration processed
+ * at once, shape of every fired fuzzy set is dispatched once per chunk
  */
-#define RULE_LENGTH 128
+#define COG_CHUNK 64
 
 /**
- * @brief Maximal number of inferential mechanism rules
+ * @brief Support of Gaussian fuzzy set in multiples of its sigma
+ * Membership is zero outside, so Gaussian set is hit only near center
  */
-#define MAX_RULES 256
+#define GAUSS_CUT 4
 
 /**
- * @brief Maximal number of inputs of fuzzy system
+ * @brief Number of parts of support of Gaussian fuzzy set integrated 
+ * separately by exact defuzzification methods (which are approximate 
+ * for this shape)
  */
-#define MAX_INPUTS 4
+#define GAUSS_PARTS 16
 
 /**
- * @brief Maximal number of outputs of fuzzy system
+ * @brief Maximal number of break points of aggregated output fuzzy set
+ * Every fuzzy set has up to GAUSS_PARTS + 3 break points and every pair
+ * of fuzzy sets intersects in up to 8 points
  */
-#define MAX_OUTPUTS 2
+#define MAX_BREAKS(length) ((GAUSS_PARTS + 3)*(length) + 4*(length)*((length)-1))
 
 /**
- * @brief Maximal number of fuzzy sets in input / output list
+ * @brief Aggregated strength of output fuzzy set whose strongest rule
+ * became weaker during incremental calculation, it is aggregated again
  */
-#define MAX_FSETS 16
+#define STALE_STRENGTH -2
 
 /**
- * @brief Maximal number of matching rules of inferential mechanism for one output
+ * @brief Connectives of conditions of antecedent of rule
  */
-#define MAX_INFRES 64
+#define CONNECTIVE_AND 0
+#define CONNECTIVE_OR 1
 
 /**
- * @brief Length of buffer used for parsing inferential mechanism rule
- * Length can be eqal to NAME_LENGTH but its length must be >= 4 
+ * @brief Kinds of evaluation of antecedent of rule
+ * Kind is chosen when rule is compiled (or operators are set) from 
+ * connective, its operator, negated conditions and weight; RULE_MIN 
+ * is default and without negated condition and weight
  */
-#define WBUF_LENGTH 16
+#define RULE_MIN 0
+#define RULE_AND_MIN 1
+#define RULE_AND_PRODUCT 2
+#define RULE_OR_MAX 3
+#define RULE_OR_PROBOR 4
+#define RULE_OR_BOUNDED_SUM 5
 
 /**
- * @brief Size of integration step during defuzzification
- * Used when searching for center of gravity of area
+ * @brief Fuzzy operators used to instantiate inference functions,
+ * t-norms and s-norms of two memberships
  */
-#define COG_STEP 0.02
+#define TNORM_MIN(a, b) ((b) < (a) ? (b) : (a))
+#define TNORM_PRODUCT(a, b) ((a)*(b))
+#define SNORM_MAX(a, b) ((b) > (a) ? (b) : (a))
+#define SNORM_PROBOR(a, b) ((a) + (b) - (a)*(b))
+#define SNORM_BOUNDED_SUM(a, b) ((a) + (b) < 1 ? (a) + (b) : 1)
 
-/*
- * @brief Uncomment if you want to get debug file
- * You will get more info about output calculation etc
+/**
+ * @brief Fixed point (Q15) representation of full membership and of
+ * upper bound of normalized input or output range
+ */
+#define FIXED_ONE 32767
+
+/**
+ * @brief Number of integration steps of fixed point defuzzification
+ * Whole range of output is sampled, so every output takes the same time
+ */
+#define FIXED_STEPS 256
+
+/**
+ * @brief Number of random input vectors used by fzz_compileFixedEx 
+ * to measure error of fixed point calculation
+ */
+#define FIXED_SAMPLES 4096
+
+/**
+ * @brief Number of random input vectors used by fzz_optimizeRulesEx
+ * to measure deviation of optimized system
+ */
+#define OPTIMIZE_SAMPLES 4096
+
+/**
+ * @brief Results of optimization of one rule
+ */
+#define OPTIMIZE_KEPT 0
+#define OPTIMIZE_DEAD 1
+#define OPTIMIZE_DUPLICATE 2
+#define OPTIMIZE_SUBSUMED 3
+#define OPTIMIZE_MERGED 4
+
+/**
+ * @brief Defaults of training used for zero settings
+ */
+#define TRAIN_EPOCHS 100
+#define TRAIN_RATE 0.01
+
+/**
+ * @brief Change of learning rate after accepted and rejected step
+ */
+#define TRAIN_SPEEDUP 1.2
+#define TRAIN_SLOWDOWN 0.5
+
+/**
+ * @brief Step of numeric gradient relative to magnitude of parameter
+ * (at least 1)
+ */
+#define TRAIN_DELTA 1e-4
+
+/**
+ * @brief Minimal sigma of trained Gaussian fuzzy set
+ */
+#define TRAIN_MIN_SIGMA 1e-6
+
+/**
+ * @brief Kinds of partition of input fuzzy sets
+ * Sorted partition has left and right points nondecreasing with index
+ * of fuzzy set, so hit fuzzy sets are neighbours; uniform partition 
+ * has tops in grid with fixed step and sides reaching neighbour tops
+ * (only the first left and the last right side can be longer)
+ */
+#define PARTITION_NONE 0
+#define PARTITION_SORTED 1
+#define PARTITION_UNIFORM 2
+
+/**
+ * @brief Minimal number of fuzzy sets of input whose partition is used
+ * by fuzzification, smaller inputs are scanned linearly
+ */
+#define PARTITION_MIN_SETS 8
+
+/**
+ * @brief Tolerance of uniform partition detection relative to step
+ */
+#define PARTITION_TOLERANCE 1e-6
+
+/**
+ * @brief Minimal size of memory arena block
+ */
+#define ARENA_BLOCK 4096
+
+/**
+ * @brief Alignment of memory allocated from arena
+ * Blocks are aligned to cache line
+ */
+#define ARENA_ALIGN 16
+
+/**
+ * @brief Size of cache line, alignment of arena blocks
+ */
+#define CACHE_LINE 64
+
+/**
+ * @brief Number of input vectors taken at once by worker of pool
+ */
+#define POOL_CHUNK 16
+
+/**
+ * @brief Identification of saved fuzzy system file
+ */
+#define FILE_MAGIC "FZZB"
+
+/**
+ * @brief Version of saved fuzzy system file format
+ * Has to be increased whenever file layout is changed
+ */
+#define FILE_VERSION 10
+
+/**
+ * @brief Number stored in file to detect different byte order
+ */
+#define FILE_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Number of samples of fired range of output integrated by GPU
+ * kernel (center of gravity and bisector)
  */
-//#define DEBUG_MODE
+#define GPU_SAMPLES 1024
 
 /**
- * @brief Log file path name
+ * @brief Number of input vectors transferred to GPU at once, one chunk
+ * is calculated while the next one is transferred
  */
-#define LOG_FILE "fzz_log.txt"
+#define GPU_BATCH 65536
+
+/**
+ * @brief Number of work items of work group of GPU kernel
+ */
+#define GPU_GROUP 64
+
+/**
+ * @brief Maximal length of build options of GPU kernel
+ */
+#define GPU_OPTIONS 4096
+
+/**
+ * @brief Vector instructions of fuzzification (indexes of fzzSimdNames)
+ * Dispatched build supports SSE2 and every higher level available 
+ * on processor, other builds support only one level of compiler
+ */
+#define SIMD_NONE 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+#define SIMD_AVX512 3
+#define SIMD_NEON 4
+
+/**
+ * @brief Vector instructions of fuzzification selected by compiler
+ */
+#if defined(FZZ_SIMD_DISPATCH)
+#define SIMD_DEFAULT SIMD_SSE2
+#elif defined(FZZ_SIMD_AVX2)
+#define SIMD_DEFAULT SIMD_AVX2
+#elif defined(FZZ_SIMD_NEON)
+#define SIMD_DEFAULT SIMD_NEON
+#else
+#define SIMD_DEFAULT SIMD_NONE
+#endif
 
 ///////////////////////////////////////////////////
 //////// Data types ///////////////////////////////
 ///////////////////////////////////////////////////
 
 /**
- * @brief Fuzzy set with triangular membership function
+ * @brief Real number used by fuzzy system data and output calculation
+ * Single precision is used when FZZ_FLOAT is defined (for processors 
+ * without double precision unit), it halves size of system and context;
+ * functions of library always take and return double
+ */
+#ifdef FZZ_FLOAT
+typedef float TFzzReal;
+#define REAL_MAX FLT_MAX
+#else
+typedef double TFzzReal;
+#define REAL_MAX DBL_MAX
+#endif
+
+/**
+ * @brief Block of memory arena
+ */
+typedef struct TArenaBlock{
+    struct TArenaBlock* next;
+    char* data;
+    size_t size;
+    size_t used;
+}TArenaBlock;
+
+/**
+ * @brief Memory arena
+ * All data of fuzzy system (or context) are allocated from its arena,
+ * memory is released at once when arena is released
+ */
+typedef struct{
+    TArenaBlock* head;
+}TArena;
+
+/**
+ * @brief Fuzzy set with membership function of given shape
+ * Every shape is described by four points, membership is 1 between top
+ * and topEnd (equal for triangle). Open side of shoulder ends in its 
+ * outer point, Gaussian set has center in top and support GAUSS_CUT 
+ * sigmas wide on both sides, singleton has all points equal.
  */
 typedef struct{
-    double left;
-    double top;
-    double right;
-    char name[NAME_LENGTH];
+    TFzzReal left;
+    TFzzReal top;
+    TFzzReal topEnd;
+    TFzzReal right;
+    int shape;
+    const char* name;
 }TFuzzySet;
 
+/**
+ * @brief List of indexes of rules, capacity is doubled when it is full
+ */
+typedef struct{
+    int* rule;
+    int length;
+    int capacity;
+}TRuleList;
+
 /**
  * @brief Set of input or output fuzzy sets
+ * Membership functions of input sets are also stored as structure 
+ * of arrays with precomputed slopes (kLeft, kRight), arrays are padded
+ * to FSETS_PAD(length); unused items are zero, so they are never hit.
+ * Open sides of input shoulders reach -REAL_MAX or REAL_MAX there (input
+ * out of range keeps full membership) and kLeft of Gaussian set holds 
+ * 1/(2*sigma^2). Input with Gaussian or singleton set is curved, it 
+ * can not use vector fuzzification. Partition of input sets is detected 
+ * whenever fuzzy set is set.
  */
 typedef struct{
-    TFuzzySet fSet[MAX_FSETS];
+    TFuzzySet* fSet;
     int length;
-    char name[NAME_LENGTH];
+    const char* name;
+    TDefuzzMethod defuzz;
+    //membership functions as structure of arrays (used for fuzzification)
+    TFzzReal* left;
+    TFzzReal* top;
+    TFzzReal* topEnd;
+    TFzzReal* right;
+    TFzzReal* kLeft;
+    TFzzReal* kRight;
+    int curved;
+    //partition of input fuzzy sets, grid of tops of uniform partition
+    int partition;
+    TFzzReal gridFrom;
+    TFzzReal gridStep;
+    //rules referencing fuzzy sets in their antecedent (input) or consequent (output)
+    TRuleList* rules;
+    //rules with linear function of inputs in consequent (output only)
+    TRuleList functions;
+    //rules with negated condition on input, evaluated whenever input changes (input only)
+    TRuleList negated;
 }TFcnsSet;
 
+/**
+ * @brief Inferential mechanism rule in compiled form
+ * Names from rule text are replaced by indexes; consequent is either
+ * output fuzzy set or linear function of inputs (Takagi-Sugeno), then
+ * outSet is -1 and coefs holds constant followed by coefficient of 
+ * every input of system. Conditions are joined by connective, negated 
+ * is nonzero for negated condition; kind selects evaluation of antecedent
+ * and need is number of hit conditions needed to evaluate rule (all 
+ * conditions for and without negation, one otherwise). Weight (0..1]
+ * scales strength of rule.
+ */
+typedef struct{
+    int* inputs;
+    int* inSets;
+    int* negated;
+    int inLen;
+    int connective;
+    int kind;
+    int need;
+    int output;
+    int outSet;
+    TFzzReal* coefs;
+    TFzzReal weight;
+}TRule;
+
+/**
+ * @brief Lookup table of sampled system outputs
+ * Grid has res points for every input, values of all outputs of 
+ * one grid point are stored together
+ */
+typedef struct{
+    TFzzReal* table;
+    int res;
+    TFzzReal* from;
+    TFzzReal* step;
+    int* stride;
+}TLut;
+
+/**
+ * @brief Fixed point (Q15) form of membership functions
+ * Every input and output is normalized to range 0..FIXED_ONE covering 
+ * all its fuzzy sets, first holds index of first fuzzy set of every 
+ * input followed by outputs (and total number of fuzzy sets). Fuzzy set
+ * has four points (left, top, topEnd, right; open sides of input shoulders
+ * are out of range) and two slopes in Q15 per unit shifted by 16 bits.
+ * All arrays are part of one memory block.
+ */
+typedef struct{
+    double* from;
+    double* scale;
+    int* first;
+    int* slope;
+    int* point;
+    void* memory;
+}TFixed;
+
 /**
  * @brief Fuzzy system data structure
+ * Model of system, it is modified only during system setup.
+ * System structure and all its data are allocated from its arena.
+ */
+struct TFzzSystem{
+    int inLen;
+    int outLen;
+    TFcnsSet* inSet;
+    TFcnsSet* outSet;
+    int ruLen;
+    int ruCapacity;
+    char** rule;
+    TRule* ruleData;
+    //texts of rules compiled again when input or output was initialized
+    //again, rules wait until names of their fuzzy sets are set
+    char** pending;
+    int pendingLen;
+    TLut lut;
+    TFixed fixed;
+    //fuzzy operators (TFzzOperator)
+    int andOp;
+    int orOp;
+    int implication;
+    int aggregation;
+    //samples of whole output range in real-time mode, 0 for COG_STEP
+    int samples;
+    //published by shared system (read only)
+    int published;
+    unsigned int revision;
+    //file memory of loaded system (read only), NULL for created system
+    void* mapping;
+    size_t mappingSize;
+    TArena arena;
+};
+
+/**
+ * @brief State of training of fuzzy system
+ * Trained parameters are grouped to blocks, block is fuzzy set (its
+ * shape parameters) or rule with linear function (its coefficients, 
+ * set is NULL), first holds index of first parameter of every block 
+ * (and number of parameters). Block of fuzzy set j of input i is 
+ * inBlock[inFirst[i] + j] and block of rule is ruleBlock[rule] (-1 when
+ * not trained). Every worker adds squared error, number of counted 
+ * outputs, outputs of sample and gradient to its own part of sums 
+ * (stride doubles, whole cache lines).
+ */
+typedef struct TTrain{
+    TFzzSystem* sys;
+    int count;
+    const double* inputs;
+    const double* targets;
+    //blocks of parameters
+    TFcnsSet** set;
+    int* index;
+    int* input;
+    int* first;
+    int length;
+    double* value;
+    double* gradient;
+    int* inFirst;
+    int* inBlock;
+    int* ruleBlock;
+    //sums of workers
+    double* sums;
+    int stride;
+    TArena arena;
+}TTrain;
+
+/**
+ * @brief Worker of thread pool
+ * Every worker takes whole cache lines of pool arena, range 
+ * of not calculated input vectors (next to end) is protected by lock
+ */
+typedef struct{
+    struct TFzzPool* pool;
+    TFzzContext* ctx;
+    int index;
+    int next;
+    int end;
+    #ifdef FZZ_THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    #endif
+}TFzzWorker;
+
+/**
+ * @brief Pool of worker threads
+ * Workers wait for new generation (batch), running is number of 
+ * started threads which did not finish current batch yet
+ */
+struct TFzzPool{
+    int threads;
+    TFzzWorker** workers;
+    const TFzzSystem* sys;
+    const double* inputs;
+    double* outputs;
+    //graph of systems, its nodes of one level are calculated instead
+    //of input vectors (from first in order of nodes), one at once
+    struct TFzzGraph* graph;
+    int first;
+    int chunk;
+    //training, samples of dataset are calculated with their gradient
+    TTrain* train;
+    #ifdef FZZ_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finish;
+    #endif
+    unsigned int generation;
+    int running;
+    int quit;
+    TArena arena;
+};
+
+/**
+ * @brief Node of graph of fuzzy systems
+ * For every input from is index of linked node (-1 if not linked), 
+ * source is index of linked graph output or -1 - index of graph input
+ * and fuzzy is nonzero for fuzzy link; node is staged when any of its 
+ * links is fuzzy, input holds gathered input values
+ */
+typedef struct{
+    const TFzzSystem* sys;
+    const char* name;
+    TFzzContext* ctx;
+    int* from;
+    int* source;
+    int* fuzzy;
+    double* input;
+    int firstOutput;
+    int level;
+    int staged;
+}TGraphNode;
+
+/**
+ * @brief Graph of fuzzy systems
+ * Order lists nodes sorted by level, levelStart holds index of first 
+ * node of every level in order (and number of nodes); graph is prepared
+ * again (ready is 0) when node or link is added
+ */
+struct TFzzGraph{
+    TGraphNode* nodes;
+    int length;
+    int capacity;
+    int* order;
+    int* levelStart;
+    int levels;
+    int inLen;
+    int outLen;
+    int ready;
+    TArena arena;
+};
+
+/**
+ * @brief Reader of shared fuzzy system
+ * Sys is system pinned by reader (its context was created for it), 
+ * writer reads it to find out which retired systems are still used
+ */
+struct TFzzReader{
+    struct TFzzShared* shared;
+    TFzzSystem* sys;
+    TFzzContext* ctx;
+};
+
+/**
+ * @brief Shared fuzzy system
+ * Current is published system, retired systems were replaced and wait
+ * until no reader pins them; lists are protected by lock
+ */
+struct TFzzShared{
+    TFzzSystem* current;
+    TFzzSystem** retired;
+    int retiredLen;
+    int retiredCapacity;
+    TFzzReader** readers;
+    int readerLen;
+    int readerCapacity;
+    #ifdef FZZ_THREADS
+    pthread_mutex_t lock;
+    #endif
+};
+
+#ifdef FZZ_OPENCL
+/**
+ * @brief GPU backend of fuzzy system
+ * Model (integer and real arrays) is uploaded once for revision of
+ * system, inputs and outputs have two sets of buffers and queues
+ */
+struct TFzzGpu{
+    const TFzzSystem* sys;
+    unsigned int revision;
+    cl_device_id device;
+    cl_context context;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem ints;
+    cl_mem reals;
+    cl_command_queue queue[2];
+    cl_mem input[2];
+    cl_mem output[2];
+    TFzzReal* stageIn[2];
+    TFzzReal* stageOut[2];
+};
+#endif
+
+/**
+ * @brief Header of saved fuzzy system file
+ * File is saved in native byte order, layout and precision of real
+ * numbers (TFzzReal), data sections follow
+ * header in fixed order, each aligned to ARENA_ALIGN; checksum covers
+ * all bytes after header and then header with zero checksum
  */
 typedef struct{
+    char magic[4];
+    unsigned int version;
+    unsigned int byteOrder;
+    unsigned int realSize;
+    unsigned int namesSize;
+    unsigned int checksum;
     int inLen;
     int outLen;
-    TFcnsSet inSet[MAX_INPUTS];
-    TFcnsSet outSet[MAX_OUTPUTS];
-    double input[MAX_INPUTS];
-    double output[MAX_OUTPUTS];
     int ruLen;
-    char rule[MAX_RULES][RULE_LENGTH];
-}TFzzSystem;
+    int antecedents;
+    int andOp;
+    int orOp;
+    int implication;
+    int aggregation;
+    int samples;
+    int lutRes;
+    unsigned long long size;
+}TFileHeader;
+
+/**
+ * @brief Saved set of fuzzy sets, names are stored in common 
+ * section of all names
+ */
+typedef struct{
+    int length;
+    int defuzz;
+}TFileFcns;
+
+/**
+ * @brief Saved fuzzy set, its name is stored in common section of all names
+ */
+typedef struct{
+    TFzzReal left;
+    TFzzReal top;
+    TFzzReal topEnd;
+    TFzzReal right;
+    int shape;
+}TFileSet;
+
+/**
+ * @brief Saved compiled rule, conditions and text are stored 
+ * in common sections of all rules
+ */
+typedef struct{
+    int inLen;
+    int connective;
+    int output;
+    int outSet;
+    int textLength;
+}TFileRule;
+
+/**
+ * @brief Data written to saved fuzzy system file
+ */
+typedef struct{
+    FILE* file;
+    size_t offset;
+    unsigned int checksum;
+    int error;
+}TFileWriter;
+
+/**
+ * @brief Position in loaded fuzzy system file
+ */
+typedef struct{
+    char* data;
+    size_t size;
+    size_t offset;
+}TFileReader;
+
+/**
+ * @brief State of model text processing
+ * Lines are processed one by one, set is last declared input or output
+ * and next is index of its next fuzzy set
+ */
+typedef struct{
+    TFzzSystem* sys;
+    TFcnsSet* set;
+    int isInput;
+    int fcSet;
+    int next;
+    int inputs;
+    int outputs;
+    char* line;
+    size_t lineLength;
+    size_t lineCapacity;
+    int lineNumber;
+    const char* error;
+}TModelParser;
 
 /**
  * @brief Result of fuzzifycation for one fuzzy set
  */
 typedef struct{
-    double membership;
+    TFzzReal membership;
     int setIndex;
 }TFuzzifyRes;
 
 /**
  * @brief Output of fuzzifycation process for one input
+ * Contains list of hit fuzzy sets and membership of every fuzzy set
+ * indexed by fuzzy set index (negative if fuzzy set was not hit)
  */
 typedef struct{
-    TFuzzifyRes res[MAX_FSETS];
+    TFuzzifyRes* res;
     int length;
+    TFzzReal* memb;
 }TFuzzifyOut;
 
 /**
- * @brief Result of inference of one matching rule
+ * @brief Result of inference for one output
+ * Rules are aggregated per output fuzzy set, strength holds the strongest
+ * rule for every fuzzy set (-1 if no rule fired) and fired lists indexes
+ * of fired fuzzy sets; level is strength used by defuzzification, the 
+ * same array for max aggregation, otherwise it is aggregated from all 
+ * rules of fired fuzzy sets before defuzzification; rules lists fired 
+ * rules with linear functions (their strength is in context); stale fuzzy
+ * sets and changed flag are used only by incremental calculation
  */
 typedef struct{
-    double value;
-    int fSet;
-}TInfRes;
+    TFzzReal* strength;
+    TFzzReal* level;
+    int* fired;
+    int length;
+    int* rules;
+    int ruleLen;
+    int* stale;
+    int staleLen;
+    int changed;
+}TInfOut;
 
 /**
- * @brief Result of inference for one output
+ * @brief Ring buffer of recent calculations
+ * Record holds inputs followed by outputs, next is index of record
+ * written by next calculation (the oldest record when buffer is full)
  */
 typedef struct{
-    TInfRes res[MAX_INFRES];
+    TFzzReal* values;
+    int* fired;
+    long long* ns;
     int length;
-}TInfOut;
+    int next;
+    unsigned long long count;
+}TTrace;
+
+/**
+ * @brief Scratch data used during output calculation
+ * Sizes of arrays are given by system of given revision, 
+ * context and all its data are allocated from its arena
+ */
+struct TFzzContext{
+    const TFzzSystem* sys;
+    unsigned int revision;
+    TFuzzifyOut* fzfOut;
+    TInfOut* infOut;
+    //exact defuzzification
+    TFzzReal* lines;
+    int* lineLen;
+    TFzzReal* breaks;
+    //grid of samples of every output in real-time mode
+    TFzzReal* sampleFrom;
+    TFzzReal* sampleStep;
+    //lookup table interpolation, interp holds interpolated outputs
+    int* cell;
+    TFzzReal* frac;
+    TFzzReal* weight;
+    TFzzReal* interp;
+    //rule index lookup, number of hit conditions of every rule
+    int* hits;
+    int* touched;
+    //incremental calculation, inputs and outputs of last calculation
+    //and strength of every rule (-1 if rule did not fire)
+    TFzzReal* input;
+    TFzzReal* output;
+    TFzzReal* ruleStrength;
+    int cached;
+    //fixed point calculation, membership of every input fuzzy set
+    //and strength of every output fuzzy set (-1 if it is not hit)
+    short* fixedMemb;
+    short* fixedStrength;
+    //runtime statistics, fired is number of rules fired by last calculation
+    int statsFlags;
+    int fired;
+    TFzzStats stats;
+    TTrace trace;
+    TArena arena;
+};
 
 ///////////////////////////////////////////////////
 //////// Global variables /////////////////////////
 ///////////////////////////////////////////////////
 
-///Fuzzy system structure
-TFzzSystem fzzSystem;
+///Default fuzzy system used by fzz_* functions without system parameter
+TFzzSystem* fzzSystem = NULL;
 
-///Fuzzyfication output
-TFuzzifyOut fzfOut[MAX_INPUTS];
+///Context of default fuzzy system
+TFzzContext* fzzContext = NULL;
 
-//Inferential mechanism output
-TInfOut infOut[MAX_OUTPUTS];
-    
-#ifdef DEBUG_MODE
-FILE* fzz_logFile = NULL;
+///Inputs of default fuzzy system
+double* fzzInput = NULL;
+
+///Outputs of default fuzzy system
+double* fzzOutput = NULL;
+
+///Last revision of any fuzzy system, revisions are unique among all systems
+unsigned int fzzRevision = 0;
+
+///Pool used by fzz_calculateBatch (created when needed)
+TFzzPool* fzzPool = NULL;
+
+///Number of threads used by fzz_calculateBatch
+int fzzThreads = 1;
+
+///Statistics of default fuzzy system (kept when its context is created again)
+int fzzStatsFlags = 0;
+int fzzTraceLength = 0;
+
+///Names of defuzzification methods in model file (indexed by TDefuzzMethod)
+const char* fzzDefuzzNames[] = {"cog_step", "cog_exact", "mom", "bisector", "weighted_average", NULL};
+
+///Names of shapes of fuzzy sets in model file and numbers of their parameters (indexed by TFzzShape)
+const char* fzzShapeNames[] = {"triangle", "trapezoid", "left_shoulder", "right_shoulder", "gaussian", "singleton", NULL};
+const int fzzShapeParams[] = {3, 4, 3, 3, 2, 1};
+
+///Parameters of shapes which are left, top, topEnd and right point of fuzzy set (indexed by TFzzShape, Gaussian is derived)
+const int fzzShapePoints[][4] = {{0, 1, 1, 2}, {0, 1, 2, 3}, {0, 0, 1, 2}, {0, 1, 2, 2}, {0, 0, 0, 0}, {0, 0, 0, 0}};
+
+///Names of fuzzy operators in model file (indexed by TFzzOperator)
+const char* fzzOperatorNames[] = {"min", "product", "max", "probor", "bounded_sum", NULL};
+
+///Names of vector instructions of fuzzification (indexed by SIMD_* level)
+const char* fzzSimdNames[] = {"none", "sse2", "avx2", "avx512", "neon", NULL};
+
+///The best supported and currently used vector instructions of fuzzification
+int fzzSimdBest = SIMD_DEFAULT;
+int fzzSimd = SIMD_DEFAULT;
+
+#ifdef FZZ_OPENCL
+///Source of GPU kernel, sizes, operators and offsets of model arrays are defined by build options
+const char* fzzGpuSource = 
+    "#ifdef FZZ_FP64\n"
+    "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+    "#endif\n"
+    "\n"
+    "/* t-norm and s-norm of operator (TFzzOperator) */\n"
+    "#define TNORM(op, a, b) ((op) == 1 ? (a)*(b) : ((b) < (a) ? (b) : (a)))\n"
+    "#define SNORM(op, a, b) ((op) == 3 ? (a) + (b) - (a)*(b) : (op) == 4 ? ((a) + (b) < 1 ? (a) + (b) : 1) : ((b) > (a) ? (b) : (a)))\n"
+    "\n"
+    "/* relative tolerance of half of area searched by bisector */\n"
+    "#ifdef FZZ_FP64\n"
+    "#define BISECT_EPS 1e-9\n"
+    "#else\n"
+    "#define BISECT_EPS 1e-4f\n"
+    "#endif\n"
+    "\n"
+    "/* membership in input fuzzy set, -1 if it is not hit */\n"
+    "REAL fzz_gpuMembership(__global const REAL* mr, int shape, int s, REAL x){\n"
+    "    REAL left = mr[IN_LEFT + s];\n"
+    "    REAL top = mr[IN_TOP + s];\n"
+    "    REAL right = mr[IN_RIGHT + s];\n"
+    "    \n"
+    "    if(shape == 5) return x == top ? 1 : -1;\n"
+    "    if(x <= left || x >= right) return -1;\n"
+    "    if(shape == 4) return exp(-(x - top)*(x - top)*mr[IN_KLEFT + s]);\n"
+    "    if(x <= top) return mr[IN_KLEFT + s]*(x - left);\n"
+    "    if(x <= mr[IN_TOPEND + s]) return 1;\n"
+    "    return mr[IN_KRIGHT + s]*(x - mr[IN_TOPEND + s]) + 1;\n"
+    "}\n"
+    "\n"
+    "/* strength of rule, -1 if it did not fire */\n"
+    "REAL fzz_gpuStrength(__global const REAL* mr, __global const int* mi, const REAL* memb, int r){\n"
+    "    int connective = mi[RULE_CONNECTIVE + r];\n"
+    "    REAL value = connective == 0 ? 1 : 0;\n"
+    "    REAL m = 0;\n"
+    "    int c = 0;\n"
+    "    \n"
+    "    for(c = mi[RULE_FIRST + r]; c < mi[RULE_FIRST + r + 1]; c++){\n"
+    "        m = memb[mi[COND_SET + c]];\n"
+    "        if(m < 0) m = 0;\n"
+    "        if(mi[COND_NEG + c]) m = 1 - m;\n"
+    "        if(connective == 0){\n"
+    "            if(m <= 0) return -1;\n"
+    "            value = TNORM(AND_OP, value, m);\n"
+    "        }else{\n"
+    "            value = SNORM(OR_OP, value, m);\n"
+    "        }\n"
+    "    }\n"
+    "    return value > 0 ? value*mr[RULE_WEIGHT + r] : -1;\n"
+    "}\n"
+    "\n"
+    "/* membership in aggregated output fuzzy set */\n"
+    "REAL fzz_gpuOutput(__global const REAL* mr, __global const int* mi, int first, int n, const REAL* level, REAL x){\n"
+    "    REAL y = 0;\n"
+    "    REAL m = 0;\n"
+    "    int s = 0;\n"
+    "    int j = 0;\n"
+    "    \n"
+    "    for(j = 0; j < n; j++){\n"
+    "        s = first + j;\n"
+    "        if(level[j] < 0 || x <= mr[OUT_LEFT + s] || x >= mr[OUT_RIGHT + s]) continue;\n"
+    "        if(mi[OUT_SHAPE + s] == 4) m = exp(-(x - mr[OUT_TOP + s])*(x - mr[OUT_TOP + s])*mr[OUT_KLEFT + s]);\n"
+    "        else if(x <= mr[OUT_TOP + s]) m = mr[OUT_KLEFT + s]*(x - mr[OUT_LEFT + s]);\n"
+    "        else if(x <= mr[OUT_TOPEND + s]) m = 1;\n"
+    "        else m = mr[OUT_KRIGHT + s]*(x - mr[OUT_TOPEND + s]) + 1;\n"
+    "        m = TNORM(IMPLICATION, m, level[j]);\n"
+    "        y = SNORM(AGGREGATION, y, m);\n"
+    "    }\n"
+    "    return y;\n"
+    "}\n"
+    "\n"
+    "/* outputs of one input vector */\n"
+    "__kernel void fzz_batch(__global const REAL* mr, __global const int* mi, __global const REAL* input, __global REAL* output, int count){\n"
+    "    int id = (int)get_global_id(0);\n"
+    "    REAL memb[IN_SETS];\n"
+    "    REAL level[OUT_MAX];\n"
+    "    __global const REAL* x = input + (size_t)id*IN_LEN;\n"
+    "    __global const REAL* coefs = 0;\n"
+    "    REAL numerator = 0;\n"
+    "    REAL denominator = 0;\n"
+    "    REAL from = 0;\n"
+    "    REAL to = 0;\n"
+    "    REAL step = 0;\n"
+    "    REAL value = 0;\n"
+    "    REAL area = 0;\n"
+    "    REAL y = 0;\n"
+    "    REAL w = 0;\n"
+    "    int method = 0;\n"
+    "    int first = 0;\n"
+    "    int n = 0;\n"
+    "    int i = 0;\n"
+    "    int j = 0;\n"
+    "    int k = 0;\n"
+    "    int r = 0;\n"
+    "    int s = 0;\n"
+    "    \n"
+    "    if(id >= count) return;\n"
+    "    for(i = 0; i < IN_LEN; i++)\n"
+    "        for(s = mi[IN_FIRST + i]; s < mi[IN_FIRST + i + 1]; s++) memb[s] = fzz_gpuMembership(mr, mi[IN_SHAPE + s], s, x[i]);\n"
+    "    \n"
+    "    for(i = 0; i < OUT_LEN; i++){\n"
+    "        first = mi[OUT_FIRST + i];\n"
+    "        n = mi[OUT_FIRST + i + 1] - first;\n"
+    "        method = mi[OUT_METHOD + i];\n"
+    "        numerator = 0;\n"
+    "        denominator = 0;\n"
+    "        for(j = 0; j < n; j++) level[j] = -1;\n"
+    "        \n"
+    "        /* rules of output in order of their indexes */\n"
+    "        for(k = mi[OUT_RULES_FIRST + i]; k < mi[OUT_RULES_FIRST + i + 1]; k++){\n"
+    "            r = mi[OUT_RULES + k];\n"
+    "            w = fzz_gpuStrength(mr, mi, memb, r);\n"
+    "            if(w < 0) continue;\n"
+    "            s = mi[RULE_SET + r];\n"
+    "            if(s < 0){\n"
+    "                coefs = mr + RULE_COEFS + r*(IN_LEN + 1);\n"
+    "                value = coefs[0];\n"
+    "                for(j = 0; j < IN_LEN; j++) value += coefs[1 + j]*x[j];\n"
+    "                numerator += w*value;\n"
+    "                denominator += w;\n"
+    "                continue;\n"
+    "            }\n"
+    "            s -= first;\n"
+    "            level[s] = level[s] < 0 ? w : SNORM(AGGREGATION, level[s], w);\n"
+    "        }\n"
+    "        if(method == -1){\n"
+    "            output[(size_t)id*OUT_LEN + i] = numerator / denominator;\n"
+    "            continue;\n"
+    "        }\n"
+    "        \n"
+    "        /* tops weighted by levels */\n"
+    "        if(method == 4){\n"
+    "            for(j = 0; j < n; j++){\n"
+    "                if(level[j] < 0) continue;\n"
+    "                numerator += level[j]*(REAL)0.5*(mr[OUT_TOP + first + j] + mr[OUT_TOPEND + first + j]);\n"
+    "                denominator += level[j];\n"
+    "            }\n"
+    "            output[(size_t)id*OUT_LEN + i] = numerator / denominator;\n"
+    "            continue;\n"
+    "        }\n"
+    "        \n"
+    "        /* midpoints of SAMPLES parts of fired range (center of gravity or bisector) */\n"
+    "        from = 0;\n"
+    "        to = 0;\n"
+    "        for(j = 0, k = 0; j < n; j++){\n"
+    "            if(level[j] < 0) continue;\n"
+    "            if(k == 0 || mr[OUT_LEFT + first + j] < from) from = mr[OUT_LEFT + first + j];\n"
+    "            if(k == 0 || mr[OUT_RIGHT + first + j] > to) to = mr[OUT_RIGHT + first + j];\n"
+    "            k = 1;\n"
+    "        }\n"
+    "        step = (to - from) / SAMPLES;\n"
+    "        for(k = 0; k < SAMPLES; k++){\n"
+    "            value = from + ((REAL)k + (REAL)0.5)*step;\n"
+    "            y = fzz_gpuOutput(mr, mi, first, n, level, value);\n"
+    "            numerator += value*y;\n"
+    "            denominator += y;\n"
+    "        }\n"
+    "        value = numerator / denominator;\n"
+    "        if(method == 3){\n"
+    "            /* half of area is reached at the beginning of gap between fuzzy sets */\n"
+    "            area = 0;\n"
+    "            w = (REAL)0.5*denominator*(1 - BISECT_EPS);\n"
+    "            for(k = 0; k < SAMPLES && denominator > 0; k++){\n"
+    "                y = fzz_gpuOutput(mr, mi, first, n, level, from + ((REAL)k + (REAL)0.5)*step);\n"
+    "                if(area + y >= w && y > 0){\n"
+    "                    y = ((REAL)0.5*denominator - area)/y;\n"
+    "                    value = from + ((REAL)k + (y < 0 ? 0 : y > 1 ? 1 : y))*step;\n"
+    "                    break;\n"
+    "                }\n"
+    "                area += y;\n"
+    "            }\n"
+    "        }\n"
+    "        output[(size_t)id*OUT_LEN + i] = value;\n"
+    "    }\n"
+    "}\n";
 #endif
 
 ///////////////////////////////////////////////////
-//////// Main functions ///////////////////////////
+//////// Memory arena /////////////////////////////
 ///////////////////////////////////////////////////
 
-void fzz_init(int inputs, int outputs){
-    int i = 0;
-    int j = 0;
-
-    //opens log file
-    #ifdef DEBUG_MODE
-    fzz_logFile = fopen(LOG_FILE, "w");    
-    assert(fzz_logFile != NULL && "Cant open log file in fzz_init(...)");
-    #endif
-    
-    //maximum input count check
-    assert(inputs <= MAX_INPUTS && "Required number of inputs exceeds maximum in fzz_init(...)");
-    
-    //maximum output count check
-    assert(outputs <= MAX_OUTPUTS && "Required number of outputs exceeds maximum in fzz_init(...)");
-    
-    //number of inputs and outputs
-    fzzSystem.inLen = inputs;
-    fzzSystem.outLen = outputs;
-    
-    //init of input set of fuzzy sets 
-    for(i = 0; i < MAX_INPUTS; i++){
-        fzzSystem.inSet[i].length = 0;
-        fzzSystem.inSet[i].name[0] = '\0';
-        //fuzzy set in input set
-        for(j = 0; j < MAX_FSETS; j++){
-            fzzSystem.inSet[i].fSet[j].left = 0;
-            fzzSystem.inSet[i].fSet[j].top = 0;
-            fzzSystem.inSet[i].fSet[j].right = 0;
-            fzzSystem.inSet[i].fSet[j].name[0] = '\0';
-        }
-    }
+/**
+ * @brief Allocates zeroed memory from arena
+ * Internal function, new block is added when there is no space left,
+ * memory is released only with whole arena
+ * @param arena memory arena
+ * @param size required size
+ * @return allocated memory
+ */
+void* fzz_arenaAlloc(TArena* arena, size_t size){
+    TArenaBlock* block = arena->head;
+    size_t blockSize = ARENA_BLOCK;
+    void* mem = NULL;
     
-    //init of output set of fuzzy sets
-    for(i = 0; i < MAX_OUTPUTS; i++){
-        fzzSystem.outSet[i].length = 0;
-        fzzSystem.outSet[i].name[0] = '\0';
-        //fuzzy sets in output set
-        for(j = 0; j < MAX_FSETS; j++){
-            fzzSystem.outSet[i].fSet[j].left = 0;
-            fzzSystem.outSet[i].fSet[j].top = 0;
-            fzzSystem.outSet[i].fSet[j].right = 0;
-            fzzSystem.outSet[i].fSet[j].name[0] = '\0';
-        }
+    //new block, every block is twice bigger than previous one
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if(block == NULL || block->size - block->used < size){
+        if(block != NULL) blockSize = 2*block->size;
+        if(blockSize < size) blockSize = size;
+        block = (TArenaBlock*)malloc(sizeof(TArenaBlock) + CACHE_LINE - 1 + blockSize);
+        assert(block != NULL && "Memory allocation failed in fzz_arenaAlloc(...)");
+        //block data are aligned to cache line
+        block->data = (char*)(((size_t)(block + 1) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+        block->next = arena->head;
+        block->size = blockSize;
+        block->used = 0;
+        arena->head = block;
     }
     
-    //arrays for storing system inputs and output
-    for(i = 0; i < MAX_INPUTS; i++) fzzSystem.input[i] = 0;
-    for(i = 0; i < MAX_OUTPUTS; i++) fzzSystem.output[i] = 0;
-    
-    //list of fuzzy inference rules
-    fzzSystem.ruLen = 0;
-    for(i = 0; i < MAX_RULES; i++) fzzSystem.rule[i][0] = '\0';
+    mem = block->data + block->used;
+    block->used += size;
+    memset(mem, 0, size);
+    return mem;
 }
 
-void fzz_deinit(){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_deinit()\n");
-    fclose(fzz_logFile);
-    fzz_logFile = NULL;
-    #endif
+/**
+ * @brief Allocates copy of string from arena
+ * Internal function
+ * @param arena memory arena
+ * @param str copied string
+ * @return allocated copy
+ */
+char* fzz_arenaString(TArena* arena, const char* str){
+    char* copy = (char*)fzz_arenaAlloc(arena, strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
 }
-    
-void fzz_initInputFcns(int index, int length, char* name){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_initInputFcns(%d, %d, %s)\n", index, length, name);
-    #endif
-    assert(index < fzzSystem.inLen && "Index out of range in fzz_initInputFcns(...)");
-    assert(length <= MAX_FSETS && "Required number of fuzzy sets exceeds maximum in fzz_initInputFcns(...)");
-    fzzSystem.inSet[index].length = length;
-    strncpy(fzzSystem.inSet[index].name, name, NAME_LENGTH);
+
+/**
+ * @brief Releases all memory of arena
+ * Internal function
+ * @param arena memory arena
+ */
+void fzz_arenaFree(TArena* arena){
+    TArenaBlock* block = arena->head;
+    TArenaBlock* next = NULL;
+    while(block != NULL){
+        next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
 }
 
-void fzz_initOutputFcns(int index, int length, char* name){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_initOutputFcns(%d, %d, %s)\n", index, length, name);
+/**
+ * @brief Releases memory of loaded fuzzy system file
+ * Internal function
+ * @param data file memory
+ * @param size size of file
+ */
+void fzz_fileRelease(void* data, size_t size){
+    #ifdef FZZ_MMAP
+    munmap(data, size);
+    #else
+    free(data);
     #endif
-    assert(index < fzzSystem.outLen && "Index out of range in fzz_initOutputFcns(...)");
-    assert(length <= MAX_FSETS && "Required number of fuzzy sets exceeds maximum in fzz_initOutputFcns(...)");
-    fzzSystem.outSet[index].length = length;
-    strncpy(fzzSystem.outSet[index].name, name, NAME_LENGTH);
 }
 
-void fzz_setInputFcn(int index, int fcSet, double left, double top, double right, char* name){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_setInputFcn(%d, %d, %f, %f, %f, %s)\n", index, fcSet, left, top, right, name);
-    #endif
-    assert(fcSet < fzzSystem.inLen && "Input set index out of range in fzz_setInputFcn(...)");
-    assert(index < fzzSystem.inSet[fcSet].length && "Index out of range in fzz_setInputFcn(...)");
+///////////////////////////////////////////////////
+//////// Fuzzy system functions ///////////////////
+///////////////////////////////////////////////////
+
+TFzzSystem* fzz_create(int inputs, int outputs){
+    TArena arena = {NULL};
+    TFzzSystem* sys = NULL;
+    int i = 0;
+
+    //input and output count check
+    assert(inputs > 0 && outputs > 0 && "Invalid number of inputs or outputs in fzz_create(...)");
     
-    //membership function
-    fzzSystem.inSet[fcSet].fSet[index].left = left;
-    fzzSystem.inSet[fcSet].fSet[index].top = top;
-    fzzSystem.inSet[fcSet].fSet[index].right = right;
+    //system is the first item of its arena
+    sys = (TFzzSystem*)fzz_arenaAlloc(&arena, sizeof(TFzzSystem));
+    sys->inSet = (TFcnsSet*)fzz_arenaAlloc(&arena, sizeof(TFcnsSet)*inputs);
+    sys->outSet = (TFcnsSet*)fzz_arenaAlloc(&arena, sizeof(TFcnsSet)*outputs);
     
-    //fuzzy set name
-    strncpy(fzzSystem.inSet[fcSet].fSet[index].name, name, NAME_LENGTH);
-}
-
-void fzz_setOutputFcn(int index, int fcSet, double left, double top, double right, char* name){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_setOutputFcn(%d, %d, %f, %f, %f, %s)\n", index, fcSet, left, top, right, name);
-    #endif
-    assert(fcSet < fzzSystem.outLen && "Output set index out of range in fzz_setOutputFcn(...)");
-    assert(index < fzzSystem.outSet[fcSet].length && "Index out of range in fzz_setOutputFcn(...)");
+    //number of inputs and outputs
+    sys->inLen = inputs;
+    sys->outLen = outputs;
     
-    //membership function
-    fzzSystem.outSet[fcSet].fSet[index].left = left;
-    fzzSystem.outSet[fcSet].fSet[index].top = top;
-    fzzSystem.outSet[fcSet].fSet[index].right = right;
+    //init of sets of fuzzy sets (no fuzzy sets yet)
+    for(i = 0; i < inputs; i++) sys->inSet[i].defuzz = FZZ_COG_STEP;
+    for(i = 0; i < outputs; i++) sys->outSet[i].defuzz = FZZ_COG_STEP;
     
-    //fuzzy set name
-    strncpy(fzzSystem.outSet[fcSet].fSet[index].name, name, NAME_LENGTH);
-}
+    //list of fuzzy inference rules
+    sys->ruLen = 0;
+    sys->ruCapacity = 0;
+    sys->pending = NULL;
+    sys->pendingLen = 0;
+    
+    //system is not baked
+    sys->lut.table = NULL;
+    sys->lut.res = 0;
+    sys->lut.from = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*inputs);
+    sys->lut.step = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*inputs);
+    sys->lut.stride = (int*)fzz_arenaAlloc(&arena, sizeof(int)*inputs);
+    
+    //system is not compiled to fixed point
+    sys->fixed.memory = NULL;
+    
+    //default operators, min and max
+    sys->andOp = FZZ_MIN;
+    sys->orOp = FZZ_MAX;
+    sys->implication = FZZ_MIN;
+    sys->aggregation = FZZ_MAX;
+    sys->samples = 0;
+    sys->published = 0;
+    
+    sys->revision = ATOMIC_INCREMENT(&fzzRevision);
+    sys->mapping = NULL;
+    sys->mappingSize = 0;
+    sys->arena = arena;
+    return sys;
+}
 
-void fzz_addRule(char* rule){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_addRule(%s)\n", rule);
-    #endif
-    assert(fzzSystem.ruLen < MAX_RULES && "Maximum number of inferential mechanism rules exceeded in addRule(...)");
-    strncpy(fzzSystem.rule[fzzSystem.ruLen], rule, RULE_LENGTH);
-    fzzSystem.ruLen++;
+void fzz_destroy(TFzzSystem* sys){
+    TArena arena = sys->arena;
+    
+    //lookup table of loaded system is part of file memory
+    if(sys->mapping != NULL)
+        fzz_fileRelease(sys->mapping, sys->mappingSize);
+    else
+        free(sys->lut.table);
+    free(sys->fixed.memory);
+    
+    //system itself is released with its arena
+    fzz_arenaFree(&arena);
 }
 
-void fzz_setInput(int index, double value){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_setInput(%d, %f)\n", index, value);
-    #endif
-    assert(index < fzzSystem.inLen && "Index out of range in fzz_setInput(...)");
-    fzzSystem.input[index] = value;
+/**
+ * @brief Has to be called when system is modified
+ * Internal function, drops data derived from system (lookup table
+ * and fixed point form) and makes contexts created for previous 
+ * revision invalid; revision is unique among all systems, so context
+ * of destroyed system is not valid for system created at its address
+ * @param sys fuzzy system
+ */
+void fzz_modified(TFzzSystem* sys){
+    assert(!sys->published && "Published system is read only in fzz_modified(...)");
+    fzz_unbakeEx(sys);
+    free(sys->fixed.memory);
+    sys->fixed.memory = NULL;
+    sys->revision = ATOMIC_INCREMENT(&fzzRevision);
 }
 
-double fzz_getOutput(int index){
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_getOutput(%d)\n", index);
-    #endif
-    assert(index < fzzSystem.outLen && "Index out of range in fzz_getOutput(...)");
-    return fzzSystem.output[index];
+//rules are compiled again by fuzzy system functions defined before them
+const char* fzz_recompileRules(TFzzSystem* sys);
+
+/**
+ * @brief Allocates fuzzy sets of set of fuzzy sets
+ * Internal function
+ * @param sys fuzzy system
+ * @param set set of fuzzy sets
+ * @param length required number of fuzzy sets
+ * @param name name of set of fuzzy sets
+ */
+void fzz_initFcns(TFzzSystem* sys, TFcnsSet* set, int length, const char* name){
+    int i = 0;
+    
+    set->length = length;
+    set->name = fzz_arenaString(&sys->arena, name);
+    set->fSet = (TFuzzySet*)fzz_arenaAlloc(&sys->arena, sizeof(TFuzzySet)*length);
+    for(i = 0; i < length; i++) set->fSet[i].name = "";
+    set->left = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->top = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->topEnd = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->right = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->kLeft = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->kRight = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*FSETS_PAD(length));
+    set->curved = 0;
+    set->rules = (TRuleList*)fzz_arenaAlloc(&sys->arena, sizeof(TRuleList)*length);
+    set->functions.rule = NULL;
+    set->functions.length = 0;
+    set->functions.capacity = 0;
+}
+    
+void fzz_initInputFcnsEx(TFzzSystem* sys, int index, int length, const char* name){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_initInputFcns(...)");
+    assert(index < sys->inLen && "Index out of range in fzz_initInputFcns(...)");
+    assert(length >= 0 && "Invalid number of fuzzy sets in fzz_initInputFcns(...)");
+    fzz_initFcns(sys, &sys->inSet[index], length, name);
+    fzz_modified(sys);
+    if(sys->ruLen > 0 || sys->pendingLen > 0) fzz_recompileRules(sys);
+}
+
+void fzz_initOutputFcnsEx(TFzzSystem* sys, int index, int length, const char* name){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_initOutputFcns(...)");
+    assert(index < sys->outLen && "Index out of range in fzz_initOutputFcns(...)");
+    assert(length >= 0 && "Invalid number of fuzzy sets in fzz_initOutputFcns(...)");
+    fzz_initFcns(sys, &sys->outSet[index], length, name);
+    fzz_modified(sys);
+    if(sys->ruLen > 0 || sys->pendingLen > 0) fzz_recompileRules(sys);
+}
+
+/**
+ * @brief Detects kind of partition of input fuzzy sets
+ * Internal function, see PARTITION_NONE; curved input has no partition
+ * and uniform partition has triangles only
+ * @param set set of input fuzzy sets
+ */
+void fzz_detectPartition(TFcnsSet* set){
+    TFzzReal step = 0;
+    TFzzReal tolerance = 0;
+    TFzzReal top = 0;
+    int uniform = 1;
+    int i = 0;
+    
+    set->partition = PARTITION_NONE;
+    if(set->length < PARTITION_MIN_SETS || set->curved) return;
+    
+    //sorted left and right points
+    for(i = 1; i < set->length; i++)
+        if(set->left[i] < set->left[i-1] || set->right[i] < set->right[i-1]) return;
+    set->partition = PARTITION_SORTED;
+    
+    //tops in grid, sides reach neighbour tops
+    step = (set->top[set->length-1] - set->top[0]) / (set->length - 1);
+    tolerance = (TFzzReal)PARTITION_TOLERANCE*step;
+    if(!(step > 0)) return;
+    for(i = 0; i < set->length && uniform; i++){
+        top = set->top[0] + i*step;
+        if(fabs(set->top[i] - top) > tolerance || set->topEnd[i] != set->top[i]) uniform = 0;
+        if(i > 0 && fabs(set->left[i] - (top - step)) > tolerance) uniform = 0;
+        if(i < set->length-1 && fabs(set->right[i] - (top + step)) > tolerance) uniform = 0;
+    }
+    if(set->left[0] > set->top[0] - step + tolerance) uniform = 0;
+    if(set->right[set->length-1] < set->top[set->length-1] + step - tolerance) uniform = 0;
+    if(!uniform) return;
+    set->partition = PARTITION_UNIFORM;
+    set->gridFrom = set->top[0];
+    set->gridStep = step;
+}
+
+/**
+ * @brief Stores shape of membership function of fuzzy set
+ * Internal function, points of shape are stored in fuzzy set and in 
+ * structure of arrays (with open sides for input shoulders), partition 
+ * of input is detected again
+ * @param set set of fuzzy sets
+ * @param index index of fuzzy set
+ * @param shape shape of membership function
+ * @param params parameters of shape
+ * @param input 1 for input set of fuzzy sets, 0 for output
+ */
+void fzz_shapeFcn(TFcnsSet* set, int index, TFzzShape shape, const double* params, int input){
+    TFuzzySet* fs = &set->fSet[index];
+    double left = params[0];
+    double top = params[0];
+    double topEnd = params[0];
+    double right = params[0];
+    int i = 0;
+    
+    //four points of shape
+    switch(shape){
+        case FZZ_TRIANGLE: top = topEnd = params[1]; right = params[2]; break;
+        case FZZ_TRAPEZOID: top = params[1]; topEnd = params[2]; right = params[3]; break;
+        case FZZ_LEFT_SHOULDER: topEnd = params[1]; right = params[2]; break;
+        case FZZ_RIGHT_SHOULDER: top = params[1]; topEnd = right = params[2]; break;
+        case FZZ_GAUSSIAN: left = params[0] - GAUSS_CUT*params[1]; right = params[0] + GAUSS_CUT*params[1]; break;
+        default: break;
+    }
+    
+    //membership function
+    fs->left = left;
+    fs->top = top;
+    fs->topEnd = topEnd;
+    fs->right = right;
+    fs->shape = shape;
+    
+    //membership function as structure of arrays
+    set->left[index] = left;
+    set->top[index] = top;
+    set->topEnd[index] = topEnd;
+    set->right[index] = right;
+    set->kLeft[index] = 1.0 / (top - left);
+    set->kRight[index] = 1.0 / (topEnd - right);
+    if(shape == FZZ_GAUSSIAN){
+        set->kLeft[index] = 1.0 / (2*params[1]*params[1]);
+        set->kRight[index] = 0;
+    }
+    if(shape == FZZ_SINGLETON){
+        set->kLeft[index] = 0;
+        set->kRight[index] = 0;
+    }
+    
+    //open sides of input shoulders
+    if(input && shape == FZZ_LEFT_SHOULDER){
+        set->left[index] = set->top[index] = -REAL_MAX;
+        set->kLeft[index] = 0;
+    }
+    if(input && shape == FZZ_RIGHT_SHOULDER){
+        set->topEnd[index] = set->right[index] = REAL_MAX;
+        set->kRight[index] = 0;
+    }
+    if(input){
+        set->curved = 0;
+        for(i = 0; i < set->length; i++)
+            if(set->fSet[i].shape == FZZ_GAUSSIAN || set->fSet[i].shape == FZZ_SINGLETON) set->curved = 1;
+        fzz_detectPartition(set);
+    }
+}
+
+/**
+ * @brief Sets membership function of fuzzy set
+ * Internal function
+ * @see fzz_shapeFcn
+ * @param sys fuzzy system
+ * @param set set of fuzzy sets
+ * @param index index of fuzzy set
+ * @param shape shape of membership function
+ * @param params parameters of shape
+ * @param name name of fuzzy set
+ * @param input 1 for input set of fuzzy sets, 0 for output
+ */
+void fzz_setFcn(TFzzSystem* sys, TFcnsSet* set, int index, TFzzShape shape, const double* params, const char* name, int input){
+    fzz_shapeFcn(set, index, shape, params, input);
+    set->fSet[index].name = fzz_arenaString(&sys->arena, name);
+    fzz_modified(sys);
+    if(sys->pendingLen > 0) fzz_recompileRules(sys);
+}
+
+/**
+ * @brief Checks parameters of shape of fuzzy set
+ * Internal function
+ * @param shape shape of membership function
+ * @param params parameters of shape
+ * @return 1 if shape is valid, 0 otherwise
+ */
+int fzz_validShape(TFzzShape shape, const double* params){
+    int i = 0;
+    
+    if(shape < FZZ_TRIANGLE || shape > FZZ_SINGLETON) return 0;
+    if(shape == FZZ_GAUSSIAN) return params[1] > 0;
+    for(i = 1; i < fzzShapeParams[shape]; i++)
+        if(!(params[i-1] <= params[i])) return 0;
+    return 1;
+}
+
+void fzz_setInputFcnEx(TFzzSystem* sys, int index, int fcSet, double left, double top, double right, const char* name){
+    double params[3];
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setInputFcn(...)");
+    assert(fcSet < sys->inLen && "Input set index out of range in fzz_setInputFcn(...)");
+    assert(index < sys->inSet[fcSet].length && "Index out of range in fzz_setInputFcn(...)");
+    params[0] = left;
+    params[1] = top;
+    params[2] = right;
+    fzz_setFcn(sys, &sys->inSet[fcSet], index, FZZ_TRIANGLE, params, name, 1);
+}
+
+void fzz_setOutputFcnEx(TFzzSystem* sys, int index, int fcSet, double left, double top, double right, const char* name){
+    double params[3];
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setOutputFcn(...)");
+    assert(fcSet < sys->outLen && "Output set index out of range in fzz_setOutputFcn(...)");
+    assert(index < sys->outSet[fcSet].length && "Index out of range in fzz_setOutputFcn(...)");
+    params[0] = left;
+    params[1] = top;
+    params[2] = right;
+    fzz_setFcn(sys, &sys->outSet[fcSet], index, FZZ_TRIANGLE, params, name, 0);
+}
+
+void fzz_setInputShapeEx(TFzzSystem* sys, int index, int fcSet, TFzzShape shape, const double* params, const char* name){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setInputShape(...)");
+    assert(fcSet < sys->inLen && "Input set index out of range in fzz_setInputShape(...)");
+    assert(index < sys->inSet[fcSet].length && "Index out of range in fzz_setInputShape(...)");
+    assert(fzz_validShape(shape, params) && "Invalid shape or parameters of fuzzy set in fzz_setInputShape(...)");
+    fzz_setFcn(sys, &sys->inSet[fcSet], index, shape, params, name, 1);
+}
+
+void fzz_setOutputShapeEx(TFzzSystem* sys, int index, int fcSet, TFzzShape shape, const double* params, const char* name){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setOutputShape(...)");
+    assert(fcSet < sys->outLen && "Output set index out of range in fzz_setOutputShape(...)");
+    assert(index < sys->outSet[fcSet].length && "Index out of range in fzz_setOutputShape(...)");
+    assert(fzz_validShape(shape, params) && "Invalid shape or parameters of fuzzy set in fzz_setOutputShape(...)");
+    fzz_setFcn(sys, &sys->outSet[fcSet], index, shape, params, name, 0);
+}
+
+void fzz_setDefuzzMethodEx(TFzzSystem* sys, int output, TDefuzzMethod method){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setDefuzzMethod(...)");
+    assert(output < sys->outLen && "Index out of range in fzz_setDefuzzMethod(...)");
+    sys->outSet[output].defuzz = method;
+    fzz_modified(sys);
+}
+
+/**
+ * @brief Checks fuzzy operators of inference
+ * Internal function
+ * @return 1 if and and implication are t-norms and or and aggregation 
+ * are s-norms, 0 otherwise
+ */
+int fzz_validOperators(int andOp, int orOp, int implication, int aggregation){
+    if(andOp != FZZ_MIN && andOp != FZZ_PRODUCT) return 0;
+    if(implication != FZZ_MIN && implication != FZZ_PRODUCT) return 0;
+    if(orOp < FZZ_MAX || orOp > FZZ_BOUNDED_SUM) return 0;
+    if(aggregation < FZZ_MAX || aggregation > FZZ_BOUNDED_SUM) return 0;
+    return 1;
+}
+
+/**
+ * @brief Selects evaluation of antecedent of compiled rule
+ * Internal function, kind is given by connective, its operator,
+ * negated conditions and weight
+ * @param sys fuzzy system
+ * @param rule compiled rule
+ */
+void fzz_ruleKind(const TFzzSystem* sys, TRule* rule){
+    int negated = 0;
+    int i = 0;
+    
+    for(i = 0; i < rule->inLen; i++)
+        if(rule->negated[i]) negated = 1;
+    
+    //rule without negated condition joined by and is evaluated only when all conditions are hit
+    rule->need = 1;
+    if(rule->connective == CONNECTIVE_OR){
+        if(sys->orOp == FZZ_PROBOR) rule->kind = RULE_OR_PROBOR;
+        else if(sys->orOp == FZZ_BOUNDED_SUM) rule->kind = RULE_OR_BOUNDED_SUM;
+        else rule->kind = RULE_OR_MAX;
+    }else{
+        if(sys->andOp == FZZ_PRODUCT) rule->kind = RULE_AND_PRODUCT;
+        else rule->kind = negated || rule->weight != 1 ? RULE_AND_MIN : RULE_MIN;
+        if(!negated) rule->need = rule->inLen;
+    }
+}
+
+void fzz_setOperatorsEx(TFzzSystem* sys, TFzzOperator andOp, TFzzOperator orOp, TFzzOperator implication, TFzzOperator aggregation){
+    int i = 0;
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setOperators(...)");
+    assert(fzz_validOperators(andOp, orOp, implication, aggregation) && "Invalid t-norm or s-norm in fzz_setOperators(...)");
+    sys->andOp = andOp;
+    sys->orOp = orOp;
+    sys->implication = implication;
+    sys->aggregation = aggregation;
+    
+    //evaluation of compiled rules is specialized for new operators
+    for(i = 0; i < sys->ruLen; i++) fzz_ruleKind(sys, &sys->ruleData[i]);
+    fzz_modified(sys);
+}
+
+void fzz_setRealtimeEx(TFzzSystem* sys, int samples){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_setRealtime(...)");
+    assert((samples == 0 || samples >= 2) && "Invalid number of samples in fzz_setRealtime(...)");
+    sys->samples = samples;
+    fzz_modified(sys);
 }
 
 /**
  * @brief Returns index of input with given name
  * Internal function
+ * @param sys fuzzy system
  * @param name name of input set of fuzzy sets
  * @return index if found, -1 if not
  */
-int fzz_inputIndex(char* name){
+int fzz_inputIndex(const TFzzSystem* sys, const char* name){
     int i = 0;
     //search inputs
-    for(i = 0; i < fzzSystem.inLen; i++){
-        if(!strcmp(name, fzzSystem.inSet[i].name)) 
+    for(i = 0; i < sys->inLen; i++){
+        if(!strcmp(name, sys->inSet[i].name)) 
             return i;
     }
     //nothing found
@@ -345,14 +1615,15 @@ int fzz_inputIndex(char* name){
 /**
  * @brief Returns index of output with given name
  * Internal function
+ * @param sys fuzzy system
  * @param name name of output set of fuzzy sets
  * @return index if found, -1 if not
  */
-int fzz_outputIndex(char* name){
+int fzz_outputIndex(const TFzzSystem* sys, const char* name){
     int i = 0;
     //search inputs
-    for(i = 0; i < fzzSystem.outLen; i++){
-        if(!strcmp(name, fzzSystem.outSet[i].name)) 
+    for(i = 0; i < sys->outLen; i++){
+        if(!strcmp(name, sys->outSet[i].name)) 
             return i;
     }
     //nothing found
@@ -362,15 +1633,16 @@ int fzz_outputIndex(char* name){
 /**
  * @brief Returns index of fuzzy set for given input
  * Internal function
+ * @param sys fuzzy system
  * @param name name of fuzzy set
  * @param index index of input
  * @return index if found, -1 if not
  */
-int fzz_inputFSetIndex(int index, char* name){
+int fzz_inputFSetIndex(const TFzzSystem* sys, int index, const char* name){
     int i = 0;
     //search inputs
-    for(i = 0; i < fzzSystem.inSet[index].length; i++){
-        if(!strcmp(name, fzzSystem.inSet[index].fSet[i].name)) 
+    for(i = 0; i < sys->inSet[index].length; i++){
+        if(!strcmp(name, sys->inSet[index].fSet[i].name)) 
             return i;
     }
     //nothing found
@@ -380,15 +1652,16 @@ int fzz_inputFSetIndex(int index, char* name){
 /**
  * @brief Returns index of fuzzy set for given output
  * Internal function
+ * @param sys fuzzy system
  * @param namev name of fuzzy set
  * @param index index of output
  * @return index if found, -1 if not
  */
-int fzz_outputFSetIndex(int index, char* name){
+int fzz_outputFSetIndex(const TFzzSystem* sys, int index, const char* name){
     int i = 0;
     //search inputs
-    for(i = 0; i < fzzSystem.outSet[index].length; i++){
-        if(!strcmp(name, fzzSystem.outSet[index].fSet[i].name)) 
+    for(i = 0; i < sys->outSet[index].length; i++){
+        if(!strcmp(name, sys->outSet[index].fSet[i].name)) 
             return i;
     }
     //nothing found
@@ -396,448 +1669,5785 @@ int fzz_outputFSetIndex(int index, char* name){
 }
 
 /**
- * @brief Calculates fuzzified value of input with given index
+ * @brief Appends rule index to list of rules
  * Internal function
- * @param index index of input and index of input set
- * @param fzOut output data pointer
+ * @param sys fuzzy system
+ * @param list list of rules
+ * @param ruleIndex index of rule
  */
-void fzz_fuzzify(int in){
-    int i = 0;
+void fzz_ruleListPush(TFzzSystem* sys, TRuleList* list, int ruleIndex){
+    int* rules = NULL;
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_fuzzify(%d)\n", in);
-    #endif
+    //capacity of list is doubled when it is full
+    if(list->length == list->capacity){
+        list->capacity = list->capacity > 0 ? 2*list->capacity : 4;
+        rules = (int*)fzz_arenaAlloc(&sys->arena, sizeof(int)*list->capacity);
+        if(list->length > 0) memcpy(rules, list->rule, sizeof(int)*list->length);
+        list->rule = rules;
+    }
+    list->rule[list->length++] = ruleIndex;
+}
+
+/**
+ * @brief Parses linear function of inputs in consequent of rule
+ * Internal function, function is sum of terms separated by + or -, 
+ * term is number, input name or number*name (spaces are optional),
+ * e.g. "0.3*distance - speed + 0.1"
+ * @param sys fuzzy system
+ * @param rule compiled rule, coefficients are stored there
+ * @param text text of function
+ * @return NULL on success, description of error otherwise
+ */
+const char* fzz_compileFunction(TFzzSystem* sys, TRule* rule, const char* text){
+    TFzzReal* coefs = NULL;
+    const char* end = NULL;
+    char* name = NULL;
+    double sign = 1;
+    double number = 0;
+    int words = 0;
+    int scaled = 0;
+    int var = 0;
+    int len = 0;
     
-    //through all fuzzy sets of given output
-    for(i = 0; i < fzzSystem.inSet[in].length; i++){
-        //input value intersects fuzzy set
-        if(fzzSystem.input[in] <= fzzSystem.inSet[in].fSet[i].left) continue;
-        if(fzzSystem.input[in] >= fzzSystem.inSet[in].fSet[i].right) continue;
-        
-        //input intersects left part of fuzzy set
-        if(fzzSystem.input[in] <= fzzSystem.inSet[in].fSet[i].top){
-            double k = 1.0 / (fzzSystem.inSet[in].fSet[i].top - fzzSystem.inSet[in].fSet[i].left); 
-            double x = fzzSystem.input[in] - fzzSystem.inSet[in].fSet[i].left;
-            fzfOut[in].res[fzfOut[in].length].membership = k*x;           
-        }
-        //input intersects right part of fuzzy set
-        else{
-            double k = 1.0 / (fzzSystem.inSet[in].fSet[i].top - fzzSystem.inSet[in].fSet[i].right); 
-            double x = fzzSystem.input[in] - fzzSystem.inSet[in].fSet[i].top;
-            fzfOut[in].res[fzfOut[in].length].membership = k*x + 1;
+    coefs = (TFzzReal*)fzz_arenaAlloc(&sys->arena, sizeof(TFzzReal)*(sys->inLen + 1));
+    name = (char*)malloc(strlen(text) + 1);
+    assert(name != NULL && "Memory allocation failed in fzz_addRule(...)");
+    
+    while(1){
+        //sign of term, the first one is optional
+        while(*text == ' ') text++;
+        if(*text == '\0' && words > 0) break;
+        if(*text == '+' || *text == '-'){
+            sign = *text == '-' ? -1 : 1;
+            text++;
+            while(*text == ' ') text++;
+        }else if(words > 0){
+            free(name);
+            return "Invalid linear function in consequent, expecting '+' or '-'";
+        }
+        if(*text == '\0'){
+            free(name);
+            return "Invalid linear function in consequent, expecting term after sign";
         }
+        words++;
         
-        #ifdef DEBUG_MODE
-        fprintf(fzz_logFile, "%s - %s: x=%f, A(x)=%f\n", 
-            fzzSystem.inSet[in].name, 
-            fzzSystem.inSet[in].fSet[i].name, 
-            fzzSystem.input[in], 
-            fzfOut[in].res[fzfOut[in].length].membership
-        );
-        #endif
+        //number, word beginning with number (like inf) is name
+        number = 1;
+        scaled = 0;
+        end = text;
+        if(*text != '\0') number = strtod(text, (char**)&end);
+        if(end != text && strchr(" *+-", *end) != NULL){
+            text = end;
+            while(*text == ' ') text++;
+            if(*text != '*'){
+                coefs[0] += (TFzzReal)(sign*number);
+                continue;
+            }
+            text++;
+            while(*text == ' ') text++;
+            scaled = 1;
+        }else{
+            number = 1;
+        }
         
-        //fuzzy set name and index
-        fzfOut[in].res[fzfOut[in].length].setIndex = i;
-        fzfOut[in].length++; 
+        //name of input
+        for(len = 0; text[len] != '\0' && strchr(" *+-", text[len]) == NULL; len++) name[len] = text[len];
+        name[len] = '\0';
+        text += len;
+        var = len > 0 ? fzz_inputIndex(sys, name) : -1;
+        if(var == -1){
+            free(name);
+            //single unknown word is reported as fuzzy set
+            while(*text == ' ') text++;
+            if(words == 1 && !scaled && *text == '\0') return "Output fuzzy set name not found";
+            return "Input name not found in linear function in consequent";
+        }
+        coefs[1 + var] += (TFzzReal)(sign*number);
     }
+    
+    free(name);
+    rule->coefs = coefs;
+    return NULL;
 }
 
 /**
- * @brief Takes rule and process it
- * Internal function
+ * @brief Parses rule text and stores it in compiled form
+ * Internal function, names are resolved to indexes so that
+ * inferential mechanism does not work with strings; words of rule
+ * are separated by spaces, length of words is not limited
+ * @param sys fuzzy system
  * @param ruleIndex index of rule
+ * @return NULL on success, description of error otherwise
  */
-void fzz_ininference(int ruleIndex){
+const char* fzz_compileRule(TFzzSystem* sys, int ruleIndex){
     //state machine
+    const char* error = NULL;
     int state = 0;
+    int start = 0;
     int i = 0;
     char ch = 0;
-    char wbuf[WBUF_LENGTH];
-    int wbufLen = 0;
-    
-    //parsing result variables
-    int inputs[MAX_INPUTS];    
-    int inSets[MAX_INPUTS];
-    int inLen = 0;
-    int output = 0;
-    int outSet = 0;
+    char* text = NULL;
+    char* word = NULL;
+    char* with = NULL;
+    char* end = NULL;
+    double weight = 1;
     
-    //other variables
+    //parsing result
+    TRule* rule = &sys->ruleData[ruleIndex];
+    int connective = -1;
+    int capacity = 1;
     int var = 0;
-    int j = 0;
-    int k = 0;
-    int match = 0;
-    double min = 0;
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_ininference(%d)\n", ruleIndex);
-    #endif
-            
+    //every condition except the last one takes at least 4 words
+    for(i = 0; sys->rule[ruleIndex][i] != '\0'; i++)
+        if(sys->rule[ruleIndex][i] == ' ') capacity++;
+    capacity = capacity / 4 + 1;
+    rule->inputs = (int*)fzz_arenaAlloc(&sys->arena, sizeof(int)*capacity);
+    rule->inSets = (int*)fzz_arenaAlloc(&sys->arena, sizeof(int)*capacity);
+    rule->negated = (int*)fzz_arenaAlloc(&sys->arena, sizeof(int)*capacity);
+    rule->inLen = 0;
+    rule->connective = CONNECTIVE_AND;
+    rule->output = 0;
+    rule->outSet = 0;
+    rule->coefs = NULL;
+    rule->weight = 1;
+    
+    //words are terminated in working copy of rule text
+    text = (char*)malloc(i + 1);
+    assert(text != NULL && "Memory allocation failed in fzz_addRule(...)");
+    strcpy(text, sys->rule[ruleIndex]);
+    i = 0;
+    
     //state machine to process inferential mechanism rule
-    while((ch = fzzSystem.rule[ruleIndex][i]) != '\0'){
+    while(error == NULL && (ch = text[i]) != '\0'){
+        //word is complete
+        if(ch == ' ' && i > start && state != 7){
+            text[i] = '\0';
+            word = text + start;
+        }else{
+            //repeated spaces are skipped
+            if(ch == ' ' && state != 7) start = i + 1;
+            i++;
+            continue;
+        }
+        
         switch(state){
             //initial state (expecting if)
             case 0:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    assert(!strcmp(wbuf, "if") && "Invalid rule syntax, expecting 'if' at the beginning of rule in fzz_ininference(...)");
-                    wbufLen = 0;
-                    state = 1;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
-                }
+                if(strcmp(word, "if")) error = "Invalid rule syntax, expecting 'if' at the beginning of rule";
+                state = 1;
                 break;
             
             //expecting name of input
             case 1:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    var = fzz_inputIndex(wbuf);
-                    assert(var != -1 && "Input name not found in fzz_ininference(...)");
-                    inputs[inLen] = var;
-                    wbufLen = 0;
-                    state = 2;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
-                }
+                var = fzz_inputIndex(sys, word);
+                if(var == -1) error = "Input name not found";
+                else if(rule->inLen >= capacity) error = "Too many conditions in rule";
+                else rule->inputs[rule->inLen] = var;
+                state = 2;
                 break;
                 
             //expecting is
             case 2:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    assert(!strcmp(wbuf, "is") && "Invalid rule syntax, expecting 'is' after input name in fzz_ininference(...)");
-                    wbufLen = 0;
-                    state = 3;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
-                }
+                if(strcmp(word, "is")) error = "Invalid rule syntax, expecting 'is' after input name";
+                state = 3;
                 break;
                 
-            //expecting name of input fuzzy set
+            //expecting not or name of input fuzzy set
             case 3:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    var = fzz_inputFSetIndex(inputs[inLen], wbuf);
-                    assert(var != -1 && "Input fuzzy set name not found in fzz_ininference(...)");
-                    inSets[inLen] = var;
-                    inLen++;
-                    wbufLen = 0;
-                    state = 4;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
+                if(!strcmp(word, "not") && !rule->negated[rule->inLen] && fzz_inputFSetIndex(sys, rule->inputs[rule->inLen], word) == -1){
+                    rule->negated[rule->inLen] = 1;
+                    break;
                 }
+                var = fzz_inputFSetIndex(sys, rule->inputs[rule->inLen], word);
+                if(var == -1) error = "Input fuzzy set name not found";
+                rule->inSets[rule->inLen] = var;
+                rule->inLen++;
+                state = 4;
                 break;
                         
-            //expecting if or then
+            //expecting and, or or then; one rule uses one connective
             case 4:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    //printf("%s\n", wbuf);
-                    if(!strcmp(wbuf, "and"))  state = 1;
-                    else if(!strcmp(wbuf, "then")) state = 5;
-                    else assert(0 && "Invalid rule syntax, expecting 'and' or 'then' after input fuzzy set name in fzz_ininference(...)"); 
-                    wbufLen = 0;
+                if(!strcmp(word, "and") || !strcmp(word, "or")){
+                    var = !strcmp(word, "or") ? CONNECTIVE_OR : CONNECTIVE_AND;
+                    if(connective != -1 && connective != var) error = "Invalid rule syntax, 'and' and 'or' can not be mixed in rule";
+                    connective = rule->connective = var;
+                    state = 1;
+                }else if(!strcmp(word, "then")){
+                    state = 5;
                 }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
+                    error = "Invalid rule syntax, expecting 'and', 'or' or 'then' after input fuzzy set name"; 
                 }
                 break;
                 
             //expecting name of output
             case 5:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    output = fzz_outputIndex(wbuf);
-                    assert(output != -1 && "Output name not found in fzz_ininference(...)");
-                    wbufLen = 0;
-                    state = 6;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
-                }
+                rule->output = fzz_outputIndex(sys, word);
+                if(rule->output == -1) error = "Output name not found";
+                state = 6;
                 break;
                 
             //expecting is
             case 6:
-                if(ch == ' '){
-                    wbuf[wbufLen] = '\0';
-                    assert(!strcmp(wbuf, "is") && "Invalid rule syntax, expecting 'is' after output name in fzz_ininference(...)");
-                    wbufLen = 0;
-                    state = 7;
-                }else{
-                    wbuf[wbufLen] = ch;
-                    wbufLen++;
-                }
-                break;
-                
-            //expecting name of output fuzzy set
-            case 7:
-                wbuf[wbufLen] = ch;
-                wbufLen++;
+                if(strcmp(word, "is")) error = "Invalid rule syntax, expecting 'is' after output name";
+                state = 7;
                 break;
         }
         i++;
+        start = i;
     }
     
-    //finishig state mechine run
-    wbuf[wbufLen] = '\0';
-    outSet = fzz_outputFSetIndex(output, wbuf);
-    assert(outSet != -1 && "Output fuzzy set name not found in fzz_ininference(...)");
-    wbufLen = 0;
-    wbuf[0] = '\0';
-    
-    //evaluation of parsed rule
-    match = 0;
-    min = 0;
-    for(i = 0; i < fzzSystem.inLen; i++){
-        //search for first input in parsed data
-        for(j = 0; j < inLen; j++){
-            if(i == inputs[j]){
-                //search for fuzzy set in fuzzyfication result
-                for(k = 0; k < fzfOut[i].length; k++){
-                    if(fzfOut[i].res[k].setIndex == inSets[j]){
-                        if(match == 0){
-                            min = fzfOut[i].res[k].membership;
-                        }else if(fzfOut[i].res[k].membership < min){
-                            min = fzfOut[i].res[k].membership;
-                        }
-                        match++;
-                    }
-                }
-                break;
-            }
+    //finishig state mechine run, the rest of rule is name of output fuzzy set
+    //or linear function of inputs
+    if(error == NULL && (state != 7 || text[start] == '\0')) 
+        error = "Invalid rule syntax, rule is incomplete";
+    
+    //consequent can end with weight of rule ("with 0.5")
+    if(error == NULL){
+        for(word = strstr(text + start, " with "); word != NULL; word = strstr(word + 1, " with ")) with = word;
+        if(with != NULL) weight = strtod(with + 6, &end);
+        while(end != NULL && *end == ' ') end++;
+        if(with != NULL && end != with + 6 && *end == '\0'){
+            if(!(weight > 0 && weight <= 1)) error = "Weight of rule has to be in range (0, 1]";
+            rule->weight = (TFzzReal)weight;
+            for(; with > text + start && with[-1] == ' '; with--);
+            *with = '\0';
         }
     }
+    if(error == NULL){
+        rule->outSet = fzz_outputFSetIndex(sys, rule->output, text + start);
+        if(rule->outSet == -1) error = fzz_compileFunction(sys, rule, text + start);
+    }
     
-    //saving evaluation result
-    if(match == inLen){
-        #ifdef DEBUG_MODE
-        fprintf(fzz_logFile, "%s \n -> passed (%s(%d) - %s(%d): %f)\n", 
-            fzzSystem.rule[ruleIndex], 
-            fzzSystem.outSet[output].name,
-            output,
-            fzzSystem.outSet[output].fSet[outSet].name,
-            outSet,
-            min
-        );
-        #endif
-        infOut[output].res[infOut[output].length].value = min;
-        infOut[output].res[infOut[output].length].fSet = outSet;
-        infOut[output].length++;
+    //output is either Mamdani (fuzzy sets) or Sugeno (functions)
+    if(error == NULL && rule->coefs == NULL && sys->outSet[rule->output].functions.length > 0)
+        error = "Output has linear functions in consequents, fuzzy set can not be used";
+    if(error == NULL && rule->coefs != NULL){
+        for(i = 0; i < sys->outSet[rule->output].length; i++)
+            if(sys->outSet[rule->output].rules[i].length > 0) 
+                error = "Output has fuzzy sets in consequents, linear function can not be used";
     }
+    if(error == NULL) fzz_ruleKind(sys, rule);
+    free(text);
+    return error;
 }
 
 /**
- * @brief Used for defuzzyfication
- * Internal function
+ * @brief Adds rule to fuzzy system
+ * Internal function, rule is not added when it is invalid
+ * @param sys fuzzy system
+ * @param rule text of rule
+ * @return NULL on success, description of error otherwise
  */
-double fzz_outputValue(int output, double x){
-    double max = 0;
+const char* fzz_addRuleText(TFzzSystem* sys, const char* rule){
+    char** texts = NULL;
+    TRule* rules = NULL;
+    const TRule* compiled = NULL;
+    const char* error = NULL;
     int i = 0;
-    int j = 0;
-    double k = 0;
-    double xNorm = 0;
-    double memb = 0;
-    
-    //membership of center
-     for(i = 0; i < infOut[output].length; i++){
-        j = infOut[output].res[i].fSet;
-        //x value intersects fuzzy set
-        if(x <= fzzSystem.outSet[output].fSet[j].left) continue;
-        if(x >= fzzSystem.outSet[output].fSet[j].right) continue;
-        //input intersects left part of fuzzy set
-        if(x <= fzzSystem.outSet[output].fSet[j].top){
-            k = 1.0 / (fzzSystem.outSet[output].fSet[j].top - fzzSystem.outSet[output].fSet[j].left); 
-            xNorm = x - fzzSystem.outSet[output].fSet[j].left;
-            memb = k*xNorm;
-            if(memb > infOut[output].res[i].value)
-                memb = infOut[output].res[i].value;
-            if(memb > max)
-                max = memb;
-        }
-        //input intersects right part of fuzzy set
-        else{
-            k = 1.0 / (fzzSystem.outSet[output].fSet[j].top - fzzSystem.outSet[output].fSet[j].right); 
-            xNorm = x - fzzSystem.outSet[output].fSet[j].top;
-            memb = k*xNorm + 1;
-            if(memb > infOut[output].res[i].value)
-                memb = infOut[output].res[i].value;
-            if(memb > max)
-                max = memb;
-        }
-    }
-    
-    //returns result
-    return max;
+    
+    //capacity of list of rules is doubled when it is full
+    if(sys->ruLen == sys->ruCapacity){
+        sys->ruCapacity = sys->ruCapacity > 0 ? 2*sys->ruCapacity : 16;
+        texts = (char**)fzz_arenaAlloc(&sys->arena, sizeof(char*)*sys->ruCapacity);
+        rules = (TRule*)fzz_arenaAlloc(&sys->arena, sizeof(TRule)*sys->ruCapacity);
+        if(sys->ruLen > 0){
+            memcpy(texts, sys->rule, sizeof(char*)*sys->ruLen);
+            memcpy(rules, sys->ruleData, sizeof(TRule)*sys->ruLen);
+        }
+        sys->rule = texts;
+        sys->ruleData = rules;
+    }
+    
+    //rule text and compiled rule
+    sys->rule[sys->ruLen] = fzz_arenaString(&sys->arena, rule);
+    error = fzz_compileRule(sys, sys->ruLen);
+    if(error != NULL) return error;
+    
+    //inverted index, rule is listed by every condition of its antecedent
+    //(negated condition by its input) and by its consequent
+    compiled = &sys->ruleData[sys->ruLen];
+    for(i = 0; i < compiled->inLen; i++){
+        if(compiled->negated[i])
+            fzz_ruleListPush(sys, &sys->inSet[compiled->inputs[i]].negated, sys->ruLen);
+        else
+            fzz_ruleListPush(sys, &sys->inSet[compiled->inputs[i]].rules[compiled->inSets[i]], sys->ruLen);
+    }
+    if(compiled->coefs != NULL)
+        fzz_ruleListPush(sys, &sys->outSet[compiled->output].functions, sys->ruLen);
+    else
+        fzz_ruleListPush(sys, &sys->outSet[compiled->output].rules[compiled->outSet], sys->ruLen);
+    sys->ruLen++;
+    fzz_modified(sys);
+    return NULL;
 }
 
 /**
- * @brief Calculates crisp output values of system
- * Internal function, center of area / gravity method
- * @param output index of output
+ * @brief Removes all rules from inverted index of inputs and outputs
+ * Internal function, compiled rules are dropped (texts stay in arena)
+ * @param sys fuzzy system
  */
-void fzz_defuzzify(int output){
+void fzz_clearRules(TFzzSystem* sys){
     int i = 0;
     int j = 0;
-    double from = DBL_MAX;
-    double to = -DBL_MAX;
-    double x = 0;
-    double numerator = 0;
-    double denominator = 0;   
-    double max = 0;
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_defuzzify(%d)\n", output);
-    #endif
-    
-    //search for range
-    for(i = 0; i < infOut[output].length; i++){
-        j = infOut[output].res[i].fSet;
-        if(fzzSystem.outSet[output].fSet[j].left < from)
-            from = fzzSystem.outSet[output].fSet[j].left;
-        if(fzzSystem.outSet[output].fSet[j].right > to)
-            to = fzzSystem.outSet[output].fSet[j].right;
+    sys->ruLen = 0;
+    for(i = 0; i < sys->inLen; i++){
+        for(j = 0; j < sys->inSet[i].length; j++) sys->inSet[i].rules[j].length = 0;
+        sys->inSet[i].negated.length = 0;
+    }
+    for(i = 0; i < sys->outLen; i++){
+        for(j = 0; j < sys->outSet[i].length; j++) sys->outSet[i].rules[j].length = 0;
+        sys->outSet[i].functions.length = 0;
     }
+}
 
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "%s: range(%f to %f)\n", fzzSystem.outSet[output].name, from, to);
-    #endif
+/**
+ * @brief Compiles all rules again
+ * Internal function, pending rules are followed by compiled ones; when 
+ * any rule can not be compiled (name of its fuzzy set is not set yet), 
+ * system has no rules and all of them are pending
+ * @param sys fuzzy system
+ * @return NULL on success, description of error otherwise
+ */
+const char* fzz_recompileRules(TFzzSystem* sys){
+    const char* error = NULL;
+    char** texts = NULL;
+    int length = sys->pendingLen + sys->ruLen;
+    int i = 0;
     
-    //integration 
-    for(x = from; x < to+COG_STEP; x+=COG_STEP){
-        max = fzz_outputValue(output, x);
-        numerator += x*max;
-        denominator += max;
+    texts = (char**)fzz_arenaAlloc(&sys->arena, sizeof(char*)*length);
+    if(sys->pendingLen > 0) memcpy(texts, sys->pending, sizeof(char*)*sys->pendingLen);
+    if(sys->ruLen > 0) memcpy(texts + sys->pendingLen, sys->rule, sizeof(char*)*sys->ruLen);
+    sys->pendingLen = 0;
+    fzz_clearRules(sys);
+    for(i = 0; i < length && error == NULL; i++) error = fzz_addRuleText(sys, texts[i]);
+    if(error != NULL){
+        fzz_clearRules(sys);
+        sys->pending = texts;
+        sys->pendingLen = length;
     }
+    fzz_modified(sys);
+    return error;
+}
 
-    //x coord of center of gravity
-    fzzSystem.output[output] = numerator / denominator;
+void fzz_addRuleEx(TFzzSystem* sys, const char* rule){
+    const char* error = NULL;
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_addRule(...)");
+    
+    //description of error is printed before assertion fails
+    error = fzz_addRuleText(sys, rule);
+    if(error != NULL) fprintf(stderr, "%s in fzz_addRule(%s)\n", error, rule);
+    assert(error == NULL && "Invalid rule in fzz_addRule(...)");
 }
 
-void fzz_calculateOutput(){
+TFzzContext* fzz_createContext(const TFzzSystem* sys){
+    TArena arena = {NULL};
+    TFzzContext* ctx = NULL;
+    TFzzReal from = 0;
+    TFzzReal to = 0;
+    int maxOutSets = 0;
+    int fixedSets = 0;
     int i = 0;
     int j = 0;
-
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "CALL: fzz_calculateOutput()\n");
-    #endif
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "\nOutput calculation\n------------------\nFuzzyfication:\n");
-    #endif
+    assert(sys->pendingLen == 0 && "Rules wait for names of fuzzy sets of initialized input or output in fzz_createContext(...)");
     
-    //fuzzifycation process
-    for(i = 0; i < fzzSystem.inLen; i++){
-        fzfOut[i].length = 0;
-        fzz_fuzzify(i);
+    //context is the first item of its arena
+    ctx = (TFzzContext*)fzz_arenaAlloc(&arena, sizeof(TFzzContext));
+    ctx->sys = sys;
+    ctx->revision = sys->revision;
+    
+    //fuzzification results
+    ctx->fzfOut = (TFuzzifyOut*)fzz_arenaAlloc(&arena, sizeof(TFuzzifyOut)*sys->inLen);
+    for(i = 0; i < sys->inLen; i++){
+        ctx->fzfOut[i].res = (TFuzzifyRes*)fzz_arenaAlloc(&arena, sizeof(TFuzzifyRes)*sys->inSet[i].length);
+        ctx->fzfOut[i].memb = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*FSETS_PAD(sys->inSet[i].length));
+        for(j = 0; j < FSETS_PAD(sys->inSet[i].length); j++) ctx->fzfOut[i].memb[j] = -1;
     }
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "\nInference:\n");
-    #endif
+    //inference results, aggregated per output fuzzy set
+    ctx->infOut = (TInfOut*)fzz_arenaAlloc(&arena, sizeof(TInfOut)*sys->outLen);
+    for(i = 0; i < sys->outLen; i++){
+        ctx->infOut[i].strength = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outSet[i].length);
+        ctx->infOut[i].fired = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->outSet[i].length);
+        ctx->infOut[i].stale = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->outSet[i].length);
+        ctx->infOut[i].rules = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->outSet[i].functions.length);
+        for(j = 0; j < sys->outSet[i].length; j++) ctx->infOut[i].strength[j] = -1;
+        ctx->infOut[i].level = ctx->infOut[i].strength;
+        if(sys->aggregation != FZZ_MAX)
+            ctx->infOut[i].level = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outSet[i].length);
+        if(sys->outSet[i].length > maxOutSets) maxOutSets = sys->outSet[i].length;
+    }
     
-    //inferential mechanism
-    for(i = 0; i < fzzSystem.outLen; i++)
-        infOut[i].length = 0;
-    for(i = 0; i < fzzSystem.ruLen; i++)
-        fzz_ininference(i);
+    //rule index lookup
+    ctx->hits = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->ruLen);
+    ctx->touched = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->ruLen);
     
-    #ifdef DEBUG_MODE
-    fprintf(fzz_logFile, "\nDefuzzyfication:\n");
-    #endif
+    //incremental calculation, results are not valid until first calculation
+    ctx->input = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->inLen);
+    ctx->output = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outLen);
+    ctx->ruleStrength = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->ruLen);
+    ctx->cached = 0;
     
-    //defuzzifycation process
-    for(i = 0; i < fzzSystem.outLen; i++)
-        fzz_defuzzify(i);
+    //fixed point calculation
+    for(i = 0; i < sys->inLen; i++) fixedSets += sys->inSet[i].length;
+    ctx->fixedMemb = (short*)fzz_arenaAlloc(&arena, sizeof(short)*fixedSets);
+    fixedSets = 0;
+    for(i = 0; i < sys->outLen; i++) fixedSets += sys->outSet[i].length;
+    ctx->fixedStrength = (short*)fzz_arenaAlloc(&arena, sizeof(short)*fixedSets);
+    
+    //exact defuzzification
+    ctx->lines = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*maxOutSets*3*2);
+    ctx->lineLen = (int*)fzz_arenaAlloc(&arena, sizeof(int)*maxOutSets);
+    ctx->breaks = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*MAX_BREAKS(maxOutSets));
+    
+    //real-time sampling, samples cover all fuzzy sets of output
+    ctx->sampleFrom = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outLen);
+    ctx->sampleStep = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outLen);
+    for(i = 0; i < sys->outLen && sys->samples > 0; i++){
+        from = REAL_MAX;
+        to = -REAL_MAX;
+        for(j = 0; j < sys->outSet[i].length; j++){
+            if(sys->outSet[i].fSet[j].left < from) from = sys->outSet[i].fSet[j].left;
+            if(sys->outSet[i].fSet[j].right > to) to = sys->outSet[i].fSet[j].right;
+        }
+        if(from > to) continue;
+        ctx->sampleFrom[i] = from;
+        ctx->sampleStep[i] = (to - from) / (sys->samples - 1);
+    }
+    
+    //lookup table interpolation
+    ctx->cell = (int*)fzz_arenaAlloc(&arena, sizeof(int)*sys->inLen);
+    ctx->frac = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->inLen);
+    ctx->weight = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outLen);
+    ctx->interp = (TFzzReal*)fzz_arenaAlloc(&arena, sizeof(TFzzReal)*sys->outLen);
+    
+    ctx->arena = arena;
+    return ctx;
 }
 
-///////////////////////////////////////////////////
-//////// Support functions ////////////////////////
-///////////////////////////////////////////////////
-
-void fzz_printInputSet(int index){
-    int i = 0;
+void fzz_destroyContext(TFzzContext* ctx){
+    TArena arena = ctx->arena;
     
-    //index check
-    assert(index < fzzSystem.inLen && "Index out of range in fzz_printInputSet(...)");
+    //context itself is released with its arena
+    free(ctx->trace.values);
+    free(ctx->trace.fired);
+    free(ctx->trace.ns);
+    fzz_arenaFree(&arena);
+}
+
+void fzz_setStatsEx(TFzzContext* ctx, int flags, int traceLength){
+    TTrace* trace = &ctx->trace;
+    int stride = ctx->sys->inLen + ctx->sys->outLen;
     
-    //header
-    printf("Input set for input %d named \"%s\":\n", index, fzzSystem.inSet[index].name);
+    assert(traceLength >= 0 && "Invalid length of trace in fzz_setStats(...)");
+    ctx->statsFlags = flags;
     
-    //fuzzy sets
-    for(i = 0; i < fzzSystem.inSet[index].length; i++){
-        printf(
-            "Fuzzy set %d named \"%s\": [%f,0],[%f,1],[%f,0]\n", 
-            i,
-            fzzSystem.inSet[index].fSet[i].name,
-            fzzSystem.inSet[index].fSet[i].left,
-            fzzSystem.inSet[index].fSet[i].top,
-            fzzSystem.inSet[index].fSet[i].right
-        );
-    }
+    //trace is allocated again when its length changes
+    if(traceLength == trace->length) return;
+    free(trace->values);
+    free(trace->fired);
+    free(trace->ns);
+    memset(trace, 0, sizeof(TTrace));
+    if(traceLength == 0) return;
+    trace->values = (TFzzReal*)malloc(sizeof(TFzzReal)*traceLength*stride);
+    trace->fired = (int*)malloc(sizeof(int)*traceLength);
+    trace->ns = (long long*)malloc(sizeof(long long)*traceLength);
+    assert(trace->values != NULL && trace->fired != NULL && trace->ns != NULL && "Memory allocation failed in fzz_setStats(...)");
+    trace->length = traceLength;
 }
 
-void fzz_printOutputSet(int index){
+void fzz_getStatsEx(const TFzzContext* ctx, TFzzStats* stats){
+    *stats = ctx->stats;
+}
+
+void fzz_resetStatsEx(TFzzContext* ctx){
+    memset(&ctx->stats, 0, sizeof(TFzzStats));
+    ctx->trace.next = 0;
+    ctx->trace.count = 0;
+}
+
+/**
+ * @brief Monotonic time used by statistics
+ * Internal function, processor time is used where monotonic clock 
+ * is not available
+ * @return time in nanoseconds
+ */
+long long fzz_now(){
+    #ifdef CLOCK_MONOTONIC
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec*1000000000LL + t.tv_nsec;
+    #else
+    return (long long)((double)clock() * 1e9 / CLOCKS_PER_SEC);
+    #endif
+}
+
+/**
+ * @brief Records finished calculation to statistics and trace of context
+ * Internal function, called only when statistics are enabled
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param input array of input values
+ * @param output array of calculated outputs, NULL if they are not known
+ * @param start time when calculation started (used with FZZ_STATS_TIME or FZZ_STATS_TRACE)
+ */
+void fzz_statsRecord(const TFzzSystem* sys, TFzzContext* ctx, const double* input, const double* output, long long start){
+    TTrace* trace = &ctx->trace;
+    TFzzReal* record = NULL;
+    long long ns = 0;
+    int bin = 0;
     int i = 0;
     
-    //index check
-    assert(index < fzzSystem.outLen && "Index out of range in fzz_printOutputSet(...)");
+    if(ctx->statsFlags & (FZZ_STATS_TIME | FZZ_STATS_TRACE)) ns = fzz_now() - start;
     
-    //header
-    printf("Output set for output %d named \"%s\":\n", index, fzzSystem.outSet[index].name);
+    //counters and histogram of fired rules
+    if(ctx->statsFlags & FZZ_STATS_COUNT){
+        ctx->stats.evaluations++;
+        ctx->stats.rulesFired += ctx->fired;
+        for(i = ctx->fired; i > 0 && bin < FZZ_STATS_BINS - 1; i >>= 1) bin++;
+        ctx->stats.firedHistogram[bin]++;
+    }
+    if(ctx->statsFlags & FZZ_STATS_TIME) ctx->stats.totalNs += ns;
     
-    //fuzzy sets
-    for(i = 0; i < fzzSystem.outSet[index].length; i++){
-        printf(
-            "Fuzzy set %d named \"%s\": [%f,0],[%f,1],[%f,0]\n", 
-            i,
-            fzzSystem.outSet[index].fSet[i].name,
-            fzzSystem.outSet[index].fSet[i].left,
-            fzzSystem.outSet[index].fSet[i].top,
-            fzzSystem.outSet[index].fSet[i].right
-        );
-    }  
+    //the oldest record of trace is overwritten
+    if((ctx->statsFlags & FZZ_STATS_TRACE) && trace->length > 0){
+        record = trace->values + trace->next*(sys->inLen + sys->outLen);
+        for(i = 0; i < sys->inLen; i++) record[i] = input[i];
+        for(i = 0; i < sys->outLen; i++)
+            record[sys->inLen + i] = output != NULL ? (TFzzReal)output[i] : NAN;
+        trace->fired[trace->next] = ctx->fired;
+        trace->ns[trace->next] = ns;
+        trace->next = (trace->next + 1) % trace->length;
+        trace->count++;
+    }
 }
 
-void fzz_printRules(){
-    int i = 0;
+/**
+ * @brief Calculates membership of value in piecewise linear input fuzzy set
+ * Internal function, value has to be inside of fuzzy set
+ * @param set set of input fuzzy sets
+ * @param i index of fuzzy set
+ * @param value value of input
+ * @return membership
+ */
+TFzzReal fzz_membershipLinear(const TFcnsSet* set, int i, TFzzReal value){
+    TFzzReal k = 0;
     
-    //header
-    printf("System contains %d rules of inferential mechanism:\n", fzzSystem.ruLen);
+    //input intersects left part of fuzzy set
+    if(value <= set->top[i]){
+        k = (TFzzReal)1.0 / (set->top[i] - set->left[i]);
+        return k*(value - set->left[i]);
+    }
+    //input intersects top of fuzzy set
+    if(value <= set->topEnd[i]) return 1;
+    //input intersects right part of fuzzy set
+    k = (TFzzReal)1.0 / (set->topEnd[i] - set->right[i]);
+    return k*(value - set->topEnd[i]) + 1;
+}
+
+/**
+ * @brief Calculates membership of value in input fuzzy set of any shape
+ * Internal function
+ * @param set set of input fuzzy sets
+ * @param i index of fuzzy set
+ * @param value value of input
+ * @return membership, -1 if fuzzy set is not hit (also by value which 
+ * is not a number, as in vector fuzzification)
+ */
+TFzzReal fzz_membership(const TFcnsSet* set, int i, TFzzReal value){
+    TFzzReal d = value - set->top[i];
     
-    //rules
-    for(i = 0; i < fzzSystem.ruLen; i++){
-        printf("%3d: %s\n", i, fzzSystem.rule[i]);
+    switch(set->fSet[i].shape){
+        case FZZ_SINGLETON:
+            return value == set->top[i] ? 1 : -1;
+        case FZZ_GAUSSIAN:
+            if(!(value > set->left[i] && value < set->right[i])) return -1;
+            return (TFzzReal)exp(-d*d*set->kLeft[i]);
+        default:
+            if(!(value > set->left[i] && value < set->right[i])) return -1;
+            return fzz_membershipLinear(set, i, value);
     }
 }
 
-void fzz_printSystem(){
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, scalar version for piecewise linear fuzzy sets
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+void fzz_fuzzifyScalar(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
     int i = 0;
     
-    printf("\n");
-    printf("+----------------------------------------+\n");
-    printf("|              Fuzzy system              |\n");
-    printf("+----------------------------------------+\n\n");
-
-    //input sets
-    for(i = 0; i < fzzSystem.inLen; i++){
-        fzz_printInputSet(i);
-        printf("\n");
+    //through all fuzzy sets of given output
+    fzOut->length = 0;
+    for(i = 0; i < set->length; i++){
+        //input value intersects fuzzy set (value which is not a number does not)
+        fzOut->memb[i] = -1;
+        if(!(value > set->left[i])) continue;
+        if(!(value < set->right[i])) continue;
+        
+        //fuzzy set name and index
+        fzOut->res[fzOut->length].membership = fzz_membershipLinear(set, i, value);
+        fzOut->res[fzOut->length].setIndex = i;
+        fzOut->memb[i] = fzOut->res[fzOut->length].membership;
+        fzOut->length++; 
     }
+}
+
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, version for curved input (with Gaussian or 
+ * singleton fuzzy sets), shape is dispatched once per fuzzy set
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+void fzz_fuzzifyCurved(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    int i = 0;
     
-    //output sets
-    for(i = 0; i < fzzSystem.outLen; i++){
-        fzz_printOutputSet(i);
-        printf("\n");
+    fzOut->length = 0;
+    for(i = 0; i < set->length; i++){
+        fzOut->memb[i] = fzz_membership(set, i, value);
+        if(fzOut->memb[i] < 0) continue;
+        fzOut->res[fzOut->length].membership = fzOut->memb[i];
+        fzOut->res[fzOut->length].setIndex = i;
+        fzOut->length++;
     }
-    
+}
+
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, version for sorted partition; hit fuzzy sets are 
+ * neighbours, the first one is found by binary search in right points 
+ * (or directly in grid of uniform partition), only memberships of 
+ * previously hit fuzzy sets are cleared
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+void fzz_fuzzifySorted(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    TFzzReal t = 0;
+    int from = 0;
+    int to = set->length;
+    int mid = 0;
+    int i = 0;
+    
+    //results of previous fuzzification
+    for(i = 0; i < fzOut->length; i++) fzOut->memb[fzOut->res[i].setIndex] = -1;
+    fzOut->length = 0;
+    
+    //the first fuzzy set whose right point is above value (or the one
+    //before previous grid point, which is not hit)
+    if(set->partition == PARTITION_UNIFORM){
+        t = (value - set->gridFrom) / set->gridStep;
+        if(t >= set->length) from = set->length - 1;
+        else if(t >= 1) from = (int)t - 1;
+    }else{
+        while(from < to){
+            mid = (from + to) / 2;
+            if(set->right[mid] > value) to = mid;
+            else from = mid + 1;
+        }
+    }
+    
+    //hit fuzzy sets end by the first one whose left point is not below value
+    for(i = from; i < set->length && set->left[i] < value; i++){
+        if(value >= set->right[i]) continue;
+        fzOut->res[fzOut->length].membership = fzz_membershipLinear(set, i, value);
+        fzOut->res[fzOut->length].setIndex = i;
+        fzOut->memb[i] = fzOut->res[fzOut->length].membership;
+        fzOut->length++;
+    }
+}
+
+#if defined(FZZ_SIMD_AVX2) || defined(FZZ_SIMD_NEON)
+/**
+ * @brief Adds hit fuzzy sets of vector to fuzzified value
+ * Internal function, used by vector versions of fuzzification
+ * @param fzOut fuzzified value, memberships of vector are stored
+ * @param i index of the first fuzzy set of vector
+ * @param hit bit mask of hit fuzzy sets of vector
+ */
+void fzz_fuzzifyHits(TFuzzifyOut* fzOut, int i, unsigned int hit){
+    int j = 0;
+    
+    for(j = 0; hit != 0; j++, hit >>= 1){
+        if(!(hit & 1)) continue;
+        fzOut->res[fzOut->length].membership = fzOut->memb[i + j];
+        fzOut->res[fzOut->length].setIndex = i + j;
+        fzOut->length++;
+    }
+}
+
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, vector version without branches, computes
+ * memberships of 4 fuzzy sets at once (AVX2 or NEON)
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+FZZ_TARGET_AVX2 void fzz_fuzzifySimd(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    unsigned int hit = 0;
+    int i = 0;
+    
+    #ifdef FZZ_SIMD_AVX2
+    __m256d x = _mm256_set1_pd(value);
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d none = _mm256_set1_pd(-1.0);
+    __m256d left, top, topEnd, right, up, down, memb, isHit;
+    #else
+    float64x2_t x = vdupq_n_f64(value);
+    float64x2_t one = vdupq_n_f64(1.0);
+    float64x2_t none = vdupq_n_f64(-1.0);
+    float64x2_t left, top, topEnd, right, up, down, memb;
+    uint64x2_t isHit;
+    int j = 0;
+    #endif
+    
+    fzOut->length = 0;
+    for(i = 0; i < set->length; i += 4){
+        #ifdef FZZ_SIMD_AVX2
+        left = _mm256_loadu_pd(set->left + i);
+        top = _mm256_loadu_pd(set->top + i);
+        topEnd = _mm256_loadu_pd(set->topEnd + i);
+        right = _mm256_loadu_pd(set->right + i);
+        //membership on left part, top and right part of fuzzy set
+        up = _mm256_mul_pd(_mm256_loadu_pd(set->kLeft + i), _mm256_sub_pd(x, left));
+        down = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(set->kRight + i), _mm256_sub_pd(x, topEnd)), one);
+        memb = _mm256_blendv_pd(down, one, _mm256_cmp_pd(x, topEnd, _CMP_LE_OQ));
+        memb = _mm256_blendv_pd(memb, up, _mm256_cmp_pd(x, top, _CMP_LE_OQ));
+        //input value intersects fuzzy set
+        isHit = _mm256_and_pd(_mm256_cmp_pd(x, left, _CMP_GT_OQ), _mm256_cmp_pd(x, right, _CMP_LT_OQ));
+        _mm256_storeu_pd(fzOut->memb + i, _mm256_blendv_pd(none, memb, isHit));
+        hit = (unsigned int)_mm256_movemask_pd(isHit);
+        #else
+        hit = 0;
+        for(j = 0; j < 4; j += 2){
+            left = vld1q_f64(set->left + i + j);
+            top = vld1q_f64(set->top + i + j);
+            topEnd = vld1q_f64(set->topEnd + i + j);
+            right = vld1q_f64(set->right + i + j);
+            //membership on left part, top and right part of fuzzy set
+            up = vmulq_f64(vld1q_f64(set->kLeft + i + j), vsubq_f64(x, left));
+            down = vaddq_f64(vmulq_f64(vld1q_f64(set->kRight + i + j), vsubq_f64(x, topEnd)), one);
+            memb = vbslq_f64(vcleq_f64(x, topEnd), one, down);
+            memb = vbslq_f64(vcleq_f64(x, top), up, memb);
+            //input value intersects fuzzy set
+            isHit = vandq_u64(vcgtq_f64(x, left), vcltq_f64(x, right));
+            vst1q_f64(fzOut->memb + i + j, vbslq_f64(isHit, memb, none));
+            hit |= (unsigned int)((vgetq_lane_u64(isHit, 0) & 1) | ((vgetq_lane_u64(isHit, 1) & 1) << 1)) << j;
+        }
+        #endif
+        
+        //list of hit fuzzy sets
+        fzz_fuzzifyHits(fzOut, i, hit);
+    }
+}
+#endif
+
+#ifdef FZZ_SIMD_DISPATCH
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, vector version for processors without AVX2, 
+ * computes memberships of 2 fuzzy sets at once (SSE2 has no blend,
+ * lanes are selected by bit masks)
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+void fzz_fuzzifySse2(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    __m128d x = _mm_set1_pd(value);
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d none = _mm_set1_pd(-1.0);
+    __m128d left, top, topEnd, right, up, down, memb, isTop, isHit;
+    int i = 0;
+    
+    fzOut->length = 0;
+    for(i = 0; i < set->length; i += 2){
+        left = _mm_loadu_pd(set->left + i);
+        top = _mm_loadu_pd(set->top + i);
+        topEnd = _mm_loadu_pd(set->topEnd + i);
+        right = _mm_loadu_pd(set->right + i);
+        //membership on left part, top and right part of fuzzy set
+        up = _mm_mul_pd(_mm_loadu_pd(set->kLeft + i), _mm_sub_pd(x, left));
+        down = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(set->kRight + i), _mm_sub_pd(x, topEnd)), one);
+        isTop = _mm_cmple_pd(x, topEnd);
+        memb = _mm_or_pd(_mm_and_pd(isTop, one), _mm_andnot_pd(isTop, down));
+        isTop = _mm_cmple_pd(x, top);
+        memb = _mm_or_pd(_mm_and_pd(isTop, up), _mm_andnot_pd(isTop, memb));
+        //input value intersects fuzzy set
+        isHit = _mm_and_pd(_mm_cmpgt_pd(x, left), _mm_cmplt_pd(x, right));
+        _mm_storeu_pd(fzOut->memb + i, _mm_or_pd(_mm_and_pd(isHit, memb), _mm_andnot_pd(isHit, none)));
+        
+        //list of hit fuzzy sets
+        fzz_fuzzifyHits(fzOut, i, (unsigned int)_mm_movemask_pd(isHit));
+    }
+}
+
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, vector version for AVX-512, computes memberships 
+ * of 8 fuzzy sets at once, lanes after the last fuzzy set are masked
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+FZZ_TARGET_AVX512 void fzz_fuzzifyAvx512(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    const TFcnsSet* set = &sys->inSet[in];
+    TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    __m512d x = _mm512_set1_pd(value);
+    __m512d one = _mm512_set1_pd(1.0);
+    __m512d none = _mm512_set1_pd(-1.0);
+    __m512d left, top, topEnd, right, up, down, memb;
+    __mmask8 lanes = 0;
+    __mmask8 isHit = 0;
+    int i = 0;
+    
+    fzOut->length = 0;
+    for(i = 0; i < set->length; i += 8){
+        lanes = set->length - i >= 8 ? 0xFF : (__mmask8)((1u << (set->length - i)) - 1);
+        left = _mm512_maskz_loadu_pd(lanes, set->left + i);
+        top = _mm512_maskz_loadu_pd(lanes, set->top + i);
+        topEnd = _mm512_maskz_loadu_pd(lanes, set->topEnd + i);
+        right = _mm512_maskz_loadu_pd(lanes, set->right + i);
+        //membership on left part, top and right part of fuzzy set
+        //(rounded separately, AVX-512 has fused multiply-add which would be contracted)
+        up = _mm512_mul_round_pd(_mm512_maskz_loadu_pd(lanes, set->kLeft + i), _mm512_sub_pd(x, left), _MM_FROUND_CUR_DIRECTION);
+        down = _mm512_mul_round_pd(_mm512_maskz_loadu_pd(lanes, set->kRight + i), _mm512_sub_pd(x, topEnd), _MM_FROUND_CUR_DIRECTION);
+        down = _mm512_add_round_pd(down, one, _MM_FROUND_CUR_DIRECTION);
+        memb = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, topEnd, _CMP_LE_OQ), down, one);
+        memb = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, top, _CMP_LE_OQ), memb, up);
+        //input value intersects fuzzy set
+        isHit = _mm512_cmp_pd_mask(x, left, _CMP_GT_OQ) & _mm512_cmp_pd_mask(x, right, _CMP_LT_OQ) & lanes;
+        _mm512_mask_storeu_pd(fzOut->memb + i, lanes, _mm512_mask_blend_pd(isHit, none, memb));
+        
+        //list of hit fuzzy sets
+        fzz_fuzzifyHits(fzOut, i, isHit);
+    }
+}
+
+/**
+ * @brief Chooses vector instructions of fuzzification
+ * Internal function, called when library is loaded (before main or
+ * when shared library is opened)
+ */
+__attribute__((constructor)) void fzz_simdInit(){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) fzzSimdBest = SIMD_AVX512;
+    else if(__builtin_cpu_supports("avx2")) fzzSimdBest = SIMD_AVX2;
+    else fzzSimdBest = SIMD_SSE2;
+    fzzSimd = fzzSimdBest;
+}
+#endif
+
+/**
+ * @brief Calculates fuzzified value of input with given index
+ * Internal function, uses version for curved input, for sorted 
+ * partition or vector version when available
+ * @param sys fuzzy system
+ * @param ctx calculation context, result is stored there
+ * @param in index of input and index of input set
+ * @param value value of input
+ */
+void fzz_fuzzify(const TFzzSystem* sys, TFzzContext* ctx, int in, TFzzReal value){
+    //value is kept for linear functions in consequents
+    ctx->input[in] = value;
+    if(sys->inSet[in].curved){
+        fzz_fuzzifyCurved(sys, ctx, in, value);
+        return;
+    }
+    if(sys->inSet[in].partition != PARTITION_NONE){
+        fzz_fuzzifySorted(sys, ctx, in, value);
+        return;
+    }
+    #ifdef FZZ_SIMD_DISPATCH
+    if(fzzSimd == SIMD_AVX512){
+        fzz_fuzzifyAvx512(sys, ctx, in, value);
+        return;
+    }
+    if(fzzSimd == SIMD_SSE2){
+        fzz_fuzzifySse2(sys, ctx, in, value);
+        return;
+    }
+    #endif
+    #if defined(FZZ_SIMD_AVX2) || defined(FZZ_SIMD_NEON)
+    if(fzzSimd != SIMD_NONE){
+        fzz_fuzzifySimd(sys, ctx, in, value);
+        return;
+    }
+    #endif
+    fzz_fuzzifyScalar(sys, ctx, in, value);
+}
+
+/**
+ * @brief Defines evaluation of antecedent of rule joined by and
+ * Internal, instantiated for every t-norm so that operator is not 
+ * dispatched for every condition; membership of negated condition 
+ * is complement (1 when its fuzzy set was not hit), strength is scaled
+ * by weight of rule
+ * @param name name of defined function
+ * @param TNORM t-norm macro
+ */
+#define FZZ_AND_STRENGTH(name, TNORM) \
+TFzzReal name(const TFzzContext* ctx, const TRule* rule){ \
+    TFzzReal memb = 0; \
+    TFzzReal value = 1; \
+    int i = 0; \
+    \
+    for(i = 0; i < rule->inLen; i++){ \
+        memb = ctx->fzfOut[rule->inputs[i]].memb[rule->inSets[i]]; \
+        if(memb < 0) memb = 0; \
+        if(rule->negated[i]) memb = 1 - memb; \
+        if(memb <= 0) return -1; \
+        value = TNORM(value, memb); \
+    } \
+    return value > 0 ? value*rule->weight : -1; \
+}
+
+/**
+ * @brief Defines evaluation of antecedent of rule joined by or
+ * Internal, instantiated for every s-norm, rule fires when any 
+ * condition has nonzero membership
+ * @see FZZ_AND_STRENGTH
+ * @param name name of defined function
+ * @param SNORM s-norm macro
+ */
+#define FZZ_OR_STRENGTH(name, SNORM) \
+TFzzReal name(const TFzzContext* ctx, const TRule* rule){ \
+    TFzzReal memb = 0; \
+    TFzzReal value = 0; \
+    int i = 0; \
+    \
+    for(i = 0; i < rule->inLen; i++){ \
+        memb = ctx->fzfOut[rule->inputs[i]].memb[rule->inSets[i]]; \
+        if(memb < 0) memb = 0; \
+        if(rule->negated[i]) memb = 1 - memb; \
+        value = SNORM(value, memb); \
+    } \
+    return value > 0 ? value*rule->weight : -1; \
+}
+
+FZZ_AND_STRENGTH(fzz_ruleAndMin, TNORM_MIN)
+FZZ_AND_STRENGTH(fzz_ruleAndProduct, TNORM_PRODUCT)
+FZZ_OR_STRENGTH(fzz_ruleOrMax, SNORM_MAX)
+FZZ_OR_STRENGTH(fzz_ruleOrProbor, SNORM_PROBOR)
+FZZ_OR_STRENGTH(fzz_ruleOrBoundedSum, SNORM_BOUNDED_SUM)
+
+/**
+ * @brief Evaluates antecedent of compiled rule
+ * Internal function, evaluation is selected by kind of rule, 
+ * default rule (and by min without negation and weight) is evaluated here
+ * @param sys fuzzy system
+ * @param ctx calculation context with fuzzified inputs
+ * @param ruleIndex index of rule
+ * @return strength of rule, -1 if rule did not fire
+ */
+TFzzReal fzz_ruleStrength(const TFzzSystem* sys, const TFzzContext* ctx, int ruleIndex){
+    const TRule* rule = &sys->ruleData[ruleIndex];
+    TFzzReal memb = 0;
+    TFzzReal min = 0;
+    int i = 0;
+    
+    switch(rule->kind){
+        case RULE_AND_MIN:
+            return fzz_ruleAndMin(ctx, rule);
+        case RULE_AND_PRODUCT:
+            return fzz_ruleAndProduct(ctx, rule);
+        case RULE_OR_MAX:
+            return fzz_ruleOrMax(ctx, rule);
+        case RULE_OR_PROBOR:
+            return fzz_ruleOrProbor(ctx, rule);
+        case RULE_OR_BOUNDED_SUM:
+            return fzz_ruleOrBoundedSum(ctx, rule);
+    }
+    
+    for(i = 0; i < rule->inLen; i++){
+        memb = ctx->fzfOut[rule->inputs[i]].memb[rule->inSets[i]];
+        //fuzzy set of antecedent was not hit
+        if(memb < 0) return -1;
+        if(i == 0 || memb < min) min = memb;
+    }
+    return min;
+}
+
+/**
+ * @brief Evaluates compiled rule and stores its result
+ * Internal function
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param ruleIndex index of rule
+ * @return 1 if rule fired, 0 otherwise
+ */
+int fzz_ininference(const TFzzSystem* sys, TFzzContext* ctx, int ruleIndex){
+    const TRule* rule = &sys->ruleData[ruleIndex];
+    TInfOut* out = &ctx->infOut[rule->output];
+    TFzzReal min = 0;
+    
+    //evaluation of compiled rule
+    min = fzz_ruleStrength(sys, ctx, ruleIndex);
+    if(min < 0) return 0;
+    
+    //rule with linear function is aggregated by defuzzification
+    if(rule->coefs != NULL){
+        ctx->ruleStrength[ruleIndex] = min;
+        out->rules[out->ruleLen++] = ruleIndex;
+        return 1;
+    }
+    
+    //aggregation, strongest rule of output fuzzy set is kept
+    if(out->strength[rule->outSet] < 0)
+        out->fired[out->length++] = rule->outSet;
+    if(min > out->strength[rule->outSet])
+        out->strength[rule->outSet] = min;
+    return 1;
+}
+
+/**
+ * @brief Calculates membership of x in curved output fuzzy set 
+ * (Gaussian or singleton)
+ * Internal function, x has to be inside of fuzzy set
+ * @param set set of output fuzzy sets
+ * @param j index of fuzzy set
+ * @param x x-axis position
+ * @return membership
+ */
+TFzzReal fzz_curvedMembership(const TFcnsSet* set, int j, TFzzReal x){
+    const TFuzzySet* fs = &set->fSet[j];
+    
+    //singleton has no width
+    if(fs->shape == FZZ_SINGLETON) return 0;
+    return (TFzzReal)exp(-(x - fs->top)*(x - fs->top)*set->kLeft[j]);
+}
+
+/**
+ * @brief Defines membership in aggregated output fuzzy set
+ * Internal, instantiated for every implication and aggregation so that
+ * operators are not dispatched for every fuzzy set; fired fuzzy sets
+ * are sorted for aggregation other than max, so result does not depend
+ * on order of rules
+ * @param name name of defined function
+ * @param IMPLY t-norm of implication (membership, strength)
+ * @param AGGREGATE s-norm of aggregation
+ */
+#define FZZ_OUTPUT_VALUE(name, IMPLY, AGGREGATE) \
+TFzzReal name(const TFcnsSet* set, const TInfOut* out, TFzzReal x){ \
+    const TFuzzySet* fs = NULL; \
+    TFzzReal max = 0; \
+    int i = 0; \
+    int j = 0; \
+    TFzzReal k = 0; \
+    TFzzReal memb = 0; \
+    \
+    for(i = 0; i < out->length; i++){ \
+        j = out->fired[i]; \
+        fs = &set->fSet[j]; \
+        /* x value intersects fuzzy set */ \
+        if(x <= fs->left) continue; \
+        if(x >= fs->right) continue; \
+        /* curved fuzzy set, left part, top or right part of fuzzy set */ \
+        if(fs->shape >= FZZ_GAUSSIAN){ \
+            memb = fzz_curvedMembership(set, j, x); \
+        }else if(x <= fs->top){ \
+            k = (TFzzReal)1.0 / (fs->top - fs->left); \
+            memb = k*(x - fs->left); \
+        }else if(x <= fs->topEnd){ \
+            memb = 1; \
+        }else{ \
+            k = (TFzzReal)1.0 / (fs->topEnd - fs->right); \
+            memb = k*(x - fs->topEnd) + 1; \
+        } \
+        memb = IMPLY(memb, out->level[j]); \
+        max = AGGREGATE(max, memb); \
+    } \
+    return max; \
+}
+
+FZZ_OUTPUT_VALUE(fzz_outputMinMax, TNORM_MIN, SNORM_MAX)
+FZZ_OUTPUT_VALUE(fzz_outputMinProbor, TNORM_MIN, SNORM_PROBOR)
+FZZ_OUTPUT_VALUE(fzz_outputMinBoundedSum, TNORM_MIN, SNORM_BOUNDED_SUM)
+FZZ_OUTPUT_VALUE(fzz_outputProductMax, TNORM_PRODUCT, SNORM_MAX)
+FZZ_OUTPUT_VALUE(fzz_outputProductProbor, TNORM_PRODUCT, SNORM_PROBOR)
+FZZ_OUTPUT_VALUE(fzz_outputProductBoundedSum, TNORM_PRODUCT, SNORM_BOUNDED_SUM)
+
+/**
+ * @brief Used for defuzzyfication
+ * Internal function, dispatches operators of system
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @param x x-axis position
+ * @return membership of x in aggregated output fuzzy set
+ */
+TFzzReal fzz_outputValue(const TFzzSystem* sys, const TFzzContext* ctx, int output, TFzzReal x){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    
+    if(sys->implication == FZZ_PRODUCT){
+        if(sys->aggregation == FZZ_PROBOR) return fzz_outputProductProbor(set, out, x);
+        if(sys->aggregation == FZZ_BOUNDED_SUM) return fzz_outputProductBoundedSum(set, out, x);
+        return fzz_outputProductMax(set, out, x);
+    }
+    if(sys->aggregation == FZZ_PROBOR) return fzz_outputMinProbor(set, out, x);
+    if(sys->aggregation == FZZ_BOUNDED_SUM) return fzz_outputMinBoundedSum(set, out, x);
+    return fzz_outputMinMax(set, out, x);
+}
+
+/**
+ * @brief Defines aggregation of implied output fuzzy set in samples
+ * Internal, instantiated for every implication and aggregation; shape
+ * of fuzzy set is dispatched once for all samples, every sample 
+ * aggregates implied fuzzy sets
+ * @param name name of defined function
+ * @param IMPLY t-norm of implication (membership, strength)
+ * @param AGGREGATE s-norm of aggregation
+ */
+#define FZZ_AGGREGATE_SAMPLES(name, IMPLY, AGGREGATE) \
+FZZ_CLONES void name(const TFcnsSet* set, int j, TFzzReal h, const TFzzReal* xs, TFzzReal* ys, int n){ \
+    const TFuzzySet* fs = &set->fSet[j]; \
+    TFzzReal kUp = (TFzzReal)1.0 / (fs->top - fs->left); \
+    TFzzReal kDown = (TFzzReal)1.0 / (fs->topEnd - fs->right); \
+    TFzzReal left = fs->left; \
+    TFzzReal top = fs->top; \
+    TFzzReal topEnd = fs->topEnd; \
+    TFzzReal right = fs->right; \
+    TFzzReal memb = 0; \
+    TFzzReal x = 0; \
+    int k = 0; \
+    \
+    switch(fs->shape){ \
+        /* singleton has no area */ \
+        case FZZ_SINGLETON: \
+            break; \
+        case FZZ_GAUSSIAN: \
+            for(k = 0; k < n; k++){ \
+                x = xs[k]; \
+                if(x <= fs->left || x >= fs->right) continue; \
+                memb = fzz_curvedMembership(set, j, x); \
+                memb = IMPLY(memb, h); \
+                ys[k] = AGGREGATE(ys[k], memb); \
+            } \
+            break; \
+        /* without branches so that loop is vectorized, sample out of */ \
+        /* fuzzy set aggregates zero which keeps its value */ \
+        default: \
+            for(k = 0; k < n; k++){ \
+                x = xs[k]; \
+                memb = x <= top ? kUp*(x - left) : (x <= topEnd ? 1 : kDown*(x - topEnd) + 1); \
+                memb = (x > left) & (x < right) ? IMPLY(memb, h) : 0; \
+                ys[k] = AGGREGATE(ys[k], memb); \
+            } \
+            break; \
+    } \
+}
+
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateMinMax, TNORM_MIN, SNORM_MAX)
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateMinProbor, TNORM_MIN, SNORM_PROBOR)
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateMinBoundedSum, TNORM_MIN, SNORM_BOUNDED_SUM)
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateProductMax, TNORM_PRODUCT, SNORM_MAX)
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateProductProbor, TNORM_PRODUCT, SNORM_PROBOR)
+FZZ_AGGREGATE_SAMPLES(fzz_aggregateProductBoundedSum, TNORM_PRODUCT, SNORM_BOUNDED_SUM)
+
+/**
+ * @brief Aggregates implied output fuzzy set in samples
+ * Internal function, dispatches operators of system
+ * @param sys fuzzy system
+ * @param set set of output fuzzy sets
+ * @param j index of fuzzy set
+ * @param h strength of fuzzy set
+ * @param xs x-axis positions of samples
+ * @param ys aggregated memberships of samples
+ * @param n number of samples
+ */
+void fzz_aggregateSamples(const TFzzSystem* sys, const TFcnsSet* set, int j, TFzzReal h, const TFzzReal* xs, TFzzReal* ys, int n){
+    if(sys->implication == FZZ_PRODUCT){
+        if(sys->aggregation == FZZ_PROBOR) fzz_aggregateProductProbor(set, j, h, xs, ys, n);
+        else if(sys->aggregation == FZZ_BOUNDED_SUM) fzz_aggregateProductBoundedSum(set, j, h, xs, ys, n);
+        else fzz_aggregateProductMax(set, j, h, xs, ys, n);
+        return;
+    }
+    if(sys->aggregation == FZZ_PROBOR) fzz_aggregateMinProbor(set, j, h, xs, ys, n);
+    else if(sys->aggregation == FZZ_BOUNDED_SUM) fzz_aggregateMinBoundedSum(set, j, h, xs, ys, n);
+    else fzz_aggregateMinMax(set, j, h, xs, ys, n);
+}
+
+/**
+ * @brief Aggregates rules of fired output fuzzy sets by aggregation 
+ * operator of system
+ * Internal function, used for aggregation other than max; fired fuzzy 
+ * sets are sorted and rules of every fuzzy set are aggregated in order 
+ * of their indexes, so level does not depend on order of evaluation
+ * @param sys fuzzy system
+ * @param ctx calculation context with fuzzified inputs
+ * @param output index of output
+ */
+void fzz_aggregateRules(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    TInfOut* out = &ctx->infOut[output];
+    const TRuleList* list = NULL;
+    TFzzReal level = 0;
+    TFzzReal strength = 0;
+    int set = 0;
+    int i = 0;
+    int j = 0;
+    
+    //insertion sort, only few fuzzy sets fire
+    for(i = 1; i < out->length; i++){
+        set = out->fired[i];
+        for(j = i; j > 0 && out->fired[j-1] > set; j--) out->fired[j] = out->fired[j-1];
+        out->fired[j] = set;
+    }
+    
+    for(i = 0; i < out->length; i++){
+        list = &sys->outSet[output].rules[out->fired[i]];
+        level = 0;
+        for(j = 0; j < list->length; j++){
+            strength = fzz_ruleStrength(sys, ctx, list->rule[j]);
+            if(strength < 0) continue;
+            if(sys->aggregation == FZZ_PROBOR) level = SNORM_PROBOR(level, strength);
+            else level = SNORM_BOUNDED_SUM(level, strength);
+        }
+        out->level[out->fired[i]] = level;
+    }
+}
+
+/**
+ * @brief Finds samples of fired range of output
+ * Internal function, in real-time mode samples are points of grid of 
+ * output inside range, so there are at most samples of system
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @param from left point of range
+ * @param to right point of range
+ * @param first first sample (output)
+ * @param step distance of samples (output)
+ * @return number of samples, -1 if samples step by COG_STEP 
+ * from left point while they are below to + COG_STEP 
+ */
+int fzz_samples(const TFzzSystem* sys, const TFzzContext* ctx, int output, TFzzReal from, TFzzReal to, TFzzReal* first, TFzzReal* step){
+    double begin = 0;
+    double end = 0;
+    
+    *first = from;
+    *step = COG_STEP;
+    if(sys->samples == 0) return -1;
+    if(from > to) return 0;
+    
+    //output fuzzy sets share one point
+    *first = ctx->sampleFrom[output];
+    *step = ctx->sampleStep[output];
+    if(!(*step > 0)) return 1;
+    
+    begin = ceil((from - ctx->sampleFrom[output]) / ctx->sampleStep[output]);
+    end = floor((to - ctx->sampleFrom[output]) / ctx->sampleStep[output]);
+    if(begin < 0) begin = 0;
+    if(end > sys->samples - 1) end = sys->samples - 1;
+    if(end < begin) return 0;
+    *first = ctx->sampleFrom[output] + (TFzzReal)begin * ctx->sampleStep[output];
+    return (int)(end - begin) + 1;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, center of area / gravity method with numeric
+ * integration using COG_STEP (grid of output in real-time mode); samples are aggregated in chunks of 
+ * COG_CHUNK, fired fuzzy sets are visited once per chunk
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifyCogStep(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    TFzzReal xs[COG_CHUNK];
+    TFzzReal ys[COG_CHUNK];
+    int steps = 0;
+    int count = 0;
+    int n = 0;
+    int i = 0;
+    int j = 0;
+    TFzzReal from = REAL_MAX;
+    TFzzReal to = -REAL_MAX;
+    TFzzReal x = 0;
+    TFzzReal step = 0;
+    TFzzReal numerator = 0;
+    TFzzReal denominator = 0;   
+    
+    //search for range
+    for(i = 0; i < out->length; i++){
+        j = out->fired[i];
+        if(set->fSet[j].left < from)
+            from = set->fSet[j].left;
+        if(set->fSet[j].right > to)
+            to = set->fSet[j].right;
+    }
+
+    //integration 
+    count = fzz_samples(sys, ctx, output, from, to, &x, &step);
+    while(count < 0 ? x < to+COG_STEP : steps < count){
+        for(n = 0; n < COG_CHUNK && (count < 0 ? x < to+COG_STEP : steps + n < count); n++, x+=step){
+            xs[n] = x;
+            ys[n] = 0;
+        }
+        for(i = 0; i < out->length; i++)
+            fzz_aggregateSamples(sys, set, out->fired[i], out->level[out->fired[i]], xs, ys, n);
+        for(i = 0; i < n; i++){
+            numerator += xs[i]*ys[i];
+            denominator += ys[i];
+        }
+        steps += n;
+    }
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.integrationSteps += steps;
+
+    //x coord of center of gravity
+    return numerator / denominator;
+}
+
+/**
+ * @brief Sorts items of real numbers by their first number
+ * Internal function, heap sort in place, it does not allocate 
+ * memory and its number of steps is bounded by n*log(n)
+ * @param items array of items
+ * @param n number of items
+ * @param width number of real numbers of item (1 or 2)
+ */
+void fzz_sortReal(TFzzReal* items, int n, int width){
+    TFzzReal t = 0;
+    int start = n/2;
+    int end = n;
+    int root = 0;
+    int child = 0;
+    int k = 0;
+    
+    //heap is built from the last parent, then the largest item is 
+    //swapped to end of heap and new root is sifted down
+    while(end > 1){
+        if(start > 0){
+            root = --start;
+        }else{
+            end--;
+            for(k = 0; k < width; k++){
+                t = items[k];
+                items[k] = items[end*width + k];
+                items[end*width + k] = t;
+            }
+            root = 0;
+        }
+        while((child = 2*root + 1) < end){
+            if(child + 1 < end && items[(child + 1)*width] > items[child*width]) child++;
+            if(!(items[child*width] > items[root*width])) break;
+            for(k = 0; k < width; k++){
+                t = items[root*width + k];
+                items[root*width + k] = items[child*width + k];
+                items[child*width + k] = t;
+            }
+            root = child;
+        }
+    }
+}
+
+/**
+ * @brief Finds points where clipped output fuzzy set reaches its strength
+ * Internal function, points bound plateau of clipped fuzzy set
+ * @param set set of output fuzzy sets
+ * @param j index of fuzzy set
+ * @param h strength of fuzzy set
+ * @param from left point of plateau (output)
+ * @param to right point of plateau (output)
+ */
+void fzz_cutPoints(const TFcnsSet* set, int j, TFzzReal h, TFzzReal* from, TFzzReal* to){
+    const TFuzzySet* fs = &set->fSet[j];
+    TFzzReal d = 0;
+    
+    switch(fs->shape){
+        case FZZ_SINGLETON:
+            *from = *to = fs->top;
+            break;
+        case FZZ_GAUSSIAN:
+            //exp(-d^2*kLeft) = h, plateau is limited by support
+            d = fs->right - fs->top;
+            if(h > 0 && (TFzzReal)sqrt(-log(h) / set->kLeft[j]) < d) d = (TFzzReal)sqrt(-log(h) / set->kLeft[j]);
+            *from = fs->top - d;
+            *to = fs->top + d;
+            break;
+        default:
+            *from = fs->left + h*(fs->top - fs->left);
+            *to = fs->right - h*(fs->right - fs->topEnd);
+            break;
+    }
+}
+
+/**
+ * @brief Finds break points of aggregated output fuzzy set
+ * Internal function, aggregated output fuzzy set is piecewise linear
+ * (except Gaussian sets, whose support is split in GAUSS_PARTS parts),
+ * break points are corners of implied fuzzy sets (clipped or scaled) 
+ * and intersections of their sides; they are stored sorted in breaks 
+ * of context. Aggregation other than max is not linear between them.
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return number of break points
+ */
+int fzz_breakPoints(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    TFzzReal* lines = ctx->lines;
+    int* lineLen = ctx->lineLen;
+    TFzzReal* breaks = ctx->breaks;
+    int breakLen = 0;
+    const TFuzzySet* fs = NULL;
+    TFzzReal h = 0;
+    TFzzReal scale = 1;
+    TFzzReal x = 0;
+    TFzzReal from = REAL_MAX;
+    TFzzReal to = -REAL_MAX;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    int l = 0;
+    
+    //corners of implied fuzzy sets and lines of their sides (y = a*x + b),
+    //scaled fuzzy set is not cut, its sides are scaled
+    for(i = 0; i < out->length; i++){
+        fs = &set->fSet[out->fired[i]];
+        h = out->level[out->fired[i]];
+        if(sys->implication == FZZ_PRODUCT) scale = h;
+        if(fs->left < from) from = fs->left;
+        if(fs->right > to) to = fs->right;
+        lineLen[i] = 0;
+        if(fs->shape == FZZ_SINGLETON){
+            breaks[breakLen++] = fs->top;
+            continue;
+        }
+        if(fs->shape == FZZ_GAUSSIAN){
+            if(sys->implication == FZZ_MIN){
+                fzz_cutPoints(set, out->fired[i], h, &breaks[breakLen], &breaks[breakLen + 1]);
+                breakLen += 2;
+            }
+            for(k = 0; k <= GAUSS_PARTS; k++)
+                breaks[breakLen++] = fs->left + k*(fs->right - fs->left)/GAUSS_PARTS;
+        }else{
+            if(sys->implication == FZZ_MIN){
+                breaks[breakLen++] = fs->left + h*(fs->top - fs->left);
+                breaks[breakLen++] = fs->right - h*(fs->right - fs->topEnd);
+            }
+            breaks[breakLen++] = fs->left;
+            breaks[breakLen++] = fs->top;
+            if(fs->topEnd > fs->top) breaks[breakLen++] = fs->topEnd;
+            breaks[breakLen++] = fs->right;
+            if(fs->top > fs->left){
+                lines[6*i + 2*lineLen[i]] = scale / (fs->top - fs->left);
+                lines[6*i + 2*lineLen[i] + 1] = -fs->left * lines[6*i + 2*lineLen[i]];
+                lineLen[i]++;
+            }
+            if(fs->right > fs->topEnd){
+                lines[6*i + 2*lineLen[i]] = scale / (fs->topEnd - fs->right);
+                lines[6*i + 2*lineLen[i] + 1] = -fs->right * lines[6*i + 2*lineLen[i]];
+                lineLen[i]++;
+            }
+        }
+        lines[6*i + 2*lineLen[i]] = 0;
+        lines[6*i + 2*lineLen[i] + 1] = h;
+        lineLen[i]++;
+    }
+    
+    //intersections of sides of different clipped fuzzy sets
+    for(i = 0; i < out->length; i++){
+        for(j = i+1; j < out->length; j++){
+            for(k = 0; k < lineLen[i]; k++){
+                for(l = 0; l < lineLen[j]; l++){
+                    if(lines[6*i + 2*k] == lines[6*j + 2*l]) continue;
+                    x = (lines[6*j + 2*l + 1] - lines[6*i + 2*k + 1]) / (lines[6*i + 2*k] - lines[6*j + 2*l]);
+                    if(x > from && x < to) breaks[breakLen++] = x;
+                }
+            }
+        }
+    }
+    
+    fzz_sortReal(breaks, breakLen, 1);
+    return breakLen;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, center of area / gravity method computed exactly.
+ * Aggregated output fuzzy set is split in its break points and every 
+ * linear part is integrated by two point Gauss quadrature, which is 
+ * exact for linear functions (and approximate for Gaussian sets).
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifyCogExact(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFzzReal* breaks = ctx->breaks;
+    int breakLen = 0;
+    TFzzReal numerator = 0;
+    TFzzReal denominator = 0;
+    TFzzReal len = 0;
+    TFzzReal mid = 0;
+    TFzzReal d = 0;
+    TFzzReal f1 = 0;
+    TFzzReal f2 = 0;
+    int steps = 0;
+    int i = 0;
+    
+    //integration of linear parts
+    breakLen = fzz_breakPoints(sys, ctx, output);
+    for(i = 1; i < breakLen; i++){
+        len = breaks[i] - breaks[i-1];
+        if(len <= 0) continue;
+        mid = (TFzzReal)0.5*(breaks[i] + breaks[i-1]);
+        d = len * (TFzzReal)0.28867513459481288225; //len/(2*sqrt(3))
+        f1 = fzz_outputValue(sys, ctx, output, mid - d);
+        f2 = fzz_outputValue(sys, ctx, output, mid + d);
+        denominator += (TFzzReal)0.5*len*(f1 + f2);
+        numerator += (TFzzReal)0.5*len*((mid - d)*f1 + (mid + d)*f2);
+        steps += 2;
+    }
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.integrationSteps += steps;
+
+    //x coord of center of gravity
+    return numerator / denominator;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, bisector of area; aggregated output fuzzy set is 
+ * split in its break points, area of linear parts is summed up to half 
+ * of total area and position in last part is solved from its quadratic
+ * area function
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifyBisector(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFzzReal* breaks = ctx->breaks;
+    int breakLen = 0;
+    TFzzReal total = 0;
+    TFzzReal area = 0;
+    TFzzReal rest = 0;
+    TFzzReal len = 0;
+    TFzzReal mid = 0;
+    TFzzReal d = 0;
+    TFzzReal f1 = 0;
+    TFzzReal f2 = 0;
+    TFzzReal slope = 0;
+    TFzzReal base = 0;
+    int steps = 0;
+    int pass = 0;
+    int i = 0;
+    
+    //the first pass sums total area, the second one searches for half of it
+    breakLen = fzz_breakPoints(sys, ctx, output);
+    for(pass = 0; pass < 2; pass++){
+        for(i = 1; i < breakLen; i++){
+            len = breaks[i] - breaks[i-1];
+            if(len <= 0) continue;
+            mid = (TFzzReal)0.5*(breaks[i] + breaks[i-1]);
+            d = len * (TFzzReal)0.28867513459481288225; //len/(2*sqrt(3))
+            f1 = fzz_outputValue(sys, ctx, output, mid - d);
+            f2 = fzz_outputValue(sys, ctx, output, mid + d);
+            area = (TFzzReal)0.5*len*(f1 + f2);
+            steps += 2;
+            if(pass == 0){
+                total += area;
+                continue;
+            }
+            if(area < rest){
+                rest -= area;
+                continue;
+            }
+            
+            //linear part f(x) = base + slope*(x - breaks[i-1]), its area 
+            //up to t is base*t + slope*t^2/2
+            slope = (f2 - f1) / (2*d);
+            base = (TFzzReal)0.5*(f1 + f2) - slope*(TFzzReal)0.5*len;
+            if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.integrationSteps += steps;
+            d = base*base + 2*slope*rest;
+            if(d < 0) d = 0;
+            if(base + (TFzzReal)sqrt(d) <= 0) return breaks[i-1];
+            return breaks[i-1] + 2*rest / (base + (TFzzReal)sqrt(d));
+        }
+        //aggregated fuzzy set has no area (only singletons fired)
+        if(!(total > 0)) break;
+        rest = (TFzzReal)0.5*total;
+    }
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.integrationSteps += steps;
+    
+    //aggregated fuzzy set has no area
+    return (TFzzReal)NAN;
+}
+
+/**
+ * @brief Searches maxima of aggregated output fuzzy set in samples
+ * Internal function, used for aggregation other than max, where 
+ * overlapping fuzzy sets can exceed the strongest fuzzy set; samples
+ * have step COG_STEP (grid of output in real-time mode)
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return mean of samples reaching maximum, NAN if no sample has
+ * nonzero membership
+ */
+TFzzReal fzz_defuzzifyMomSampled(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    TFzzReal from = REAL_MAX;
+    TFzzReal to = -REAL_MAX;
+    TFzzReal max = 0;
+    TFzzReal sum = 0;
+    TFzzReal x = 0;
+    TFzzReal y = 0;
+    TFzzReal step = 0;
+    int samples = 0;
+    int steps = 0;
+    int count = 0;
+    int i = 0;
+    
+    for(i = 0; i < out->length; i++){
+        if(set->fSet[out->fired[i]].left < from) from = set->fSet[out->fired[i]].left;
+        if(set->fSet[out->fired[i]].right > to) to = set->fSet[out->fired[i]].right;
+    }
+    samples = fzz_samples(sys, ctx, output, from, to, &x, &step);
+    for(; samples < 0 ? x < to+COG_STEP : steps < samples; x += step){
+        y = fzz_outputValue(sys, ctx, output, x);
+        steps++;
+        if(y < max) continue;
+        if(y > max){
+            max = y;
+            sum = 0;
+            count = 0;
+        }
+        sum += x;
+        count++;
+    }
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.integrationSteps += steps;
+    if(!(max > 0)) return (TFzzReal)NAN;
+    return sum / count;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, mean of maxima; maximum of aggregated output fuzzy
+ * set is reached on plateaus of implied fuzzy sets of the strongest 
+ * fuzzy sets (tops of scaled fuzzy sets), result is center of their 
+ * union (mean of plateau points when union has no width); aggregation
+ * other than max is sampled (singletons only when nothing else fired)
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifyMom(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    TFzzReal* plateau = ctx->breaks;
+    TFzzReal h = -1;
+    TFzzReal from = 0;
+    TFzzReal to = 0;
+    TFzzReal moment = 0;
+    TFzzReal width = 0;
+    TFzzReal points = 0;
+    int count = 0;
+    int len = 0;
+    int i = 0;
+    
+    if(sys->aggregation != FZZ_MAX){
+        moment = fzz_defuzzifyMomSampled(sys, ctx, output);
+        if(!isnan(moment)) return moment;
+        moment = 0;
+    }
+    
+    //plateaus (pairs of from and to) of the strongest fuzzy sets
+    for(i = 0; i < out->length; i++)
+        if(out->level[out->fired[i]] > h) h = out->level[out->fired[i]];
+    for(i = 0; i < out->length; i++){
+        if(out->level[out->fired[i]] != h) continue;
+        fzz_cutPoints(set, out->fired[i], sys->implication == FZZ_PRODUCT ? 1 : h, &plateau[2*len], &plateau[2*len + 1]);
+        len++;
+    }
+    
+    //union of sorted plateaus
+    fzz_sortReal(plateau, len, 2);
+    for(i = 0; i < len; i++){
+        if(i > 0 && plateau[2*i] <= to){
+            if(plateau[2*i + 1] > to) to = plateau[2*i + 1];
+            continue;
+        }
+        if(i > 0){
+            moment += (TFzzReal)0.5*(to*to - from*from);
+            width += to - from;
+            points += (TFzzReal)0.5*(from + to);
+            count++;
+        }
+        from = plateau[2*i];
+        to = plateau[2*i + 1];
+    }
+    if(len > 0){
+        moment += (TFzzReal)0.5*(to*to - from*from);
+        width += to - from;
+        points += (TFzzReal)0.5*(from + to);
+        count++;
+    }
+    
+    //center of union, NAN if no rule fired
+    if(width > 0) return moment / width;
+    return points / count;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, centers of tops of output fuzzy sets weighted by strength 
+ * of their rules; no integration, fuzzy sets are visited in order 
+ * of their indexes, so result does not depend on order of rules
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifyWeightedAverage(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    const TFcnsSet* set = &sys->outSet[output];
+    const TInfOut* out = &ctx->infOut[output];
+    TFzzReal numerator = 0;
+    TFzzReal denominator = 0;
+    int i = 0;
+    
+    for(i = 0; i < set->length; i++){
+        if(out->strength[i] < 0) continue;
+        numerator += out->level[i]*(TFzzReal)0.5*(set->fSet[i].top + set->fSet[i].topEnd);
+        denominator += out->level[i];
+    }
+    return numerator / denominator;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, Takagi-Sugeno output; values of linear functions
+ * of fired rules are weighted by strength of rules, fired rules are
+ * sorted by index first, so result does not depend on order of rules
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzifySugeno(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    TInfOut* out = &ctx->infOut[output];
+    const TFzzReal* coefs = NULL;
+    TFzzReal numerator = 0;
+    TFzzReal denominator = 0;
+    TFzzReal strength = 0;
+    TFzzReal value = 0;
+    int rule = 0;
+    int i = 0;
+    int j = 0;
+    
+    //insertion sort, only few rules fire
+    for(i = 1; i < out->ruleLen; i++){
+        rule = out->rules[i];
+        for(j = i; j > 0 && out->rules[j-1] > rule; j--) out->rules[j] = out->rules[j-1];
+        out->rules[j] = rule;
+    }
+    
+    for(i = 0; i < out->ruleLen; i++){
+        strength = ctx->ruleStrength[out->rules[i]];
+        coefs = sys->ruleData[out->rules[i]].coefs;
+        value = coefs[0];
+        for(j = 0; j < sys->inLen; j++) value += coefs[1 + j]*ctx->input[j];
+        numerator += strength*value;
+        denominator += strength;
+    }
+    return numerator / denominator;
+}
+
+/**
+ * @brief Calculates crisp output values of system
+ * Internal function, uses defuzzification method of output, rules 
+ * are aggregated first for aggregation other than max
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param output index of output
+ * @return crisp value of output
+ */
+TFzzReal fzz_defuzzify(const TFzzSystem* sys, TFzzContext* ctx, int output){
+    if(sys->outSet[output].functions.length > 0)
+        return fzz_defuzzifySugeno(sys, ctx, output);
+    if(sys->aggregation != FZZ_MAX)
+        fzz_aggregateRules(sys, ctx, output);
+    switch(sys->outSet[output].defuzz){
+        case FZZ_COG_EXACT:
+            return fzz_defuzzifyCogExact(sys, ctx, output);
+        case FZZ_MOM:
+            return fzz_defuzzifyMom(sys, ctx, output);
+        case FZZ_BISECTOR:
+            return fzz_defuzzifyBisector(sys, ctx, output);
+        case FZZ_WEIGHTED_AVERAGE:
+            return fzz_defuzzifyWeightedAverage(sys, ctx, output);
+        default:
+            return fzz_defuzzifyCogStep(sys, ctx, output);
+    }
+}
+
+void fzz_fuzzifyEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input){
+    long long start = 0;
+    int i = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_fuzzifyEx(...)");
+    if(ctx->statsFlags & FZZ_STATS_TIME) start = fzz_now();
+    
+    //results of incremental calculation are overwritten
+    ctx->cached = 0;
+    
+    //fuzzifycation process
+    for(i = 0; i < sys->inLen; i++)
+        fzz_fuzzify(sys, ctx, i, input[i]);
+    
+    if(ctx->statsFlags & FZZ_STATS_TIME) ctx->stats.fuzzifyNs += fzz_now() - start;
+}
+
+void fzz_inferEx(const TFzzSystem* sys, TFzzContext* ctx){
+    const TFuzzifyOut* fzOut = NULL;
+    const TRuleList* list = NULL;
+    long long start = 0;
+    int touchedLen = 0;
+    int fired = 0;
+    int rule = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_inferEx(...)");
+    if(ctx->statsFlags & FZZ_STATS_TIME) start = fzz_now();
+    ctx->cached = 0;
+    
+    //inferential mechanism
+    for(i = 0; i < sys->outLen; i++){
+        for(j = 0; j < ctx->infOut[i].length; j++)
+            ctx->infOut[i].strength[ctx->infOut[i].fired[j]] = -1;
+        ctx->infOut[i].length = 0;
+        for(j = 0; j < ctx->infOut[i].ruleLen; j++)
+            ctx->ruleStrength[ctx->infOut[i].rules[j]] = -1;
+        ctx->infOut[i].ruleLen = 0;
+    }
+    
+    //only rules listed by hit fuzzy sets (and rules with negated conditions)
+    //are visited, rule joined by and fires when all conditions of its 
+    //antecedent are hit
+    for(i = 0; i < sys->inLen; i++){
+        fzOut = &ctx->fzfOut[i];
+        for(j = 0; j < fzOut->length; j++){
+            list = &sys->inSet[i].rules[fzOut->res[j].setIndex];
+            for(k = 0; k < list->length; k++){
+                rule = list->rule[k];
+                if(ctx->hits[rule]++ == 0) ctx->touched[touchedLen++] = rule;
+            }
+        }
+        list = &sys->inSet[i].negated;
+        for(k = 0; k < list->length; k++){
+            rule = list->rule[k];
+            if(ctx->hits[rule]++ == 0) ctx->touched[touchedLen++] = rule;
+        }
+    }
+    for(i = 0; i < touchedLen; i++){
+        rule = ctx->touched[i];
+        if(ctx->hits[rule] >= sys->ruleData[rule].need)
+            fired += fzz_ininference(sys, ctx, rule);
+        ctx->hits[rule] = 0;
+    }
+    
+    ctx->fired = fired;
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.rulesEvaluated += touchedLen;
+    if(ctx->statsFlags & FZZ_STATS_TIME) ctx->stats.inferNs += fzz_now() - start;
+}
+
+void fzz_defuzzifyEx(const TFzzSystem* sys, TFzzContext* ctx, double* output){
+    long long start = 0;
+    int i = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_defuzzifyEx(...)");
+    if(ctx->statsFlags & FZZ_STATS_TIME) start = fzz_now();
+    
+    //defuzzifycation process
+    for(i = 0; i < sys->outLen; i++)
+        output[i] = fzz_defuzzify(sys, ctx, i);
+    
+    if(ctx->statsFlags & FZZ_STATS_TIME) ctx->stats.defuzzifyNs += fzz_now() - start;
+}
+
+/**
+ * @brief Calculates output of fuzzy system by fuzzyfication, 
+ * inferential mechanism and defuzzyfication
+ * Internal function
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param input array of input values
+ * @param output array for calculated outputs
+ */
+void fzz_evaluate(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output){
+    fzz_fuzzifyEx(sys, ctx, input);
+    fzz_inferEx(sys, ctx);
+    fzz_defuzzifyEx(sys, ctx, output);
+}
+
+/**
+ * @brief Interpolates system outputs from lookup table
+ * Internal function, multilinear interpolation between grid points
+ * around input, grid points with undefined output (no rule fired)
+ * are skipped
+ * @param sys baked fuzzy system
+ * @param ctx calculation context
+ * @param input array of input values
+ * @param output array for calculated outputs
+ */
+void fzz_lutValue(const TFzzSystem* sys, TFzzContext* ctx, const double* input, TFzzReal* output){
+    const TLut* lut = &sys->lut;
+    int base = 0;
+    int* cell = ctx->cell;
+    TFzzReal* frac = ctx->frac;
+    TFzzReal* weight = ctx->weight;
+    TFzzReal t = 0;
+    TFzzReal w = 0;
+    const TFzzReal* value = NULL;
+    int corner = 0;
+    int offset = 0;
+    int i = 0;
+    int j = 0;
+    
+    //grid cell containing input
+    for(i = 0; i < sys->inLen; i++){
+        t = ((TFzzReal)input[i] - lut->from[i]) / lut->step[i];
+        //input which is not a number has undefined outputs as without table
+        if(isnan(t)){
+            for(j = 0; j < sys->outLen; j++) output[j] = (TFzzReal)NAN;
+            return;
+        }
+        if(t < 0) t = 0;
+        if(t > lut->res - 1) t = lut->res - 1;
+        cell[i] = (int)t;
+        if(cell[i] > lut->res - 2) cell[i] = lut->res - 2;
+        frac[i] = t - cell[i];
+        base += cell[i]*lut->stride[i];
+    }
+    
+    //weighted sum of values in corners of cell
+    for(j = 0; j < sys->outLen; j++){
+        output[j] = 0;
+        weight[j] = 0;
+    }
+    for(corner = 0; corner < (1 << sys->inLen); corner++){
+        w = 1;
+        offset = base;
+        for(i = 0; i < sys->inLen; i++){
+            if(corner & (1 << i)){
+                w *= frac[i];
+                offset += lut->stride[i];
+            }else{
+                w *= 1 - frac[i];
+            }
+        }
+        if(w == 0) continue;
+        value = lut->table + offset*sys->outLen;
+        for(j = 0; j < sys->outLen; j++){
+            if(value[j] != value[j]) continue;
+            output[j] += w*value[j];
+            weight[j] += w;
+        }
+    }
+    for(j = 0; j < sys->outLen; j++)
+        output[j] /= weight[j];
+}
+
+double fzz_bakeEx(TFzzSystem* sys, int resolution){
+    TLut* lut = &sys->lut;
+    TFzzContext* ctx = NULL;
+    TFzzReal* table = NULL;
+    double* input = NULL;
+    double* exact = NULL;
+    double* approx = NULL;
+    double from = 0;
+    double to = 0;
+    double error = 0;
+    int points = 1;
+    int rest = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_bake(...)");
+    assert(resolution >= 2 && "Resolution has to be at least 2 in fzz_bake(...)");
+    fzz_unbakeEx(sys);
+    
+    //grid covers all input fuzzy sets
+    for(i = 0; i < sys->inLen; i++){
+        from = DBL_MAX;
+        to = -DBL_MAX;
+        for(j = 0; j < sys->inSet[i].length; j++){
+            if(sys->inSet[i].fSet[j].left < from) from = sys->inSet[i].fSet[j].left;
+            if(sys->inSet[i].fSet[j].right > to) to = sys->inSet[i].fSet[j].right;
+        }
+        assert(from < to && "Input has no fuzzy sets in fzz_bake(...)");
+        lut->from[i] = from;
+        lut->step[i] = (to - from) / (resolution - 1);
+        lut->stride[i] = points;
+        points *= resolution;
+    }
+    
+    //sampling of exact output calculation
+    table = (TFzzReal*)malloc(sizeof(TFzzReal)*points*sys->outLen);
+    input = (double*)malloc(sizeof(double)*(sys->inLen + 2*sys->outLen));
+    assert(table != NULL && input != NULL && "Memory allocation failed in fzz_bake(...)");
+    exact = input + sys->inLen;
+    approx = exact + sys->outLen;
+    ctx = fzz_createContext(sys);
+    for(k = 0; k < points; k++){
+        rest = k;
+        for(i = 0; i < sys->inLen; i++){
+            input[i] = lut->from[i] + (rest % resolution)*lut->step[i];
+            rest /= resolution;
+        }
+        fzz_evaluate(sys, ctx, input, exact);
+        for(j = 0; j < sys->outLen; j++) table[k*sys->outLen + j] = exact[j];
+    }
+    lut->table = table;
+    lut->res = resolution;
+    
+    //interpolation error in centers of grid cells
+    points = 1;
+    for(i = 0; i < sys->inLen; i++) points *= resolution - 1;
+    for(k = 0; k < points; k++){
+        rest = k;
+        for(i = 0; i < sys->inLen; i++){
+            input[i] = lut->from[i] + ((rest % (resolution - 1)) + 0.5)*lut->step[i];
+            rest /= resolution - 1;
+        }
+        fzz_evaluate(sys, ctx, input, exact);
+        fzz_lutValue(sys, ctx, input, ctx->interp);
+        for(j = 0; j < sys->outLen; j++) approx[j] = ctx->interp[j];
+        for(j = 0; j < sys->outLen; j++){
+            if(exact[j] != exact[j] || approx[j] != approx[j]) continue;
+            if(fabs(exact[j] - approx[j]) > error) error = fabs(exact[j] - approx[j]);
+        }
+    }
+    fzz_destroyContext(ctx);
+    free(input);
+    
+    return error;
+}
+
+void fzz_unbakeEx(TFzzSystem* sys){
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_unbake(...)");
+    assert(!sys->published && "Published system is read only in fzz_unbake(...)");
+    free(sys->lut.table);
+    sys->lut.table = NULL;
+    sys->lut.res = 0;
+}
+
+/**
+ * @brief Calculates fixed point membership of fuzzy set
+ * Internal function, product of distance and slope never exceeds
+ * FIXED_ONE << 16, so whole calculation fits 32 bit integers
+ * @param fixed fixed point form of system
+ * @param set index of fuzzy set (in all fuzzy sets of system)
+ * @param x normalized value
+ * @return membership in Q15, -1 if fuzzy set is not hit
+ */
+int fzz_fixedMembership(const TFixed* fixed, int set, int x){
+    const int* point = &fixed->point[4*set];
+    const int* slope = &fixed->slope[2*set];
+    int memb = 0;
+    
+    //value intersects fuzzy set
+    if(x <= point[0] || x >= point[3]) return -1;
+    
+    //left part, top or right part of fuzzy set
+    if(x <= point[1])
+        memb = ((x - point[0])*slope[0]) >> 16;
+    else if(x <= point[2])
+        memb = FIXED_ONE;
+    else
+        memb = ((point[3] - x)*slope[1]) >> 16;
+    return memb;
+}
+
+double fzz_compileFixedEx(TFzzSystem* sys){
+    TFixed* fixed = &sys->fixed;
+    const TFcnsSet* set = NULL;
+    TFzzContext* ctx = NULL;
+    double* input = NULL;
+    double* exact = NULL;
+    short* fixedIn = NULL;
+    short* fixedOut = NULL;
+    unsigned int seed = 1;
+    double from = 0;
+    double to = 0;
+    double approx = 0;
+    double error = 0;
+    size_t size = 0;
+    int count = sys->inLen + sys->outLen;
+    int sets = 0;
+    int left = 0;
+    int top = 0;
+    int topEnd = 0;
+    int right = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    assert(!sys->published && "Published system is read only in fzz_compileFixed(...)");
+    free(fixed->memory);
+    fixed->memory = NULL;
+    for(i = 0; i < sys->outLen; i++)
+        assert(sys->outSet[i].functions.length == 0 && "Linear functions in consequents are not supported in fzz_compileFixed(...)");
+    assert(sys->implication == FZZ_MIN && sys->aggregation == FZZ_MAX && "Operators other than min and max are not supported in fzz_compileFixed(...)");
+    for(i = 0; i < sys->ruLen; i++)
+        assert(sys->ruleData[i].kind == RULE_MIN && "Rules with or, not, product or weight are not supported in fzz_compileFixed(...)");
+    for(i = 0; i < count; i++){
+        set = i < sys->inLen ? &sys->inSet[i] : &sys->outSet[i - sys->inLen];
+        for(j = 0; j < set->length; j++)
+            assert(set->fSet[j].shape != FZZ_GAUSSIAN && set->fSet[j].shape != FZZ_SINGLETON && "Gaussian and singleton fuzzy sets are not supported in fzz_compileFixed(...)");
+    }
+    
+    //one memory block for all arrays
+    for(i = 0; i < sys->inLen; i++) sets += sys->inSet[i].length;
+    for(i = 0; i < sys->outLen; i++) sets += sys->outSet[i].length;
+    size = sizeof(double)*2*count + sizeof(int)*(count + 1) + sizeof(int)*2*sets + sizeof(int)*4*sets;
+    fixed->memory = malloc(size);
+    assert(fixed->memory != NULL && "Memory allocation failed in fzz_compileFixed(...)");
+    fixed->from = (double*)fixed->memory;
+    fixed->scale = fixed->from + count;
+    fixed->first = (int*)(fixed->scale + count);
+    fixed->slope = fixed->first + count + 1;
+    fixed->point = fixed->slope + 2*sets;
+    
+    //inputs and outputs normalized to range of their fuzzy sets
+    sets = 0;
+    for(i = 0; i < count; i++){
+        set = i < sys->inLen ? &sys->inSet[i] : &sys->outSet[i - sys->inLen];
+        from = DBL_MAX;
+        to = -DBL_MAX;
+        for(j = 0; j < set->length; j++){
+            if(set->fSet[j].left < from) from = set->fSet[j].left;
+            if(set->fSet[j].right > to) to = set->fSet[j].right;
+        }
+        assert(from < to && "Input or output has no fuzzy sets in fzz_compileFixed(...)");
+        fixed->from[i] = from;
+        fixed->scale[i] = FIXED_ONE / (to - from);
+        fixed->first[i] = sets;
+        
+        //points and slopes of fuzzy sets, slope of part of zero width is not used
+        for(j = 0; j < set->length; j++, sets++){
+            left = (int)((set->fSet[j].left - from)*fixed->scale[i] + 0.5);
+            top = (int)((set->fSet[j].top - from)*fixed->scale[i] + 0.5);
+            topEnd = (int)((set->fSet[j].topEnd - from)*fixed->scale[i] + 0.5);
+            right = (int)((set->fSet[j].right - from)*fixed->scale[i] + 0.5);
+            if(i < sys->inLen && set->fSet[j].shape == FZZ_LEFT_SHOULDER) left = top = -1;
+            if(i < sys->inLen && set->fSet[j].shape == FZZ_RIGHT_SHOULDER) topEnd = right = FIXED_ONE + 1;
+            fixed->point[4*sets] = left;
+            fixed->point[4*sets + 1] = top;
+            fixed->point[4*sets + 2] = topEnd;
+            fixed->point[4*sets + 3] = right;
+            fixed->slope[2*sets] = top > left ? (FIXED_ONE << 16) / (top - left) : 0;
+            fixed->slope[2*sets + 1] = right > topEnd ? (FIXED_ONE << 16) / (right - topEnd) : 0;
+        }
+    }
+    fixed->first[count] = sets;
+    
+    //error against exact calculation for random input vectors
+    input = (double*)malloc(sizeof(double)*count);
+    fixedIn = (short*)malloc(sizeof(short)*count);
+    assert(input != NULL && fixedIn != NULL && "Memory allocation failed in fzz_compileFixed(...)");
+    exact = input + sys->inLen;
+    fixedOut = fixedIn + sys->inLen;
+    ctx = fzz_createContext(sys);
+    for(k = 0; k < FIXED_SAMPLES; k++){
+        for(i = 0; i < sys->inLen; i++){
+            seed = seed*1103515245u + 12345u;
+            input[i] = fixed->from[i] + ((seed >> 16) & 0x7fff) / fixed->scale[i];
+            fixedIn[i] = fzz_inputToFixedEx(sys, i, input[i]);
+        }
+        fzz_evaluate(sys, ctx, input, exact);
+        fzz_calculateFixedEx(sys, ctx, fixedIn, fixedOut);
+        for(j = 0; j < sys->outLen; j++){
+            approx = fzz_outputFromFixedEx(sys, j, fixedOut[j]);
+            if(exact[j] != exact[j] || approx != approx) continue;
+            if(fabs(exact[j] - approx) > error) error = fabs(exact[j] - approx);
+        }
+    }
+    fzz_destroyContext(ctx);
+    free(fixedIn);
+    free(input);
+    
+    return error;
+}
+
+void fzz_calculateFixedEx(const TFzzSystem* sys, TFzzContext* ctx, const short* input, short* output){
+    const TFixed* fixed = &sys->fixed;
+    const TRule* rule = NULL;
+    short* strength = ctx->fixedStrength;
+    unsigned int numerator = 0;
+    unsigned int denominator = 0;
+    int outFirst = 0;
+    int memb = 0;
+    int min = 0;
+    int max = 0;
+    int x = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_calculateFixed(...)");
+    assert(fixed->memory != NULL && "System is not compiled to fixed point in fzz_calculateFixed(...)");
+    
+    //fuzzification, values out of range are saturated
+    for(i = 0; i < sys->inLen; i++){
+        x = input[i] < 0 ? 0 : input[i];
+        for(j = fixed->first[i]; j < fixed->first[i + 1]; j++)
+            ctx->fixedMemb[j] = (short)fzz_fixedMembership(fixed, j, x);
+    }
+    
+    //inferential mechanism, all rules are evaluated
+    outFirst = fixed->first[sys->inLen];
+    for(j = 0; j < fixed->first[sys->inLen + sys->outLen] - outFirst; j++) strength[j] = -1;
+    for(i = 0; i < sys->ruLen; i++){
+        rule = &sys->ruleData[i];
+        min = FIXED_ONE;
+        for(j = 0; j < rule->inLen && min >= 0; j++){
+            memb = ctx->fixedMemb[fixed->first[rule->inputs[j]] + rule->inSets[j]];
+            if(memb < min) min = memb;
+        }
+        if(min < 0) continue;
+        j = fixed->first[sys->inLen + rule->output] - outFirst + rule->outSet;
+        if(min > strength[j]) strength[j] = (short)min;
+    }
+    
+    //defuzzification, center of gravity sampled in whole range of output,
+    //numerator is sum of sample indexes weighted by membership
+    for(i = 0; i < sys->outLen; i++){
+        numerator = 0;
+        denominator = 0;
+        for(k = 0; k <= FIXED_STEPS; k++){
+            x = k*FIXED_ONE / FIXED_STEPS;
+            max = 0;
+            for(j = fixed->first[sys->inLen + i]; j < fixed->first[sys->inLen + i + 1]; j++){
+                if(strength[j - outFirst] <= max) continue;
+                memb = fzz_fixedMembership(fixed, j, x);
+                if(memb > strength[j - outFirst]) memb = strength[j - outFirst];
+                if(memb > max) max = memb;
+            }
+            numerator += k*max;
+            denominator += max;
+        }
+        if(denominator == 0)
+            output[i] = -1;
+        else
+            output[i] = (short)(((unsigned long long)numerator*FIXED_ONE + denominator*(FIXED_STEPS/2)) / ((unsigned long long)denominator*FIXED_STEPS));
+    }
+}
+
+short fzz_inputToFixedEx(const TFzzSystem* sys, int index, double value){
+    const TFixed* fixed = &sys->fixed;
+    double x = 0;
+    
+    assert(fixed->memory != NULL && "System is not compiled to fixed point in fzz_inputToFixed(...)");
+    assert(index < sys->inLen && "Index out of range in fzz_inputToFixed(...)");
+    
+    //normalized and saturated value, value which is not a number gives 0
+    x = (value - fixed->from[index])*fixed->scale[index];
+    if(!(x > 0)) x = 0;
+    if(x > FIXED_ONE) x = FIXED_ONE;
+    return (short)(x + 0.5);
+}
+
+double fzz_outputFromFixedEx(const TFzzSystem* sys, int index, short value){
+    const TFixed* fixed = &sys->fixed;
+    
+    assert(fixed->memory != NULL && "System is not compiled to fixed point in fzz_outputFromFixed(...)");
+    assert(index < sys->outLen && "Index out of range in fzz_outputFromFixed(...)");
+    
+    //undefined output
+    if(value < 0) return NAN;
+    return fixed->from[sys->inLen + index] + value / fixed->scale[sys->inLen + index];
+}
+
+/**
+ * @brief Checks whether one input value can hit two input fuzzy sets
+ * Internal function, supports are open intervals (open sides of 
+ * input shoulders are unbounded), singleton is hit only in its point
+ * @param set set of input fuzzy sets
+ * @param a index of the first fuzzy set
+ * @param b index of the second fuzzy set
+ * @return 1 if fuzzy sets overlap, 0 otherwise
+ */
+int fzz_setsOverlap(const TFcnsSet* set, int a, int b){
+    int singleA = set->fSet[a].shape == FZZ_SINGLETON;
+    int singleB = set->fSet[b].shape == FZZ_SINGLETON;
+    
+    if(singleA && singleB) return set->fSet[a].top == set->fSet[b].top;
+    if(singleA) return set->left[b] < set->fSet[a].top && set->fSet[a].top < set->right[b];
+    if(singleB) return set->left[a] < set->fSet[b].top && set->fSet[b].top < set->right[a];
+    return set->left[a] < set->right[b] && set->left[b] < set->right[a];
+}
+
+/**
+ * @brief Checks whether rule can never fire
+ * Internal function, rule joined by and can not fire when two of its
+ * conditions require disjoint fuzzy sets of the same input
+ * @param sys fuzzy system
+ * @param rule compiled rule
+ * @return 1 if rule can never fire, 0 otherwise
+ */
+int fzz_ruleDead(const TFzzSystem* sys, const TRule* rule){
+    int i = 0;
+    int j = 0;
+    
+    if(rule->connective != CONNECTIVE_AND) return 0;
+    for(i = 0; i < rule->inLen; i++){
+        for(j = i + 1; j < rule->inLen; j++){
+            if(rule->negated[i] || rule->negated[j] || rule->inputs[i] != rule->inputs[j]) continue;
+            if(!fzz_setsOverlap(&sys->inSet[rule->inputs[i]], rule->inSets[i], rule->inSets[j])) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether every condition of rule b is condition of rule a
+ * Internal function, conditions are compared as multisets
+ * @param a compiled rule
+ * @param b compiled rule
+ * @param used scratch flags, one for every condition of a
+ * @param any 1 if one common condition is enough
+ * @return 1 if conditions of b are contained in a (or share condition with it), 0 otherwise
+ */
+int fzz_ruleContains(const TRule* a, const TRule* b, int* used, int any){
+    int i = 0;
+    int j = 0;
+    
+    for(i = 0; i < a->inLen; i++) used[i] = 0;
+    for(j = 0; j < b->inLen; j++){
+        for(i = 0; i < a->inLen; i++){
+            if(used[i] || a->inputs[i] != b->inputs[j] || a->inSets[i] != b->inSets[j] || a->negated[i] != b->negated[j]) continue;
+            used[i] = 1;
+            break;
+        }
+        if(i < a->inLen && any) return 1;
+        if(i == a->inLen && !any) return 0;
+    }
+    return !any;
+}
+
+/**
+ * @brief Checks whether rule b is at least as strong as rule a whenever 
+ * a fires, so a does not change aggregation by max
+ * Internal function, rules need the same fuzzy set in consequent and b
+ * at least weight of a; and of conditions is weaker than and of their 
+ * subset and than or of any of them, or of conditions is weaker than 
+ * or of their superset (rule with one condition is joined by both)
+ * @param b compiled rule
+ * @param a compiled rule
+ * @param used scratch flags, one for every condition of rule
+ * @return 1 if b dominates a, 0 otherwise
+ */
+int fzz_ruleDominates(const TRule* b, const TRule* a, int* used){
+    int andA = a->connective == CONNECTIVE_AND || a->inLen == 1;
+    int orA = a->connective == CONNECTIVE_OR || a->inLen == 1;
+    int andB = b->connective == CONNECTIVE_AND || b->inLen == 1;
+    int orB = b->connective == CONNECTIVE_OR || b->inLen == 1;
+    
+    if(a->coefs != NULL || b->coefs != NULL || a->output != b->output || a->outSet != b->outSet) return 0;
+    if(b->weight < a->weight) return 0;
+    if(andA && andB && fzz_ruleContains(a, b, used, 0)) return 1;
+    if(orA && orB && fzz_ruleContains(b, a, used, 0)) return 1;
+    return andA && orB && fzz_ruleContains(a, b, used, 1);
+}
+
+/**
+ * @brief Writes conditions of rule joined by connective
+ * Internal function
+ * @param sys fuzzy system
+ * @param rule compiled rule
+ * @param text text buffer, NULL to measure length only
+ * @param first 1 if condition is the first one of rule
+ * @param connective CONNECTIVE_AND or CONNECTIVE_OR
+ * @return length of written text
+ */
+size_t fzz_ruleConditions(const TFzzSystem* sys, const TRule* rule, char* text, int first, int connective){
+    const TFcnsSet* set = NULL;
+    size_t len = 0;
+    int i = 0;
+    
+    for(i = 0; i < rule->inLen; i++, first = 0){
+        set = &sys->inSet[rule->inputs[i]];
+        if(text == NULL){
+            len += strlen(set->name) + strlen(set->fSet[rule->inSets[i]].name) + 14;
+            continue;
+        }
+        len += sprintf(text + len, "%s%s is %s%s", first ? "" : connective == CONNECTIVE_OR ? " or " : " and ", set->name, rule->negated[i] ? "not " : "", set->fSet[rule->inSets[i]].name);
+    }
+    return len;
+}
+
+/**
+ * @brief Removes dead, duplicate and subsumed rules and merges rules 
+ * joined by or once
+ * Internal function, rules are compiled again from their texts
+ * @param sys fuzzy system
+ * @param report counters of removed and merged rules, increased
+ * @return number of rules removed or merged in this pass
+ */
+int fzz_optimizePass(TFzzSystem* sys, TFzzOptimizeStats* report){
+    const TRule* rule = NULL;
+    const TRule* other = NULL;
+    const TFcnsSet* set = NULL;
+    const char* error = NULL;
+    const char** texts = NULL;
+    char* text = NULL;
+    int* state = NULL;
+    int* used = NULL;
+    size_t len = 0;
+    int ruLen = sys->ruLen;
+    int maxInLen = 1;
+    int textLen = 0;
+    int merged = 0;
+    int i = 0;
+    int j = 0;
+    
+    for(i = 0; i < ruLen; i++)
+        if(sys->ruleData[i].inLen > maxInLen) maxInLen = sys->ruleData[i].inLen;
+    state = (int*)malloc(sizeof(int)*(ruLen + maxInLen));
+    texts = (const char**)malloc(sizeof(const char*)*(ruLen + 1));
+    assert(state != NULL && texts != NULL && "Memory allocation failed in fzz_optimizeRules(...)");
+    used = state + ruLen;
+    
+    //rules which can never fire
+    for(i = 0; i < ruLen; i++){
+        state[i] = OPTIMIZE_KEPT;
+        if(!fzz_ruleDead(sys, &sys->ruleData[i])) continue;
+        state[i] = OPTIMIZE_DEAD;
+        report->dead++;
+    }
+    
+    //duplicate and subsumed rules do not change aggregation by max, 
+    //the first one of duplicates is kept
+    for(i = 0; i < ruLen && sys->aggregation == FZZ_MAX; i++){
+        for(j = 0; j < ruLen && state[i] == OPTIMIZE_KEPT; j++){
+            if(j == i || state[j] == OPTIMIZE_DEAD) continue;
+            if(!fzz_ruleDominates(&sys->ruleData[j], &sys->ruleData[i], used)) continue;
+            if(!fzz_ruleDominates(&sys->ruleData[i], &sys->ruleData[j], used)) state[i] = OPTIMIZE_SUBSUMED;
+            else if(j < i) state[i] = OPTIMIZE_DUPLICATE;
+        }
+        if(state[i] == OPTIMIZE_SUBSUMED) report->subsumed++;
+        if(state[i] == OPTIMIZE_DUPLICATE) report->duplicate++;
+    }
+    
+    //rules joined by or (or with one condition) sharing consequent and 
+    //weight are merged to the first of them, max of or is max of rules
+    for(i = 0; i < ruLen; i++){
+        if(state[i] != OPTIMIZE_KEPT) continue;
+        rule = &sys->ruleData[i];
+        texts[textLen++] = sys->rule[i];
+        if(sys->aggregation != FZZ_MAX || sys->orOp != FZZ_MAX || rule->coefs != NULL) continue;
+        if(rule->connective != CONNECTIVE_OR && rule->inLen != 1) continue;
+        len = fzz_ruleConditions(sys, rule, NULL, 1, CONNECTIVE_OR);
+        merged = 0;
+        for(j = i + 1; j < ruLen; j++){
+            other = &sys->ruleData[j];
+            if(state[j] != OPTIMIZE_KEPT || other->coefs != NULL) continue;
+            if(other->connective != CONNECTIVE_OR && other->inLen != 1) continue;
+            if(other->output != rule->output || other->outSet != rule->outSet || other->weight != rule->weight) continue;
+            state[j] = OPTIMIZE_MERGED;
+            len += fzz_ruleConditions(sys, other, NULL, 0, CONNECTIVE_OR);
+            merged++;
+        }
+        if(merged == 0) continue;
+        report->merged += merged;
+        
+        //if <conditions> then <output> is <fuzzy set> [with <weight>]
+        set = &sys->outSet[rule->output];
+        len += strlen(set->name) + strlen(set->fSet[rule->outSet].name) + 48;
+        text = (char*)fzz_arenaAlloc(&sys->arena, len);
+        len = sprintf(text, "if ");
+        len += fzz_ruleConditions(sys, rule, text + len, 1, CONNECTIVE_OR);
+        for(j = i + 1; j < ruLen; j++){
+            other = &sys->ruleData[j];
+            if(state[j] == OPTIMIZE_MERGED && other->output == rule->output && other->outSet == rule->outSet && other->weight == rule->weight)
+                len += fzz_ruleConditions(sys, other, text + len, 0, CONNECTIVE_OR);
+        }
+        len += sprintf(text + len, " then %s is %s", set->name, set->fSet[rule->outSet].name);
+        if(rule->weight != 1) sprintf(text + len, " with %.17g", (double)rule->weight);
+        texts[textLen - 1] = text;
+    }
+    
+    //rules are compiled again when any rule was removed or merged,
+    //texts of old rules stay in arena
+    if(textLen < ruLen){
+        fzz_clearRules(sys);
+        for(i = 0; i < textLen; i++){
+            error = fzz_addRuleText(sys, texts[i]);
+            assert(error == NULL && "Optimized rule can not be compiled in fzz_optimizeRules(...)");
+        }
+    }
+    free(texts);
+    free(state);
+    return ruLen - textLen;
+}
+
+/**
+ * @brief Evaluates system for pseudo random input vectors covering 
+ * all input fuzzy sets
+ * Internal function, the same vectors are generated for every call
+ * @param sys fuzzy system
+ * @param output outputs for OPTIMIZE_SAMPLES input vectors
+ */
+void fzz_optimizeSamples(const TFzzSystem* sys, double* output){
+    TFzzContext* ctx = NULL;
+    const TFcnsSet* set = NULL;
+    double* input = NULL;
+    unsigned int seed = 1;
+    double from = 0;
+    double to = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    input = (double*)malloc(sizeof(double)*sys->inLen);
+    assert(input != NULL && "Memory allocation failed in fzz_optimizeRules(...)");
+    ctx = fzz_createContext(sys);
+    for(k = 0; k < OPTIMIZE_SAMPLES; k++){
+        for(i = 0; i < sys->inLen; i++){
+            set = &sys->inSet[i];
+            from = DBL_MAX;
+            to = -DBL_MAX;
+            for(j = 0; j < set->length; j++){
+                if(set->fSet[j].left < from) from = set->fSet[j].left;
+                if(set->fSet[j].right > to) to = set->fSet[j].right;
+            }
+            assert(from <= to && "Input has no fuzzy sets in fzz_optimizeRules(...)");
+            seed = seed*1103515245u + 12345u;
+            input[i] = from + ((seed >> 16) & 0x7fff) / 32767.0 * (to - from);
+        }
+        fzz_evaluate(sys, ctx, input, output + k*sys->outLen);
+    }
+    fzz_destroyContext(ctx);
+    free(input);
+}
+
+double fzz_optimizeRulesEx(TFzzSystem* sys, TFzzOptimizeStats* stats){
+    TFzzOptimizeStats report;
+    double* original = NULL;
+    double* output = NULL;
+    double deviation = 0;
+    int changed = 0;
+    int i = 0;
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_optimizeRules(...)");
+    memset(&report, 0, sizeof(TFzzOptimizeStats));
+    report.rules = sys->ruLen;
+    original = (double*)malloc(sizeof(double)*2*sys->outLen*OPTIMIZE_SAMPLES);
+    assert(original != NULL && "Memory allocation failed in fzz_optimizeRules(...)");
+    output = original + sys->outLen*OPTIMIZE_SAMPLES;
+    fzz_optimizeSamples(sys, original);
+    
+    //merged rules can subsume other rules, passes are repeated until 
+    //nothing changes
+    while(fzz_optimizePass(sys, &report) > 0) changed = 1;
+    
+    //deviation of outputs for the same input vectors
+    if(changed){
+        fzz_optimizeSamples(sys, output);
+        for(i = 0; i < sys->outLen*OPTIMIZE_SAMPLES; i++){
+            if((output[i] != output[i]) != (original[i] != original[i])) deviation = HUGE_VAL;
+            else if(fabs(output[i] - original[i]) > deviation) deviation = fabs(output[i] - original[i]);
+        }
+    }
+    free(original);
+    
+    report.remaining = sys->ruLen;
+    report.deviation = deviation;
+    if(stats != NULL) *stats = report;
+    return deviation;
+}
+
+/**
+ * @brief Returns upper bound of comparisons of fzz_sortReal
+ * Internal function
+ * @param n number of sorted items
+ * @return number of comparisons
+ */
+long long fzz_sortSteps(long long n){
+    long long depth = 1;
+    
+    while((1LL << depth) < n) depth++;
+    return 2*n*(depth + 1);
+}
+
+long long fzz_worstCaseEx(const TFzzSystem* sys, TFzzWorstCase* report){
+    TFzzWorstCase wc;
+    const TFcnsSet* set = NULL;
+    TFzzReal from = 0;
+    TFzzReal to = 0;
+    long long samples = 0;
+    long long breaks = 0;
+    long long sides = 0;
+    long long n = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    memset(&wc, 0, sizeof(TFzzWorstCase));
+    
+    //baked system interpolates corners of grid cell
+    if(sys->lut.table != NULL){
+        wc.integrationSteps = 1LL << sys->inLen;
+        wc.outputSets = wc.integrationSteps*sys->outLen;
+    }else{
+        //all fuzzy sets of inputs are hit and all rules are evaluated,
+        //rule is listed by index once per condition
+        for(i = 0; i < sys->inLen; i++) wc.memberships += sys->inSet[i].length;
+        wc.rules = sys->ruLen;
+        for(i = 0; i < sys->ruLen; i++) wc.conditions += 2*sys->ruleData[i].inLen;
+        
+        for(i = 0; i < sys->outLen; i++){
+            set = &sys->outSet[i];
+            n = set->length;
+            if(set->functions.length > 0){
+                wc.outputSets += (long long)set->functions.length*(sys->inLen + 1);
+                continue;
+            }
+            
+            //aggregation other than max sorts fired fuzzy sets and 
+            //evaluates their rules again
+            if(sys->aggregation != FZZ_MAX){
+                wc.comparisons += n*(n - 1)/2;
+                for(j = 0; j < set->length; j++)
+                    for(k = 0; k < set->rules[j].length; k++) 
+                        wc.conditions += sys->ruleData[set->rules[j].rule[k]].inLen;
+            }
+            
+            //samples of whole output, break points of all fuzzy sets 
+            //and intersections of all their sides
+            from = REAL_MAX;
+            to = -REAL_MAX;
+            for(j = 0; j < set->length; j++){
+                if(set->fSet[j].left < from) from = set->fSet[j].left;
+                if(set->fSet[j].right > to) to = set->fSet[j].right;
+            }
+            samples = sys->samples;
+            if(samples == 0 && from <= to) samples = (long long)((to - from) / COG_STEP) + 3;
+            breaks = MAX_BREAKS(n);
+            sides = 9*n*(n - 1)/2;
+            switch(set->defuzz){
+                case FZZ_COG_EXACT:
+                    wc.integrationSteps += 2*breaks;
+                    wc.outputSets += 2*breaks*n + sides;
+                    wc.comparisons += fzz_sortSteps(breaks);
+                    break;
+                case FZZ_BISECTOR:
+                    wc.integrationSteps += 4*breaks;
+                    wc.outputSets += 4*breaks*n + sides;
+                    wc.comparisons += fzz_sortSteps(breaks);
+                    break;
+                case FZZ_MOM:
+                    wc.outputSets += n;
+                    wc.comparisons += fzz_sortSteps(n);
+                    if(sys->aggregation == FZZ_MAX) break;
+                    wc.integrationSteps += samples;
+                    wc.outputSets += samples*n;
+                    break;
+                case FZZ_WEIGHTED_AVERAGE:
+                    wc.outputSets += n;
+                    break;
+                default:
+                    wc.integrationSteps += samples;
+                    wc.outputSets += samples*n;
+                    break;
+            }
+        }
+    }
+    
+    wc.operations = wc.memberships + wc.rules + wc.conditions + wc.outputSets + wc.comparisons;
+    if(report != NULL) *report = wc;
+    return wc.operations;
+}
+
+void fzz_calculateOutputEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output){
+    long long start = 0;
+    int i = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_calculateOutput(...)");
+    if(ctx->statsFlags & (FZZ_STATS_TIME | FZZ_STATS_TRACE)) start = fzz_now();
+    
+    //baked system is evaluated by interpolation in lookup table
+    if(sys->lut.table != NULL){
+        fzz_lutValue(sys, ctx, input, ctx->interp);
+        for(i = 0; i < sys->outLen; i++) output[i] = ctx->interp[i];
+        ctx->fired = 0;
+    }else{
+        fzz_evaluate(sys, ctx, input, output);
+    }
+    
+    if(ctx->statsFlags != 0) fzz_statsRecord(sys, ctx, input, output, start);
+}
+
+/**
+ * @brief Lists rules referencing hit fuzzy sets of input and rules 
+ * with negated condition on input
+ * Internal function, every rule is listed once (marked in hits)
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param in index of input
+ * @param touchedLen number of already listed rules
+ * @return number of listed rules
+ */
+int fzz_touchRules(const TFzzSystem* sys, TFzzContext* ctx, int in, int touchedLen){
+    const TFuzzifyOut* fzOut = &ctx->fzfOut[in];
+    const TRuleList* list = NULL;
+    int rule = 0;
+    int j = 0;
+    int k = 0;
+    
+    for(j = 0; j < fzOut->length; j++){
+        list = &sys->inSet[in].rules[fzOut->res[j].setIndex];
+        for(k = 0; k < list->length; k++){
+            rule = list->rule[k];
+            if(ctx->hits[rule] != 0) continue;
+            ctx->hits[rule] = 1;
+            ctx->touched[touchedLen++] = rule;
+        }
+    }
+    list = &sys->inSet[in].negated;
+    for(k = 0; k < list->length; k++){
+        rule = list->rule[k];
+        if(ctx->hits[rule] != 0) continue;
+        ctx->hits[rule] = 1;
+        ctx->touched[touchedLen++] = rule;
+    }
+    return touchedLen;
+}
+
+/**
+ * @brief Calculates output of fuzzy system incrementally
+ * Internal function
+ * @see fzz_updateOutputEx
+ * @param sys fuzzy system
+ * @param ctx calculation context
+ * @param input array of input values
+ * @param output array for calculated outputs
+ */
+void fzz_evaluateChanged(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output){
+    const TRule* rule = NULL;
+    const TRuleList* list = NULL;
+    TInfOut* out = NULL;
+    TFzzReal* agg = NULL;
+    TFzzReal strength = 0;
+    TFzzReal old = 0;
+    TFzzReal max = 0;
+    int touchedLen = 0;
+    int changed = 0;
+    int set = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    
+    //without results of previous calculation everything is calculated
+    if(!ctx->cached){
+        ctx->fired = 0;
+        for(i = 0; i < sys->ruLen; i++) ctx->ruleStrength[i] = -1;
+        for(i = 0; i < sys->outLen; i++){
+            out = &ctx->infOut[i];
+            for(j = 0; j < out->length; j++) out->strength[out->fired[j]] = -1;
+            out->length = 0;
+            out->ruleLen = 0;
+            out->changed = 1;
+        }
+    }
+    
+    //changed inputs are fuzzified again, rules referencing fuzzy sets
+    //hit before or now are evaluated again
+    for(i = 0; i < sys->inLen; i++){
+        if(ctx->cached && (TFzzReal)input[i] == ctx->input[i]) continue;
+        if(ctx->cached) touchedLen = fzz_touchRules(sys, ctx, i, touchedLen);
+        fzz_fuzzify(sys, ctx, i, input[i]);
+        touchedLen = fzz_touchRules(sys, ctx, i, touchedLen);
+        changed = 1;
+    }
+    
+    //no input changed, previous outputs are returned
+    if(!changed && ctx->cached){
+        for(i = 0; i < sys->outLen; i++) output[i] = ctx->output[i];
+        return;
+    }
+    
+    //aggregation is updated by rules whose strength changed
+    if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.rulesEvaluated += touchedLen;
+    for(i = 0; i < touchedLen; i++){
+        ctx->hits[ctx->touched[i]] = 0;
+        rule = &sys->ruleData[ctx->touched[i]];
+        strength = fzz_ruleStrength(sys, ctx, ctx->touched[i]);
+        old = ctx->ruleStrength[ctx->touched[i]];
+        if(strength == old) continue;
+        ctx->ruleStrength[ctx->touched[i]] = strength;
+        ctx->fired += (strength >= 0) - (old >= 0);
+        out = &ctx->infOut[rule->output];
+        if(rule->coefs != NULL){
+            //list of fired rules with linear functions, order does not matter
+            if(old < 0) out->rules[out->ruleLen++] = ctx->touched[i];
+            if(strength >= 0) continue;
+            for(k = 0; out->rules[k] != ctx->touched[i]; k++);
+            out->rules[k] = out->rules[--out->ruleLen];
+            continue;
+        }
+        //every rule changes aggregation other than max
+        if(sys->aggregation != FZZ_MAX) out->changed = 1;
+        agg = &out->strength[rule->outSet];
+        if(*agg == STALE_STRENGTH) continue;
+        if(strength > *agg){
+            if(*agg < 0) out->fired[out->length++] = rule->outSet;
+            *agg = strength;
+            out->changed = 1;
+        }else if(old == *agg){
+            //strongest rule became weaker
+            *agg = STALE_STRENGTH;
+            out->stale[out->staleLen++] = rule->outSet;
+            out->changed = 1;
+        }
+    }
+    
+    //stale fuzzy sets are aggregated from all their rules, only changed 
+    //outputs are defuzzified again (Sugeno outputs depend on inputs directly)
+    for(i = 0; i < sys->outLen; i++){
+        out = &ctx->infOut[i];
+        if(sys->outSet[i].functions.length > 0) out->changed = 1;
+        for(j = 0; j < out->staleLen; j++){
+            set = out->stale[j];
+            list = &sys->outSet[i].rules[set];
+            max = -1;
+            for(k = 0; k < list->length; k++)
+                if(ctx->ruleStrength[list->rule[k]] > max) max = ctx->ruleStrength[list->rule[k]];
+            out->strength[set] = max;
+            if(max >= 0) continue;
+            //fuzzy set is removed from fired fuzzy sets, their order does not matter
+            for(k = 0; out->fired[k] != set; k++);
+            out->fired[k] = out->fired[--out->length];
+        }
+        out->staleLen = 0;
+        if(out->changed) ctx->output[i] = fzz_defuzzify(sys, ctx, i);
+        out->changed = 0;
+        output[i] = ctx->output[i];
+    }
+    ctx->cached = 1;
+}
+
+void fzz_updateOutputEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output){
+    long long start = 0;
+    int i = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_updateOutput(...)");
+    if(ctx->statsFlags & (FZZ_STATS_TIME | FZZ_STATS_TRACE)) start = fzz_now();
+    
+    //baked system is evaluated by interpolation in lookup table
+    if(sys->lut.table != NULL){
+        fzz_lutValue(sys, ctx, input, ctx->interp);
+        for(i = 0; i < sys->outLen; i++) output[i] = ctx->interp[i];
+        ctx->fired = 0;
+    }else{
+        fzz_evaluateChanged(sys, ctx, input, output);
+    }
+    
+    if(ctx->statsFlags != 0) fzz_statsRecord(sys, ctx, input, output, start);
+}
+
+double fzz_calculateOutputForEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, int output){
+    const TFcnsSet* set = NULL;
+    TInfOut* out = NULL;
+    long long start = 0;
+    double value = 0;
+    int i = 0;
+    int j = 0;
+    
+    assert(ctx->sys == sys && ctx->revision == sys->revision && "Context was created for another system or revision in fzz_calculateOutputFor(...)");
+    assert(output >= 0 && output < sys->outLen && "Index out of range in fzz_calculateOutputFor(...)");
+    if(ctx->statsFlags & (FZZ_STATS_TIME | FZZ_STATS_TRACE)) start = fzz_now();
+    
+    //results of incremental calculation are overwritten
+    ctx->cached = 0;
+    ctx->fired = 0;
+    
+    //baked system is evaluated by interpolation in lookup table
+    if(sys->lut.table != NULL){
+        fzz_lutValue(sys, ctx, input, ctx->interp);
+        value = ctx->interp[output];
+    }else{
+        //fuzzifycation process
+        for(i = 0; i < sys->inLen; i++)
+            fzz_fuzzify(sys, ctx, i, input[i]);
+        
+        //only rules with consequent in given output are evaluated
+        set = &sys->outSet[output];
+        out = &ctx->infOut[output];
+        for(i = 0; i < out->length; i++)
+            out->strength[out->fired[i]] = -1;
+        out->length = 0;
+        for(i = 0; i < set->length; i++){
+            for(j = 0; j < set->rules[i].length; j++)
+                ctx->fired += fzz_ininference(sys, ctx, set->rules[i].rule[j]);
+            if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.rulesEvaluated += set->rules[i].length;
+        }
+        for(i = 0; i < out->ruleLen; i++)
+            ctx->ruleStrength[out->rules[i]] = -1;
+        out->ruleLen = 0;
+        for(j = 0; j < set->functions.length; j++)
+            ctx->fired += fzz_ininference(sys, ctx, set->functions.rule[j]);
+        if(ctx->statsFlags & FZZ_STATS_COUNT) ctx->stats.rulesEvaluated += set->functions.length;
+        value = fzz_defuzzify(sys, ctx, output);
+    }
+    
+    if(ctx->statsFlags != 0) fzz_statsRecord(sys, ctx, input, NULL, start);
+    return value;
+}
+
+void fzz_calculateBatchEx(const TFzzSystem* sys, TFzzContext* ctx, int count, const double* inputs, double* outputs){
+    int i = 0;
+    
+    //the same context is reused for all samples
+    for(i = 0; i < count; i++)
+        fzz_calculateOutputEx(sys, ctx, inputs + (size_t)i*sys->inLen, outputs + (size_t)i*sys->outLen);
+}
+
+/**
+ * @brief Reads parameters of shape of fuzzy set
+ * Internal function
+ * @param fs fuzzy set
+ * @param params parameters of shape (see TFzzShape), output
+ */
+void fzz_shapeParams(const TFuzzySet* fs, double* params){
+    const int* points = fzzShapePoints[fs->shape];
+    
+    params[points[0]] = fs->left;
+    params[points[1]] = fs->top;
+    params[points[2]] = fs->topEnd;
+    params[points[3]] = fs->right;
+    if(fs->shape == FZZ_GAUSSIAN){
+        params[0] = fs->top;
+        params[1] = (fs->right - fs->top) / GAUSS_CUT;
+    }
+}
+
+/**
+ * @brief Adds derivative of membership in hit input fuzzy set to gradient
+ * Internal function, membership of linear side depends on its two 
+ * points, derivatives by points are added to parameters they are made 
+ * of; open side of input shoulder and top are flat
+ * @param train state of training
+ * @param in index of input
+ * @param j index of fuzzy set
+ * @param x value of input
+ * @param memb membership of input in fuzzy set
+ * @param scale derivative of error by membership
+ * @param gradient gradient of worker
+ */
+void fzz_trainMembership(const TTrain* train, int in, int j, TFzzReal x, TFzzReal memb, double scale, double* gradient){
+    const TFcnsSet* set = &train->sys->inSet[in];
+    const TFuzzySet* fs = &set->fSet[j];
+    const int* points = fzzShapePoints[fs->shape];
+    double d[4] = {0, 0, 0, 0};
+    double sigma = 0;
+    double k = 0;
+    int first = 0;
+    int i = 0;
+    
+    if(train->inBlock[train->inFirst[in] + j] < 0) return;
+    first = train->first[train->inBlock[train->inFirst[in] + j]];
+    
+    //exp(-(x - center)^2/(2*sigma^2)) by center and sigma
+    if(fs->shape == FZZ_GAUSSIAN){
+        sigma = (fs->right - fs->top) / GAUSS_CUT;
+        k = x - fs->top;
+        gradient[first] += scale*memb*k/(sigma*sigma);
+        gradient[first + 1] += scale*memb*k*k/(sigma*sigma*sigma);
+        return;
+    }
+    
+    //(x - left)/(top - left) on left side, (right - x)/(right - topEnd) on right side
+    if(x <= set->top[j]){
+        k = set->top[j] - set->left[j];
+        d[0] = (x - set->top[j])/(k*k);
+        d[1] = -(x - set->left[j])/(k*k);
+    }else if(x > set->topEnd[j]){
+        k = set->right[j] - set->topEnd[j];
+        d[2] = (set->right[j] - x)/(k*k);
+        d[3] = (x - set->topEnd[j])/(k*k);
+    }
+    for(i = 0; i < 4; i++) gradient[first + points[i]] += scale*d[i];
+}
+
+/**
+ * @brief Adds derivative of strength of fired rule to gradient
+ * Internal function, derivative of operator of connective by every
+ * condition (min and max pass it to the chosen condition only) is 
+ * multiplied by derivative of membership of condition
+ * @param train state of training
+ * @param ctx context of calculated sample
+ * @param ruleIndex index of fired rule
+ * @param scale derivative of error by strength of rule
+ * @param gradient gradient of worker
+ */
+void fzz_trainRule(const TTrain* train, const TFzzContext* ctx, int ruleIndex, double scale, double* gradient){
+    const TFzzSystem* sys = train->sys;
+    const TRule* rule = &sys->ruleData[ruleIndex];
+    int op = rule->connective == CONNECTIVE_AND ? sys->andOp : sys->orOp;
+    TFzzReal memb = 0;
+    double value = 0;
+    double best = 0;
+    double sum = 0;
+    double d = 0;
+    int chosen = 0;
+    int i = 0;
+    int j = 0;
+    
+    //condition chosen by min or max and sum of bounded sum
+    for(i = 0; i < rule->inLen; i++){
+        memb = ctx->fzfOut[rule->inputs[i]].memb[rule->inSets[i]];
+        value = memb < 0 ? 0 : memb;
+        if(rule->negated[i]) value = 1 - value;
+        sum += value;
+        if(i == 0 || (op == FZZ_MIN && value < best) || (op == FZZ_MAX && value > best)){
+            chosen = i;
+            best = value;
+        }
+    }
+    
+    for(i = 0; i < rule->inLen; i++){
+        memb = ctx->fzfOut[rule->inputs[i]].memb[rule->inSets[i]];
+        //membership of fuzzy set which was not hit is constant
+        if(memb < 0) continue;
+        switch(op){
+            case FZZ_PRODUCT:
+            case FZZ_PROBOR:
+                //product of other conditions (of their complements for probor)
+                d = 1;
+                for(j = 0; j < rule->inLen; j++){
+                    if(j == i) continue;
+                    value = ctx->fzfOut[rule->inputs[j]].memb[rule->inSets[j]];
+                    value = value < 0 ? 0 : value;
+                    if(rule->negated[j]) value = 1 - value;
+                    d *= op == FZZ_PRODUCT ? value : 1 - value;
+                }
+                break;
+            case FZZ_BOUNDED_SUM:
+                d = sum < 1 ? 1 : 0;
+                break;
+            default:
+                d = i == chosen ? 1 : 0;
+                break;
+        }
+        if(rule->negated[i]) d = -d;
+        if(d != 0) fzz_trainMembership(train, rule->inputs[i], rule->inSets[i], ctx->input[rule->inputs[i]], memb, scale*d*rule->weight, gradient);
+    }
+}
+
+/**
+ * @brief Calculates sample of dataset and adds its error and gradient 
+ * to sums of worker
+ * Internal function, gradient is analytic for Sugeno outputs: with 
+ * strengths w and linear functions f of fired rules output is 
+ * sum(w*f)/sum(w), so its derivative by coefficient of f is w/sum(w) 
+ * times input of coefficient and by strength w it is (f - output)/sum(w)
+ * @param train state of training
+ * @param ctx context of worker
+ * @param sums sums of worker
+ * @param sample index of sample
+ */
+void fzz_trainSample(const TTrain* train, TFzzContext* ctx, double* sums, int sample){
+    const TFzzSystem* sys = train->sys;
+    const double* target = train->targets + (size_t)sample*sys->outLen;
+    const TInfOut* out = NULL;
+    const TFzzReal* coefs = NULL;
+    double* output = sums + 2;
+    double* gradient = sums + 2 + sys->outLen;
+    double error = 0;
+    double total = 0;
+    double value = 0;
+    double k = 0;
+    int first = 0;
+    int rule = 0;
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    
+    fzz_calculateOutputEx(sys, ctx, train->inputs + (size_t)sample*sys->inLen, output);
+    for(i = 0; i < sys->outLen; i++){
+        //outputs without fired rule and missing targets are not counted
+        if(output[i] != output[i] || target[i] != target[i]) continue;
+        error = output[i] - target[i];
+        sums[0] += error*error;
+        sums[1] += 1;
+        
+        out = &ctx->infOut[i];
+        total = 0;
+        for(j = 0; j < out->ruleLen; j++) total += ctx->ruleStrength[out->rules[j]];
+        for(j = 0; j < out->ruleLen; j++){
+            rule = out->rules[j];
+            coefs = sys->ruleData[rule].coefs;
+            value = coefs[0];
+            for(n = 0; n < sys->inLen; n++) value += coefs[1 + n]*ctx->input[n];
+            
+            //coefficients of linear function
+            if(train->ruleBlock[rule] >= 0){
+                first = train->first[train->ruleBlock[rule]];
+                k = error*ctx->ruleStrength[rule]/total;
+                gradient[first] += k;
+                for(n = 0; n < sys->inLen; n++) gradient[first + 1 + n] += k*ctx->input[n];
+            }
+            //membership functions of antecedent
+            fzz_trainRule(train, ctx, rule, error*(value - output[i])/total, gradient);
+        }
+    }
+}
+
+/**
+ * @brief Replaces fuzzified input by levels of linked output fuzzy sets
+ * Internal function, fuzzy sets of output with level above zero are hit
+ * @param graph graph of fuzzy systems
+ * @param node node with fuzzy link
+ * @param in index of linked input of node
+ */
+void fzz_graphFuzzyInput(const TFzzGraph* graph, const TGraphNode* node, int in){
+    const TGraphNode* from = &graph->nodes[node->from[in]];
+    const TInfOut* out = &from->ctx->infOut[node->source[in] - from->firstOutput];
+    TFuzzifyOut* fzOut = &node->ctx->fzfOut[in];
+    int set = 0;
+    int i = 0;
+    
+    for(i = 0; i < node->sys->inSet[in].length; i++) fzOut->memb[i] = -1;
+    fzOut->length = 0;
+    for(i = 0; i < out->length; i++){
+        set = out->fired[i];
+        if(!(out->level[set] > 0)) continue;
+        fzOut->res[fzOut->length].membership = out->level[set];
+        fzOut->res[fzOut->length].setIndex = set;
+        fzOut->memb[set] = out->level[set];
+        fzOut->length++;
+    }
+}
+
+/**
+ * @brief Calculates outputs of node of graph
+ * Internal function, nodes linked to inputs must be calculated before
+ * @param graph prepared graph of fuzzy systems
+ * @param index index of node
+ * @param input array of graph input values
+ * @param output array of graph outputs, outputs of node are written
+ */
+void fzz_graphNode(const TFzzGraph* graph, int index, const double* input, double* output){
+    const TGraphNode* node = &graph->nodes[index];
+    int i = 0;
+    
+    //inputs are gathered from graph inputs and outputs of linked nodes
+    for(i = 0; i < node->sys->inLen; i++)
+        node->input[i] = node->source[i] >= 0 ? output[node->source[i]] : input[-1 - node->source[i]];
+    if(!node->staged){
+        fzz_calculateOutputEx(node->sys, node->ctx, node->input, output + node->firstOutput);
+        return;
+    }
+    
+    //fuzzy links replace results of fuzzification
+    fzz_fuzzifyEx(node->sys, node->ctx, node->input);
+    for(i = 0; i < node->sys->inLen; i++)
+        if(node->fuzzy[i]) fzz_graphFuzzyInput(graph, node, i);
+    fzz_inferEx(node->sys, node->ctx);
+    fzz_defuzzifyEx(node->sys, node->ctx, output + node->firstOutput);
+}
+
+#ifdef FZZ_THREADS
+/**
+ * @brief Calculates input vectors of worker range, then steals from others
+ * Internal function
+ * @param w worker of pool
+ */
+void fzz_poolWork(TFzzWorker* w){
+    TFzzPool* pool = w->pool;
+    TFzzWorker* v = NULL;
+    int from = 0;
+    int to = 0;
+    int i = 0;
+    
+    while(1){
+        //chunk from own range
+        pthread_mutex_lock(&w->lock);
+        from = w->next;
+        to = from + pool->chunk < w->end ? from + pool->chunk : w->end;
+        w->next = to;
+        pthread_mutex_unlock(&w->lock);
+        if(from < to){
+            for(i = from; i < to && pool->graph != NULL; i++)
+                fzz_graphNode(pool->graph, pool->graph->order[pool->first + i], pool->inputs, pool->outputs);
+            for(i = from; i < to && pool->train != NULL; i++)
+                fzz_trainSample(pool->train, w->ctx, pool->train->sums + w->index*pool->train->stride, i);
+            for(i = from; i < to && pool->graph == NULL && pool->train == NULL; i++)
+                fzz_calculateOutputEx(pool->sys, w->ctx, pool->inputs + (size_t)i*pool->sys->inLen, pool->outputs + (size_t)i*pool->sys->outLen);
+            continue;
+        }
+        
+        //half of remaining range of other worker is stolen
+        for(i = 1; i < pool->threads && from >= to; i++){
+            v = pool->workers[(w->index + i) % pool->threads];
+            pthread_mutex_lock(&v->lock);
+            if(v->next < v->end){
+                to = v->end;
+                from = v->end - (v->end - v->next + 1) / 2;
+                v->end = from;
+            }
+            pthread_mutex_unlock(&v->lock);
+        }
+        if(from >= to) return;
+        pthread_mutex_lock(&w->lock);
+        w->next = from;
+        w->end = to;
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+/**
+ * @brief Main function of worker thread
+ * Internal function
+ * @param arg worker of pool
+ */
+void* fzz_poolThread(void* arg){
+    TFzzWorker* w = (TFzzWorker*)arg;
+    TFzzPool* pool = w->pool;
+    unsigned int generation = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    while(1){
+        //waiting for next batch
+        while(!pool->quit && pool->generation == generation)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if(pool->quit) break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        
+        fzz_poolWork(w);
+        
+        //last finished thread wakes up calling thread
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->running == 0) pthread_cond_signal(&pool->finish);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief Calculates items of pool job by all workers
+ * Internal function, every worker gets its range of items, 
+ * calling thread works too and waits for others
+ * @param pool pool of worker threads with job set
+ * @param count number of items (input vectors or nodes)
+ * @param chunk number of items taken by worker at once
+ */
+void fzz_poolRun(TFzzPool* pool, int count, int chunk){
+    TFzzWorker* w = NULL;
+    int i = 0;
+    
+    for(i = 0; i < pool->threads; i++){
+        w = pool->workers[i];
+        pthread_mutex_lock(&w->lock);
+        w->next = (int)((long long)count * i / pool->threads);
+        w->end = (int)((long long)count * (i+1) / pool->threads);
+        pthread_mutex_unlock(&w->lock);
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->chunk = chunk;
+    pool->running = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    fzz_poolWork(pool->workers[0]);
+    pthread_mutex_lock(&pool->lock);
+    while(pool->running > 0)
+        pthread_cond_wait(&pool->finish, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+#endif
+
+TFzzPool* fzz_createPool(int threads){
+    TFzzPool* pool = NULL;
+    char* slots = NULL;
+    size_t slot = (sizeof(TFzzWorker) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    int i = 0;
+    
+    //number of workers
+    #ifdef FZZ_THREADS
+    if(threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads <= 0) threads = 1;
+    #else
+    threads = 1;
+    #endif
+    
+    pool = (TFzzPool*)calloc(1, sizeof(TFzzPool));
+    assert(pool != NULL && "Memory allocation failed in fzz_createPool(...)");
+    pool->threads = threads;
+    
+    //workers do not share cache lines, the first item of arena is aligned
+    slots = (char*)fzz_arenaAlloc(&pool->arena, slot*threads);
+    pool->workers = (TFzzWorker**)fzz_arenaAlloc(&pool->arena, sizeof(TFzzWorker*)*threads);
+    for(i = 0; i < threads; i++){
+        pool->workers[i] = (TFzzWorker*)(slots + i*slot);
+        pool->workers[i]->pool = pool;
+        pool->workers[i]->index = i;
+    }
+    
+    //calling thread is the first worker
+    #ifdef FZZ_THREADS
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->finish, NULL);
+    for(i = 0; i < threads; i++) pthread_mutex_init(&pool->workers[i]->lock, NULL);
+    for(i = 1; i < threads; i++){
+        if(pthread_create(&pool->workers[i]->thread, NULL, fzz_poolThread, pool->workers[i]) != 0) break;
+    }
+    //pool is smaller when thread can not be started
+    for(threads = i; i < pool->threads; i++)
+        pthread_mutex_destroy(&pool->workers[i]->lock);
+    pool->threads = threads;
+    #endif
+    
+    return pool;
+}
+
+void fzz_destroyPool(TFzzPool* pool){
+    int i = 0;
+    
+    //threads are stopped
+    #ifdef FZZ_THREADS
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for(i = 1; i < pool->threads; i++) pthread_join(pool->workers[i]->thread, NULL);
+    for(i = 0; i < pool->threads; i++) pthread_mutex_destroy(&pool->workers[i]->lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->finish);
+    #endif
+    
+    //workers are released with arena of pool
+    for(i = 0; i < pool->threads; i++)
+        if(pool->workers[i]->ctx != NULL) fzz_destroyContext(pool->workers[i]->ctx);
+    fzz_arenaFree(&pool->arena);
+    free(pool);
+}
+
+int fzz_poolThreads(const TFzzPool* pool){
+    return pool->threads;
+}
+
+/**
+ * @brief Prepares contexts of workers of pool for system
+ * Internal function, contexts are created again for another system 
+ * or revision
+ * @param pool pool of worker threads
+ * @param sys fuzzy system
+ */
+void fzz_poolContexts(TFzzPool* pool, const TFzzSystem* sys){
+    TFzzWorker* w = NULL;
+    int i = 0;
+    
+    for(i = 0; i < pool->threads; i++){
+        w = pool->workers[i];
+        if(w->ctx != NULL && (w->ctx->sys != sys || w->ctx->revision != sys->revision)){
+            fzz_destroyContext(w->ctx);
+            w->ctx = NULL;
+        }
+        if(w->ctx == NULL) w->ctx = fzz_createContext(sys);
+    }
+}
+
+void fzz_calculateBatchPoolEx(const TFzzSystem* sys, TFzzPool* pool, int count, const double* inputs, double* outputs){
+    fzz_poolContexts(pool, sys);
+    
+    //small batch is calculated by calling thread only
+    if(pool->threads == 1 || count <= POOL_CHUNK){
+        fzz_calculateBatchEx(sys, pool->workers[0]->ctx, count, inputs, outputs);
+        return;
+    }
+    
+    #ifdef FZZ_THREADS
+    //every worker gets its range of input vectors
+    pool->sys = sys;
+    pool->graph = NULL;
+    pool->inputs = inputs;
+    pool->outputs = outputs;
+    fzz_poolRun(pool, count, POOL_CHUNK);
+    #endif
+}
+
+TFzzGraph* fzz_createGraph(){
+    TFzzGraph* graph = NULL;
+    
+    graph = (TFzzGraph*)calloc(1, sizeof(TFzzGraph));
+    assert(graph != NULL && "Memory allocation failed in fzz_createGraph(...)");
+    return graph;
+}
+
+void fzz_destroyGraph(TFzzGraph* graph){
+    int i = 0;
+    
+    //nodes are released with arena of graph
+    for(i = 0; i < graph->length; i++)
+        if(graph->nodes[i].ctx != NULL) fzz_destroyContext(graph->nodes[i].ctx);
+    free(graph->order);
+    fzz_arenaFree(&graph->arena);
+    free(graph);
+}
+
+/**
+ * @brief Finds node and its input or output by name "node.name"
+ * Internal function
+ * @param graph graph of fuzzy systems
+ * @param name name of input or output with name of node
+ * @param isInput 1 to find input, 0 to find output
+ * @param node found node (output), -1 if not found
+ * @return index of input or output of node, -1 if not found
+ */
+int fzz_graphEndpoint(const TFzzGraph* graph, const char* name, int isInput, int* node){
+    const char* dot = strchr(name, '.');
+    size_t len = 0;
+    int i = 0;
+    
+    *node = -1;
+    if(dot == NULL) return -1;
+    len = dot - name;
+    for(i = 0; i < graph->length; i++){
+        if(strncmp(name, graph->nodes[i].name, len) || graph->nodes[i].name[len] != '\0') continue;
+        *node = i;
+        if(isInput) return fzz_inputIndex(graph->nodes[i].sys, dot + 1);
+        return fzz_outputIndex(graph->nodes[i].sys, dot + 1);
+    }
+    return -1;
+}
+
+int fzz_addGraphNode(TFzzGraph* graph, const TFzzSystem* sys, const char* name){
+    TGraphNode* nodes = NULL;
+    TGraphNode* node = NULL;
+    size_t len = strlen(name);
+    int i = 0;
+    
+    assert(strchr(name, '.') == NULL && "Name of node contains '.' in fzz_addGraphNode(...)");
+    for(i = 0; i < graph->length; i++)
+        assert(strcmp(name, graph->nodes[i].name) && "Name of node is not unique in fzz_addGraphNode(...)");
+    
+    //capacity of nodes is doubled when it is full
+    if(graph->length == graph->capacity){
+        graph->capacity = graph->capacity > 0 ? 2*graph->capacity : 8;
+        nodes = (TGraphNode*)fzz_arenaAlloc(&graph->arena, sizeof(TGraphNode)*graph->capacity);
+        if(graph->length > 0) memcpy(nodes, graph->nodes, sizeof(TGraphNode)*graph->length);
+        graph->nodes = nodes;
+    }
+    
+    //inputs are not linked
+    node = &graph->nodes[graph->length];
+    node->sys = sys;
+    node->name = (char*)memcpy(fzz_arenaAlloc(&graph->arena, len + 1), name, len + 1);
+    node->from = (int*)fzz_arenaAlloc(&graph->arena, sizeof(int)*sys->inLen);
+    node->source = (int*)fzz_arenaAlloc(&graph->arena, sizeof(int)*sys->inLen);
+    node->fuzzy = (int*)fzz_arenaAlloc(&graph->arena, sizeof(int)*sys->inLen);
+    node->input = (double*)fzz_arenaAlloc(&graph->arena, sizeof(double)*sys->inLen);
+    for(i = 0; i < sys->inLen; i++){
+        node->from[i] = -1;
+        node->source[i] = -1;
+    }
+    node->firstOutput = graph->outLen;
+    graph->outLen += sys->outLen;
+    graph->ready = 0;
+    return graph->length++;
+}
+
+/**
+ * @brief Finds out whether node depends on another node
+ * Internal function, linked nodes are searched depth first
+ * @param graph graph of fuzzy systems
+ * @param node searched node
+ * @param target node which can be linked to searched node
+ * @return 1 if target is node or it is linked to node through other nodes 
+ */
+int fzz_graphDepends(const TFzzGraph* graph, int node, int target){
+    int* stack = NULL;
+    char* visited = NULL;
+    const TGraphNode* n = NULL;
+    int length = 0;
+    int found = 0;
+    int i = 0;
+    
+    stack = (int*)malloc(sizeof(int)*graph->length + graph->length);
+    assert(stack != NULL && "Memory allocation failed in fzz_linkGraph(...)");
+    visited = (char*)(stack + graph->length);
+    memset(visited, 0, graph->length);
+    stack[length++] = node;
+    visited[node] = 1;
+    while(length > 0 && !found){
+        n = &graph->nodes[stack[--length]];
+        found = n == &graph->nodes[target];
+        for(i = 0; i < n->sys->inLen; i++){
+            if(n->from[i] < 0 || visited[n->from[i]]) continue;
+            visited[n->from[i]] = 1;
+            stack[length++] = n->from[i];
+        }
+    }
+    free(stack);
+    return found;
+}
+
+int fzz_linkGraph(TFzzGraph* graph, const char* from, const char* to, int fuzzy){
+    const TFzzSystem* src = NULL;
+    const TFzzSystem* dst = NULL;
+    TGraphNode* node = NULL;
+    int fromNode = 0;
+    int toNode = 0;
+    int output = fzz_graphEndpoint(graph, from, 0, &fromNode);
+    int input = fzz_graphEndpoint(graph, to, 1, &toNode);
+    
+    //both names exist, input is free and link does not close cycle
+    if(output < 0 || input < 0) return -1;
+    node = &graph->nodes[toNode];
+    if(node->from[input] >= 0) return -1;
+    if(fzz_graphDepends(graph, fromNode, toNode)) return -1;
+    
+    //fuzzy sets of fuzzy link correspond by index
+    src = graph->nodes[fromNode].sys;
+    dst = node->sys;
+    if(fuzzy && (src->outSet[output].length != dst->inSet[input].length || src->outSet[output].functions.length > 0)) return -1;
+    
+    node->from[input] = fromNode;
+    node->source[input] = graph->nodes[fromNode].firstOutput + output;
+    node->fuzzy[input] = fuzzy != 0;
+    graph->ready = 0;
+    return 0;
+}
+
+/**
+ * @brief Prepares graph for calculation
+ * Internal function, graph inputs and levels are assigned when graph 
+ * changed, contexts are created again for new revision of systems
+ * @param graph graph of fuzzy systems
+ */
+void fzz_prepareGraph(TFzzGraph* graph){
+    TGraphNode* node = NULL;
+    const TGraphNode* from = NULL;
+    int changed = 1;
+    int level = 0;
+    int i = 0;
+    int j = 0;
+    
+    for(i = 0; i < graph->length; i++){
+        node = &graph->nodes[i];
+        if(node->ctx != NULL && node->ctx->revision != node->sys->revision){
+            fzz_destroyContext(node->ctx);
+            node->ctx = NULL;
+        }
+        if(node->ctx == NULL) node->ctx = fzz_createContext(node->sys);
+        for(j = 0; j < node->sys->inLen; j++){
+            if(!node->fuzzy[j]) continue;
+            from = &graph->nodes[node->from[j]];
+            assert(from->sys->outSet[node->source[j] - from->firstOutput].length == node->sys->inSet[j].length && "Fuzzy sets of fuzzy link differ in fzz_calculateGraph(...)");
+            assert(from->sys->outSet[node->source[j] - from->firstOutput].functions.length == 0 && "Fuzzy link from output with linear functions in fzz_calculateGraph(...)");
+        }
+    }
+    if(graph->ready) return;
+    
+    //inputs which are not linked are assigned to graph inputs,
+    //nodes with fuzzy link are staged
+    graph->inLen = 0;
+    for(i = 0; i < graph->length; i++){
+        node = &graph->nodes[i];
+        node->level = 0;
+        node->staged = 0;
+        for(j = 0; j < node->sys->inLen; j++)
+            if(node->from[j] < 0) node->source[j] = -1 - graph->inLen++;
+    }
+    for(i = 0; i < graph->length; i++){
+        node = &graph->nodes[i];
+        for(j = 0; j < node->sys->inLen; j++){
+            if(!node->fuzzy[j]) continue;
+            node->staged = 1;
+            graph->nodes[node->from[j]].staged = 1;
+        }
+    }
+    
+    //level is one above levels of linked nodes, graph is acyclic
+    //so levels are stable after number of nodes passes
+    graph->levels = graph->length > 0 ? 1 : 0;
+    while(changed){
+        changed = 0;
+        for(i = 0; i < graph->length; i++){
+            node = &graph->nodes[i];
+            for(j = 0; j < node->sys->inLen; j++){
+                if(node->from[j] < 0) continue;
+                level = graph->nodes[node->from[j]].level + 1;
+                if(level <= node->level) continue;
+                node->level = level;
+                if(level + 1 > graph->levels) graph->levels = level + 1;
+                changed = 1;
+            }
+        }
+    }
+    
+    //nodes sorted by level, in order of indexes within level
+    free(graph->order);
+    graph->order = (int*)malloc(sizeof(int)*(2*graph->length + 1));
+    assert(graph->order != NULL && "Memory allocation failed in fzz_calculateGraph(...)");
+    graph->levelStart = graph->order + graph->length;
+    j = 0;
+    for(level = 0; level < graph->levels; level++){
+        graph->levelStart[level] = j;
+        for(i = 0; i < graph->length; i++)
+            if(graph->nodes[i].level == level) graph->order[j++] = i;
+    }
+    graph->levelStart[graph->levels] = j;
+    graph->ready = 1;
+}
+
+int fzz_graphInputs(TFzzGraph* graph){
+    fzz_prepareGraph(graph);
+    return graph->inLen;
+}
+
+int fzz_graphOutputs(TFzzGraph* graph){
+    return graph->outLen;
+}
+
+int fzz_graphInputIndex(TFzzGraph* graph, const char* name){
+    int node = 0;
+    int input = fzz_graphEndpoint(graph, name, 1, &node);
+    
+    if(input < 0 || graph->nodes[node].from[input] >= 0) return -1;
+    fzz_prepareGraph(graph);
+    return -1 - graph->nodes[node].source[input];
+}
+
+int fzz_graphOutputIndex(TFzzGraph* graph, const char* name){
+    int node = 0;
+    int output = fzz_graphEndpoint(graph, name, 0, &node);
+    
+    if(output < 0) return -1;
+    return graph->nodes[node].firstOutput + output;
+}
+
+void fzz_calculateGraph(TFzzGraph* graph, const double* input, double* output){
+    int i = 0;
+    
+    fzz_prepareGraph(graph);
+    for(i = 0; i < graph->length; i++)
+        fzz_graphNode(graph, graph->order[i], input, output);
+}
+
+void fzz_calculateGraphPool(TFzzGraph* graph, TFzzPool* pool, const double* input, double* output){
+    int count = 0;
+    int level = 0;
+    int i = 0;
+    
+    fzz_prepareGraph(graph);
+    for(level = 0; level < graph->levels; level++){
+        //level with one node is calculated by calling thread
+        count = graph->levelStart[level + 1] - graph->levelStart[level];
+        if(pool->threads == 1 || count == 1){
+            for(i = graph->levelStart[level]; i < graph->levelStart[level + 1]; i++)
+                fzz_graphNode(graph, graph->order[i], input, output);
+            continue;
+        }
+        
+        #ifdef FZZ_THREADS
+        //one node is taken by worker at once
+        pool->graph = graph;
+        pool->first = graph->levelStart[level];
+        pool->inputs = input;
+        pool->outputs = output;
+        fzz_poolRun(pool, count, 1);
+        pool->graph = NULL;
+        #endif
+    }
+}
+
+TFzzShared* fzz_createShared(TFzzSystem* sys){
+    TFzzShared* shared = NULL;
+    
+    assert(!sys->published && "System is already published in fzz_createShared(...)");
+    shared = (TFzzShared*)calloc(1, sizeof(TFzzShared));
+    assert(shared != NULL && "Memory allocation failed in fzz_createShared(...)");
+    sys->published = 1;
+    shared->current = sys;
+    #ifdef FZZ_THREADS
+    pthread_mutex_init(&shared->lock, NULL);
+    #endif
+    return shared;
+}
+
+void fzz_destroyShared(TFzzShared* shared){
+    int i = 0;
+    
+    assert(shared->readerLen == 0 && "Shared system has readers in fzz_destroyShared(...)");
+    for(i = 0; i < shared->retiredLen; i++) fzz_destroy(shared->retired[i]);
+    fzz_destroy(shared->current);
+    #ifdef FZZ_THREADS
+    pthread_mutex_destroy(&shared->lock);
+    #endif
+    free(shared->retired);
+    free(shared->readers);
+    free(shared);
+}
+
+/**
+ * @brief Releases retired systems which are not pinned by any reader
+ * Internal function, called with lock of shared system
+ * @param shared shared fuzzy system
+ */
+void fzz_reclaimShared(TFzzShared* shared){
+    int pinned = 0;
+    int i = 0;
+    int j = 0;
+    
+    for(i = 0; i < shared->retiredLen; ){
+        pinned = 0;
+        for(j = 0; j < shared->readerLen && !pinned; j++)
+            pinned = ATOMIC_LOAD(&shared->readers[j]->sys) == shared->retired[i];
+        if(pinned){
+            i++;
+            continue;
+        }
+        fzz_destroy(shared->retired[i]);
+        shared->retired[i] = shared->retired[--shared->retiredLen];
+    }
+}
+
+void fzz_publishShared(TFzzShared* shared, TFzzSystem* sys){
+    assert(!sys->published && "System is already published in fzz_publishShared(...)");
+    sys->published = 1;
+    
+    #ifdef FZZ_THREADS
+    pthread_mutex_lock(&shared->lock);
+    #endif
+    //capacity of retired systems is doubled when it is full
+    if(shared->retiredLen == shared->retiredCapacity){
+        shared->retiredCapacity = shared->retiredCapacity > 0 ? 2*shared->retiredCapacity : 4;
+        shared->retired = (TFzzSystem**)realloc(shared->retired, sizeof(TFzzSystem*)*shared->retiredCapacity);
+        assert(shared->retired != NULL && "Memory allocation failed in fzz_publishShared(...)");
+    }
+    
+    //readers take new system by their next calculation, previous one
+    //is released when no reader pins it
+    shared->retired[shared->retiredLen++] = shared->current;
+    ATOMIC_STORE(&shared->current, sys);
+    fzz_reclaimShared(shared);
+    #ifdef FZZ_THREADS
+    pthread_mutex_unlock(&shared->lock);
+    #endif
+}
+
+TFzzReader* fzz_createReader(TFzzShared* shared){
+    TFzzReader* reader = NULL;
+    
+    reader = (TFzzReader*)calloc(1, sizeof(TFzzReader));
+    assert(reader != NULL && "Memory allocation failed in fzz_createReader(...)");
+    reader->shared = shared;
+    
+    #ifdef FZZ_THREADS
+    pthread_mutex_lock(&shared->lock);
+    #endif
+    if(shared->readerLen == shared->readerCapacity){
+        shared->readerCapacity = shared->readerCapacity > 0 ? 2*shared->readerCapacity : 4;
+        shared->readers = (TFzzReader**)realloc(shared->readers, sizeof(TFzzReader*)*shared->readerCapacity);
+        assert(shared->readers != NULL && "Memory allocation failed in fzz_createReader(...)");
+    }
+    shared->readers[shared->readerLen++] = reader;
+    #ifdef FZZ_THREADS
+    pthread_mutex_unlock(&shared->lock);
+    #endif
+    return reader;
+}
+
+void fzz_destroyReader(TFzzReader* reader){
+    TFzzShared* shared = reader->shared;
+    int i = 0;
+    
+    //system pinned by reader can be released
+    #ifdef FZZ_THREADS
+    pthread_mutex_lock(&shared->lock);
+    #endif
+    for(i = 0; i < shared->readerLen && shared->readers[i] != reader; i++);
+    assert(i < shared->readerLen && "Reader is not registered in fzz_destroyReader(...)");
+    shared->readers[i] = shared->readers[--shared->readerLen];
+    fzz_reclaimShared(shared);
+    #ifdef FZZ_THREADS
+    pthread_mutex_unlock(&shared->lock);
+    #endif
+    
+    if(reader->ctx != NULL) fzz_destroyContext(reader->ctx);
+    free(reader);
+}
+
+/**
+ * @brief Returns current system of shared system for reader
+ * Internal function, new system is pinned and its context is created
+ * @param reader reader of shared system
+ * @return system pinned by reader
+ */
+const TFzzSystem* fzz_readerSystem(TFzzReader* reader){
+    TFzzSystem* sys = ATOMIC_LOAD(&reader->shared->current);
+    
+    //context of previous system is released before it is unpinned,
+    //so context never belongs to system reusing its memory
+    if(sys != reader->sys){
+        if(reader->ctx != NULL) fzz_destroyContext(reader->ctx);
+        reader->ctx = NULL;
+        
+        //system is pinned, then it is checked that it is still current 
+        //(writer did not miss pin while releasing it)
+        while(sys != reader->sys){
+            ATOMIC_STORE(&reader->sys, sys);
+            sys = ATOMIC_LOAD(&reader->shared->current);
+        }
+        reader->ctx = fzz_createContext(sys);
+    }
+    return sys;
+}
+
+void fzz_calculateOutputShared(TFzzReader* reader, const double* input, double* output){
+    const TFzzSystem* sys = fzz_readerSystem(reader);
+    
+    fzz_calculateOutputEx(sys, reader->ctx, input, output);
+}
+
+/**
+ * @brief Keeps trained parameters of shape valid
+ * Internal function, points are sorted and sigma of Gaussian fuzzy set
+ * stays positive
+ * @param shape shape of membership function
+ * @param params parameters of shape
+ */
+void fzz_trainShape(int shape, double* params){
+    double swap = 0;
+    int i = 0;
+    int j = 0;
+    
+    if(shape == FZZ_GAUSSIAN){
+        if(!(params[1] >= TRAIN_MIN_SIGMA)) params[1] = TRAIN_MIN_SIGMA;
+        return;
+    }
+    for(i = 1; i < fzzShapeParams[shape]; i++){
+        for(j = i; j > 0 && params[j-1] > params[j]; j--){
+            swap = params[j];
+            params[j] = params[j-1];
+            params[j-1] = swap;
+        }
+    }
+}
+
+/**
+ * @brief Stores trained parameters of block in system
+ * Internal function, system has to be marked as modified then
+ * @param train state of training
+ * @param block index of block
+ * @param value all trained parameters
+ */
+void fzz_trainApply(TTrain* train, int block, const double* value){
+    TFcnsSet* set = train->set[block];
+    TRule* rule = NULL;
+    double params[4];
+    int first = train->first[block];
+    int i = 0;
+    
+    if(set == NULL){
+        rule = &train->sys->ruleData[train->index[block]];
+        for(i = first; i < train->first[block + 1]; i++) rule->coefs[i - first] = (TFzzReal)value[i];
+        return;
+    }
+    memcpy(params, value + first, sizeof(double)*(train->first[block + 1] - first));
+    fzz_trainShape(set->fSet[train->index[block]].shape, params);
+    fzz_shapeFcn(set, train->index[block], (TFzzShape)set->fSet[train->index[block]].shape, params, train->input[block]);
+}
+
+/**
+ * @brief Collects trained parameters of system to blocks
+ * Internal function, input singletons are not trained (their membership
+ * has no derivative), output fuzzy sets only with numeric gradient
+ * @param train state of training with system
+ * @param flags trained parameters (TFzzTrainFlag)
+ * @param analytic 1 for analytic gradient
+ * @param threads number of workers adding to sums
+ */
+void fzz_trainCollect(TTrain* train, int flags, int analytic, int threads){
+    TFzzSystem* sys = train->sys;
+    TFcnsSet* set = NULL;
+    size_t per = CACHE_LINE / sizeof(double);
+    char* sums = NULL;
+    int blocks = sys->ruLen;
+    int params = (sys->inLen + 1)*sys->ruLen;
+    int sets = 0;
+    int b = 0;
+    int n = 0;
+    int i = 0;
+    int j = 0;
+    
+    //space for all fuzzy sets and rules
+    for(i = 0; i < sys->inLen; i++) sets += sys->inSet[i].length;
+    blocks += sets;
+    params += 4*sets;
+    for(i = 0; i < sys->outLen; i++){
+        blocks += sys->outSet[i].length;
+        params += 4*sys->outSet[i].length;
+    }
+    train->set = (TFcnsSet**)fzz_arenaAlloc(&train->arena, sizeof(TFcnsSet*)*blocks);
+    train->index = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*blocks);
+    train->input = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*blocks);
+    train->first = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*(blocks + 1));
+    train->value = (double*)fzz_arenaAlloc(&train->arena, sizeof(double)*params);
+    train->inFirst = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*(sys->inLen + 1));
+    train->inBlock = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*(sets + 1));
+    train->ruleBlock = (int*)fzz_arenaAlloc(&train->arena, sizeof(int)*(sys->ruLen + 1));
+    
+    //input fuzzy sets
+    for(i = 0; i < sys->inLen; i++){
+        set = &sys->inSet[i];
+        train->inFirst[i] = n;
+        for(j = 0; j < set->length; j++, n++){
+            train->inBlock[n] = -1;
+            if(!(flags & FZZ_TRAIN_INPUTS) || set->fSet[j].shape == FZZ_SINGLETON) continue;
+            train->inBlock[n] = b;
+            train->set[b] = set;
+            train->index[b] = j;
+            train->input[b] = 1;
+            fzz_shapeParams(&set->fSet[j], train->value + train->first[b]);
+            train->first[b + 1] = train->first[b] + fzzShapeParams[set->fSet[j].shape];
+            b++;
+        }
+    }
+    train->inFirst[sys->inLen] = n;
+    
+    //output fuzzy sets of Mamdani outputs
+    for(i = 0; i < sys->outLen; i++){
+        set = &sys->outSet[i];
+        if(!(flags & FZZ_TRAIN_OUTPUTS) || analytic || set->functions.length > 0) continue;
+        for(j = 0; j < set->length; j++){
+            train->set[b] = set;
+            train->index[b] = j;
+            fzz_shapeParams(&set->fSet[j], train->value + train->first[b]);
+            train->first[b + 1] = train->first[b] + fzzShapeParams[set->fSet[j].shape];
+            b++;
+        }
+    }
+    
+    //coefficients of linear functions
+    for(i = 0; i < sys->ruLen; i++){
+        train->ruleBlock[i] = -1;
+        if(!(flags & FZZ_TRAIN_CONSEQUENTS) || sys->ruleData[i].coefs == NULL) continue;
+        train->ruleBlock[i] = b;
+        train->index[b] = i;
+        for(j = 0; j <= sys->inLen; j++) train->value[train->first[b] + j] = sys->ruleData[i].coefs[j];
+        train->first[b + 1] = train->first[b] + sys->inLen + 1;
+        b++;
+    }
+    train->length = b;
+    
+    //sums of workers take whole cache lines
+    params = train->first[b];
+    train->gradient = (double*)fzz_arenaAlloc(&train->arena, sizeof(double)*(params + 1));
+    train->stride = (int)((2 + sys->outLen + params + per - 1) / per * per);
+    sums = (char*)fzz_arenaAlloc(&train->arena, sizeof(double)*train->stride*threads + CACHE_LINE);
+    train->sums = (double*)(((size_t)sums + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+}
+
+/**
+ * @brief Calculates error of system over dataset by batch calculation
+ * Internal function, outputs without fired rule and missing targets 
+ * are not counted
+ * @param train state of training
+ * @param pool pool of worker threads
+ * @param output outputs of all samples
+ * @param valid number of counted outputs, output
+ * @return mean squared error of counted outputs
+ */
+double fzz_trainError(const TTrain* train, TFzzPool* pool, double* output, int* valid){
+    const double* target = train->targets;
+    size_t length = (size_t)train->count*train->sys->outLen;
+    double error = 0;
+    size_t i = 0;
+    int n = 0;
+    
+    fzz_calculateBatchPoolEx(train->sys, pool, train->count, train->inputs, output);
+    for(i = 0; i < length; i++){
+        if(output[i] != output[i] || target[i] != target[i]) continue;
+        error += (output[i] - target[i])*(output[i] - target[i]);
+        n++;
+    }
+    *valid = n;
+    return n > 0 ? error / n : 0;
+}
+
+/**
+ * @brief Calculates analytic gradient of half of mean squared error
+ * Internal function, samples are calculated by workers of pool
+ * @see fzz_trainSample
+ * @param train state of training, gradient is stored there
+ * @param pool pool of worker threads
+ */
+void fzz_trainAnalytic(TTrain* train, TFzzPool* pool){
+    double* sums = train->sums;
+    double* gradient = sums + 2 + train->sys->outLen;
+    int i = 0;
+    int j = 0;
+    
+    memset(sums, 0, sizeof(double)*train->stride*pool->threads);
+    fzz_poolContexts(pool, train->sys);
+    if(pool->threads == 1 || train->count <= POOL_CHUNK){
+        for(i = 0; i < train->count; i++) fzz_trainSample(train, pool->workers[0]->ctx, sums, i);
+    }else{
+        #ifdef FZZ_THREADS
+        pool->train = train;
+        fzz_poolRun(pool, train->count, POOL_CHUNK);
+        pool->train = NULL;
+        #endif
+    }
+    
+    //sums of workers are added to the first one
+    for(i = 1; i < pool->threads; i++)
+        for(j = 0; j < train->stride; j++) sums[j] += sums[i*train->stride + j];
+    for(i = 0; i < train->first[train->length]; i++)
+        train->gradient[i] = sums[1] > 0 ? gradient[i] / sums[1] : 0;
+}
+
+/**
+ * @brief Calculates numeric gradient of half of mean squared error
+ * Internal function, central difference of every parameter needs 
+ * two batch calculations of dataset; parameter whose change counts
+ * another number of outputs gets zero
+ * @param train state of training, gradient is stored there
+ * @param pool pool of worker threads
+ * @param output outputs of all samples
+ */
+void fzz_trainNumeric(TTrain* train, TFzzPool* pool, double* output){
+    double* value = train->value;
+    double saved = 0;
+    double delta = 0;
+    double plus = 0;
+    double minus = 0;
+    int plusValid = 0;
+    int minusValid = 0;
+    int b = 0;
+    int i = 0;
+    
+    for(b = 0; b < train->length; b++){
+        for(i = train->first[b]; i < train->first[b + 1]; i++){
+            saved = value[i];
+            delta = TRAIN_DELTA*(fabs(saved) > 1 ? fabs(saved) : 1);
+            value[i] = saved + delta;
+            fzz_trainApply(train, b, value);
+            fzz_modified(train->sys);
+            plus = fzz_trainError(train, pool, output, &plusValid);
+            value[i] = saved - delta;
+            fzz_trainApply(train, b, value);
+            fzz_modified(train->sys);
+            minus = fzz_trainError(train, pool, output, &minusValid);
+            value[i] = saved;
+            fzz_trainApply(train, b, value);
+            train->gradient[i] = plusValid == minusValid ? (plus - minus) / (4*delta) : 0;
+        }
+    }
+    fzz_modified(train->sys);
+}
+
+/**
+ * @brief Writes texts of rules with trained coefficients
+ * Internal function, texts of old rules stay in arena
+ * @param train state of training
+ */
+void fzz_trainText(TTrain* train){
+    TFzzSystem* sys = train->sys;
+    const TRule* rule = NULL;
+    const TFcnsSet* set = NULL;
+    char* text = NULL;
+    size_t len = 0;
+    int b = 0;
+    int i = 0;
+    
+    for(b = 0; b < train->length; b++){
+        if(train->set[b] != NULL) continue;
+        rule = &sys->ruleData[train->index[b]];
+        set = &sys->outSet[rule->output];
+        len = fzz_ruleConditions(sys, rule, NULL, 1, rule->connective) + strlen(set->name) + 64;
+        for(i = 0; i < sys->inLen; i++) len += strlen(sys->inSet[i].name) + 32;
+        
+        //if <conditions> then <output> is <constant> [+ <coefficient>*<input>]... [with <weight>]
+        text = (char*)fzz_arenaAlloc(&sys->arena, len);
+        len = sprintf(text, "if ");
+        len += fzz_ruleConditions(sys, rule, text + len, 1, rule->connective);
+        len += sprintf(text + len, " then %s is %.17g", set->name, (double)rule->coefs[0]);
+        for(i = 0; i < sys->inLen; i++){
+            if(rule->coefs[1 + i] == 0) continue;
+            len += sprintf(text + len, " %c %.17g*%s", rule->coefs[1 + i] < 0 ? '-' : '+', fabs((double)rule->coefs[1 + i]), sys->inSet[i].name);
+        }
+        if(rule->weight != 1) sprintf(text + len, " with %.17g", (double)rule->weight);
+        sys->rule[train->index[b]] = text;
+    }
+}
+
+double fzz_trainEx(TFzzSystem* sys, TFzzPool* pool, int count, const double* inputs, const double* targets, const TFzzTrainParams* params, TFzzTrainStats* stats){
+    TTrain train;
+    TFzzTrainStats report;
+    TFzzPool* own = NULL;
+    double* output = NULL;
+    double* trial = NULL;
+    double rate = TRAIN_RATE;
+    double tolerance = 0;
+    double error = 0;
+    double trialError = 0;
+    int flags = FZZ_TRAIN_INPUTS | FZZ_TRAIN_OUTPUTS | FZZ_TRAIN_CONSEQUENTS;
+    int epochs = TRAIN_EPOCHS;
+    int length = 0;
+    int valid = 0;
+    int trialValid = 0;
+    int changed = 0;
+    int b = 0;
+    int i = 0;
+    
+    assert(sys->mapping == NULL && "Loaded system is read only in fzz_train(...)");
+    if(params != NULL){
+        if(params->flags != 0) flags = params->flags;
+        if(params->epochs > 0) epochs = params->epochs;
+        if(params->rate > 0) rate = params->rate;
+        tolerance = params->tolerance;
+    }
+    memset(&report, 0, sizeof(TFzzTrainStats));
+    memset(&train, 0, sizeof(TTrain));
+    train.sys = sys;
+    train.count = count;
+    train.inputs = inputs;
+    train.targets = targets;
+    
+    //gradient is analytic when all outputs are Sugeno
+    report.analytic = sys->outLen > 0;
+    for(i = 0; i < sys->outLen; i++)
+        if(sys->outSet[i].functions.length == 0) report.analytic = 0;
+    
+    //lookup table and fixed point form are dropped, rules are evaluated
+    fzz_modified(sys);
+    if(pool == NULL) pool = own = fzz_createPool(1);
+    fzz_trainCollect(&train, flags, report.analytic, pool->threads);
+    length = train.first[train.length];
+    report.parameters = length;
+    trial = (double*)fzz_arenaAlloc(&train.arena, sizeof(double)*(length + 1));
+    output = (double*)malloc(sizeof(double)*((size_t)count*sys->outLen + 1));
+    assert(output != NULL && "Memory allocation failed in fzz_train(...)");
+    
+    error = fzz_trainError(&train, pool, output, &valid);
+    report.initialError = valid > 0 ? sqrt(error) : -1;
+    for(; report.epochs < epochs && valid > 0 && sqrt(error) > tolerance; report.epochs++){
+        if(report.analytic) fzz_trainAnalytic(&train, pool);
+        else fzz_trainNumeric(&train, pool, output);
+        
+        //step against gradient, shapes are kept valid
+        changed = 0;
+        for(i = 0; i < length; i++) trial[i] = train.value[i] - rate*train.gradient[i];
+        for(b = 0; b < train.length; b++)
+            if(train.set[b] != NULL) fzz_trainShape(train.set[b]->fSet[train.index[b]].shape, trial + train.first[b]);
+        for(i = 0; i < length; i++)
+            if(trial[i] != train.value[i]) changed = 1;
+        if(!changed) break;
+        for(b = 0; b < train.length; b++) fzz_trainApply(&train, b, trial);
+        fzz_modified(sys);
+        trialError = fzz_trainError(&train, pool, output, &trialValid);
+        
+        //step is taken back when it increased error or lost outputs
+        if(trialValid >= valid && trialError < error){
+            memcpy(train.value, trial, sizeof(double)*length);
+            error = trialError;
+            valid = trialValid;
+            rate *= TRAIN_SPEEDUP;
+            report.accepted++;
+        }else{
+            for(b = 0; b < train.length; b++) fzz_trainApply(&train, b, train.value);
+            fzz_modified(sys);
+            rate *= TRAIN_SLOWDOWN;
+        }
+    }
+    if(report.accepted > 0) fzz_trainText(&train);
+    report.error = valid > 0 ? sqrt(error) : -1;
+    
+    free(output);
+    fzz_arenaFree(&train.arena);
+    if(own != NULL) fzz_destroyPool(own);
+    if(stats != NULL) *stats = report;
+    return report.error;
+}
+
+#ifdef FZZ_OPENCL
+/**
+ * @brief Adds array of model to build options of kernel
+ * Internal function, offset of array is defined as macro of kernel
+ * @param options build options
+ * @param name name of macro
+ * @param length length of all arrays, increased by size
+ * @param size number of items of array
+ * @return offset of array
+ */
+int fzz_gpuArray(char* options, const char* name, int* length, int size){
+    int offset = *length;
+    
+    sprintf(options + strlen(options), " -D %s=%d", name, offset);
+    *length += size;
+    return offset;
+}
+
+/**
+ * @brief Finds device for kernel, GPU is preferred
+ * Internal function, double precision build needs device with cl_khr_fp64
+ * @param device found device (output)
+ * @return 0 on success, -1 if there is no usable device
+ */
+int fzz_gpuDevice(cl_device_id* device){
+    cl_platform_id platforms[16];
+    cl_device_id devices[16];
+    cl_uint platformLen = 0;
+    cl_uint deviceLen = 0;
+    char extensions[4096];
+    int pass = 0;
+    cl_uint i = 0;
+    cl_uint j = 0;
+    
+    if(clGetPlatformIDs(16, platforms, &platformLen) != CL_SUCCESS) return -1;
+    if(platformLen > 16) platformLen = 16;
+    for(pass = 0; pass < 2; pass++){
+        for(i = 0; i < platformLen; i++){
+            if(clGetDeviceIDs(platforms[i], pass == 0 ? CL_DEVICE_TYPE_GPU : CL_DEVICE_TYPE_ALL, 16, devices, &deviceLen) != CL_SUCCESS) continue;
+            if(deviceLen > 16) deviceLen = 16;
+            for(j = 0; j < deviceLen; j++){
+                extensions[0] = '\0';
+                clGetDeviceInfo(devices[j], CL_DEVICE_EXTENSIONS, sizeof(extensions), extensions, NULL);
+                extensions[sizeof(extensions) - 1] = '\0';
+                if(sizeof(TFzzReal) == sizeof(double) && strstr(extensions, "cl_khr_fp64") == NULL) continue;
+                *device = devices[j];
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Writes model of system to arrays of kernel
+ * Internal function, offsets of integer and real arrays are appended 
+ * to build options; fuzzy sets have global indexes (offset of their 
+ * input or output and index), rules are listed by output in order 
+ * of their indexes
+ * @param sys fuzzy system
+ * @param ints integer arrays, NULL to measure only
+ * @param reals real arrays, NULL to measure only
+ * @param options build options (output)
+ * @param intLen number of integers (output)
+ * @param realLen number of reals (output)
+ */
+void fzz_gpuModel(const TFzzSystem* sys, int* ints, TFzzReal* reals, char* options, int* intLen, int* realLen){
+    const TFcnsSet* set = NULL;
+    const TRule* rule = NULL;
+    int inSets = 0;
+    int outSets = 0;
+    int outMax = 1;
+    int conds = 0;
+    int inShape = 0;
+    int inFirst = 0;
+    int outShape = 0;
+    int outFirst = 0;
+    int outMethod = 0;
+    int outRulesFirst = 0;
+    int outRules = 0;
+    int ruleFirst = 0;
+    int ruleConnective = 0;
+    int ruleSet = 0;
+    int condSet = 0;
+    int condNeg = 0;
+    int inPoints = 0;
+    int outPoints = 0;
+    int ruleWeight = 0;
+    int ruleCoefs = 0;
+    int a = 0;
+    int i = 0;
+    int j = 0;
+    
+    for(i = 0; i < sys->inLen; i++) inSets += sys->inSet[i].length;
+    for(i = 0; i < sys->outLen; i++){
+        outSets += sys->outSet[i].length;
+        if(sys->outSet[i].length > outMax) outMax = sys->outSet[i].length;
+    }
+    for(i = 0; i < sys->ruLen; i++) conds += sys->ruleData[i].inLen;
+    
+    //sizes and operators
+    sprintf(options, "-D REAL=%s -D IN_LEN=%d -D OUT_LEN=%d -D IN_SETS=%d -D OUT_MAX=%d -D SAMPLES=%d", 
+            sizeof(TFzzReal) == sizeof(double) ? "double -D FZZ_FP64" : "float", sys->inLen, sys->outLen, 
+            inSets > 0 ? inSets : 1, outMax, GPU_SAMPLES);
+    sprintf(options + strlen(options), " -D AND_OP=%d -D OR_OP=%d -D IMPLICATION=%d -D AGGREGATION=%d", 
+            sys->andOp, sys->orOp, sys->implication, sys->aggregation);
+    
+    //integer arrays
+    *intLen = 0;
+    inShape = fzz_gpuArray(options, "IN_SHAPE", intLen, inSets);
+    inFirst = fzz_gpuArray(options, "IN_FIRST", intLen, sys->inLen + 1);
+    outShape = fzz_gpuArray(options, "OUT_SHAPE", intLen, outSets);
+    outFirst = fzz_gpuArray(options, "OUT_FIRST", intLen, sys->outLen + 1);
+    outMethod = fzz_gpuArray(options, "OUT_METHOD", intLen, sys->outLen);
+    outRulesFirst = fzz_gpuArray(options, "OUT_RULES_FIRST", intLen, sys->outLen + 1);
+    outRules = fzz_gpuArray(options, "OUT_RULES", intLen, sys->ruLen);
+    ruleFirst = fzz_gpuArray(options, "RULE_FIRST", intLen, sys->ruLen + 1);
+    ruleConnective = fzz_gpuArray(options, "RULE_CONNECTIVE", intLen, sys->ruLen);
+    ruleSet = fzz_gpuArray(options, "RULE_SET", intLen, sys->ruLen);
+    condSet = fzz_gpuArray(options, "COND_SET", intLen, conds);
+    condNeg = fzz_gpuArray(options, "COND_NEG", intLen, conds);
+    
+    //real arrays, points and slopes of fuzzy sets as structure of arrays
+    *realLen = 0;
+    inPoints = fzz_gpuArray(options, "IN_LEFT", realLen, inSets);
+    fzz_gpuArray(options, "IN_TOP", realLen, inSets);
+    fzz_gpuArray(options, "IN_TOPEND", realLen, inSets);
+    fzz_gpuArray(options, "IN_RIGHT", realLen, inSets);
+    fzz_gpuArray(options, "IN_KLEFT", realLen, inSets);
+    fzz_gpuArray(options, "IN_KRIGHT", realLen, inSets);
+    outPoints = fzz_gpuArray(options, "OUT_LEFT", realLen, outSets);
+    fzz_gpuArray(options, "OUT_TOP", realLen, outSets);
+    fzz_gpuArray(options, "OUT_TOPEND", realLen, outSets);
+    fzz_gpuArray(options, "OUT_RIGHT", realLen, outSets);
+    fzz_gpuArray(options, "OUT_KLEFT", realLen, outSets);
+    fzz_gpuArray(options, "OUT_KRIGHT", realLen, outSets);
+    ruleWeight = fzz_gpuArray(options, "RULE_WEIGHT", realLen, sys->ruLen);
+    ruleCoefs = fzz_gpuArray(options, "RULE_COEFS", realLen, sys->ruLen*(sys->inLen + 1));
+    if(ints == NULL) return;
+    
+    //input fuzzy sets (with open sides of shoulders)
+    for(i = 0, a = 0; i < sys->inLen; i++){
+        set = &sys->inSet[i];
+        ints[inFirst + i] = a;
+        for(j = 0; j < set->length; j++, a++){
+            ints[inShape + a] = set->fSet[j].shape;
+            reals[inPoints + a] = set->left[j];
+            reals[inPoints + inSets + a] = set->top[j];
+            reals[inPoints + 2*inSets + a] = set->topEnd[j];
+            reals[inPoints + 3*inSets + a] = set->right[j];
+            reals[inPoints + 4*inSets + a] = set->kLeft[j];
+            reals[inPoints + 5*inSets + a] = set->kRight[j];
+        }
+    }
+    ints[inFirst + sys->inLen] = a;
+    
+    //output fuzzy sets, method -1 for Sugeno output
+    for(i = 0, a = 0; i < sys->outLen; i++){
+        set = &sys->outSet[i];
+        ints[outFirst + i] = a;
+        ints[outMethod + i] = set->functions.length > 0 ? -1 : (int)set->defuzz;
+        for(j = 0; j < set->length; j++, a++){
+            ints[outShape + a] = set->fSet[j].shape;
+            reals[outPoints + a] = set->left[j];
+            reals[outPoints + outSets + a] = set->top[j];
+            reals[outPoints + 2*outSets + a] = set->topEnd[j];
+            reals[outPoints + 3*outSets + a] = set->right[j];
+            reals[outPoints + 4*outSets + a] = set->kLeft[j];
+            reals[outPoints + 5*outSets + a] = set->kRight[j];
+        }
+    }
+    ints[outFirst + sys->outLen] = a;
+    
+    //rules of every output
+    for(i = 0, a = 0; i < sys->outLen; i++){
+        ints[outRulesFirst + i] = a;
+        for(j = 0; j < sys->ruLen; j++)
+            if(sys->ruleData[j].output == i) ints[outRules + a++] = j;
+    }
+    ints[outRulesFirst + sys->outLen] = a;
+    
+    //rules, consequent is global index of output fuzzy set or -1 for linear function
+    for(i = 0, a = 0; i < sys->ruLen; i++){
+        rule = &sys->ruleData[i];
+        ints[ruleFirst + i] = a;
+        ints[ruleConnective + i] = rule->connective;
+        ints[ruleSet + i] = rule->coefs != NULL ? -1 : ints[outFirst + rule->output] + rule->outSet;
+        for(j = 0; j < rule->inLen; j++, a++){
+            ints[condSet + a] = ints[inFirst + rule->inputs[j]] + rule->inSets[j];
+            ints[condNeg + a] = rule->negated[j];
+        }
+        reals[ruleWeight + i] = rule->weight;
+        for(j = 0; rule->coefs != NULL && j <= sys->inLen; j++) reals[ruleCoefs + i*(sys->inLen + 1) + j] = rule->coefs[j];
+    }
+    ints[ruleFirst + sys->ruLen] = a;
+}
+
+/**
+ * @brief Checks whether system can be calculated by kernel
+ * Internal function, mean of maxima and singletons of integrating 
+ * methods are not supported
+ * @param sys fuzzy system
+ * @return 1 if system is supported, 0 otherwise
+ */
+int fzz_gpuSupported(const TFzzSystem* sys){
+    const TFcnsSet* set = NULL;
+    int i = 0;
+    int j = 0;
+    
+    if(sys->inLen == 0 || sys->outLen == 0) return 0;
+    for(i = 0; i < sys->outLen; i++){
+        set = &sys->outSet[i];
+        if(set->functions.length > 0 || set->defuzz == FZZ_WEIGHTED_AVERAGE) continue;
+        if(set->defuzz == FZZ_MOM) return 0;
+        for(j = 0; j < set->length; j++)
+            if(set->fSet[j].shape == FZZ_SINGLETON) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Releases OpenCL objects of GPU backend
+ * Internal function, objects which were not created are NULL
+ * @param gpu GPU backend
+ */
+void fzz_gpuRelease(TFzzGpu* gpu){
+    int i = 0;
+    
+    for(i = 0; i < 2; i++){
+        if(gpu->input[i] != NULL) clReleaseMemObject(gpu->input[i]);
+        if(gpu->output[i] != NULL) clReleaseMemObject(gpu->output[i]);
+        if(gpu->queue[i] != NULL) clReleaseCommandQueue(gpu->queue[i]);
+        free(gpu->stageIn[i]);
+        free(gpu->stageOut[i]);
+    }
+    if(gpu->ints != NULL) clReleaseMemObject(gpu->ints);
+    if(gpu->reals != NULL) clReleaseMemObject(gpu->reals);
+    if(gpu->kernel != NULL) clReleaseKernel(gpu->kernel);
+    if(gpu->program != NULL) clReleaseProgram(gpu->program);
+    if(gpu->context != NULL) clReleaseContext(gpu->context);
+}
+
+TFzzGpu* fzz_createGpu(const TFzzSystem* sys){
+    TFzzGpu* gpu = NULL;
+    TFzzReal* reals = NULL;
+    int* ints = NULL;
+    char options[GPU_OPTIONS];
+    cl_int error = CL_SUCCESS;
+    int intLen = 0;
+    int realLen = 0;
+    int i = 0;
+    
+    if(!fzz_gpuSupported(sys)) return NULL;
+    gpu = (TFzzGpu*)calloc(1, sizeof(TFzzGpu));
+    assert(gpu != NULL && "Memory allocation failed in fzz_createGpu(...)");
+    gpu->sys = sys;
+    gpu->revision = sys->revision;
+    if(fzz_gpuDevice(&gpu->device) != 0){
+        free(gpu);
+        return NULL;
+    }
+    
+    //model is uploaded once, kernel is built for its sizes
+    fzz_gpuModel(sys, NULL, NULL, options, &intLen, &realLen);
+    ints = (int*)calloc(intLen + 1, sizeof(int));
+    reals = (TFzzReal*)calloc(realLen + 1, sizeof(TFzzReal));
+    assert(ints != NULL && reals != NULL && "Memory allocation failed in fzz_createGpu(...)");
+    fzz_gpuModel(sys, ints, reals, options, &intLen, &realLen);
+    gpu->context = clCreateContext(NULL, 1, &gpu->device, NULL, NULL, &error);
+    if(error == CL_SUCCESS)
+        gpu->ints = clCreateBuffer(gpu->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*(intLen + 1), ints, &error);
+    if(error == CL_SUCCESS)
+        gpu->reals = clCreateBuffer(gpu->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(TFzzReal)*(realLen + 1), reals, &error);
+    if(error == CL_SUCCESS)
+        gpu->program = clCreateProgramWithSource(gpu->context, 1, &fzzGpuSource, NULL, &error);
+    if(error == CL_SUCCESS)
+        error = clBuildProgram(gpu->program, 1, &gpu->device, options, NULL, NULL);
+    if(error == CL_SUCCESS)
+        gpu->kernel = clCreateKernel(gpu->program, "fzz_batch", &error);
+    free(ints);
+    free(reals);
+    
+    //two sets of buffers, one is transferred while the other one is calculated
+    for(i = 0; i < 2 && error == CL_SUCCESS; i++){
+        gpu->queue[i] = clCreateCommandQueue(gpu->context, gpu->device, 0, &error);
+        if(error == CL_SUCCESS)
+            gpu->input[i] = clCreateBuffer(gpu->context, CL_MEM_READ_ONLY, sizeof(TFzzReal)*GPU_BATCH*sys->inLen, NULL, &error);
+        if(error == CL_SUCCESS)
+            gpu->output[i] = clCreateBuffer(gpu->context, CL_MEM_WRITE_ONLY, sizeof(TFzzReal)*GPU_BATCH*sys->outLen, NULL, &error);
+        gpu->stageIn[i] = (TFzzReal*)malloc(sizeof(TFzzReal)*GPU_BATCH*sys->inLen);
+        gpu->stageOut[i] = (TFzzReal*)malloc(sizeof(TFzzReal)*GPU_BATCH*sys->outLen);
+        assert(gpu->stageIn[i] != NULL && gpu->stageOut[i] != NULL && "Memory allocation failed in fzz_createGpu(...)");
+    }
+    if(error != CL_SUCCESS){
+        fzz_gpuRelease(gpu);
+        free(gpu);
+        return NULL;
+    }
+    return gpu;
+}
+
+void fzz_destroyGpu(TFzzGpu* gpu){
+    if(gpu == NULL) return;
+    fzz_gpuRelease(gpu);
+    free(gpu);
+}
+
+int fzz_calculateBatchGpu(TFzzGpu* gpu, int count, const double* inputs, double* outputs){
+    const TFzzSystem* sys = gpu->sys;
+    cl_event done[2] = {NULL, NULL};
+    size_t global = 0;
+    size_t local = GPU_GROUP;
+    cl_int error = CL_SUCCESS;
+    cl_int n = 0;
+    int chunks = (count + GPU_BATCH - 1) / GPU_BATCH;
+    int chunk = 0;
+    int from = 0;
+    int b = 0;
+    int i = 0;
+    
+    assert(gpu->revision == sys->revision && "System was modified after upload in fzz_calculateBatchGpu(...)");
+    for(chunk = 0; chunk < chunks + 2; chunk++){
+        b = chunk % 2;
+        
+        //results of chunk calculated by this set of buffers before
+        if(done[b] != NULL){
+            from = (chunk - 2)*GPU_BATCH;
+            n = count - from < GPU_BATCH ? count - from : GPU_BATCH;
+            if(clWaitForEvents(1, &done[b]) != CL_SUCCESS) error = -1;
+            clReleaseEvent(done[b]);
+            done[b] = NULL;
+            for(i = 0; i < n*sys->outLen && error == CL_SUCCESS; i++) outputs[(size_t)from*sys->outLen + i] = gpu->stageOut[b][i];
+        }
+        if(chunk >= chunks || error != CL_SUCCESS) continue;
+        
+        //next chunk is transferred and calculated asynchronously
+        from = chunk*GPU_BATCH;
+        n = count - from < GPU_BATCH ? count - from : GPU_BATCH;
+        for(i = 0; i < n*sys->inLen; i++) gpu->stageIn[b][i] = (TFzzReal)inputs[(size_t)from*sys->inLen + i];
+        global = (n + GPU_GROUP - 1) / GPU_GROUP * GPU_GROUP;
+        error = clEnqueueWriteBuffer(gpu->queue[b], gpu->input[b], CL_FALSE, 0, sizeof(TFzzReal)*n*sys->inLen, gpu->stageIn[b], 0, NULL, NULL);
+        if(error == CL_SUCCESS) error = clSetKernelArg(gpu->kernel, 0, sizeof(cl_mem), &gpu->reals);
+        if(error == CL_SUCCESS) error = clSetKernelArg(gpu->kernel, 1, sizeof(cl_mem), &gpu->ints);
+        if(error == CL_SUCCESS) error = clSetKernelArg(gpu->kernel, 2, sizeof(cl_mem), &gpu->input[b]);
+        if(error == CL_SUCCESS) error = clSetKernelArg(gpu->kernel, 3, sizeof(cl_mem), &gpu->output[b]);
+        if(error == CL_SUCCESS) error = clSetKernelArg(gpu->kernel, 4, sizeof(cl_int), &n);
+        if(error == CL_SUCCESS) error = clEnqueueNDRangeKernel(gpu->queue[b], gpu->kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+        if(error == CL_SUCCESS) error = clEnqueueReadBuffer(gpu->queue[b], gpu->output[b], CL_FALSE, 0, sizeof(TFzzReal)*n*sys->outLen, gpu->stageOut[b], 0, NULL, &done[b]);
+        if(error == CL_SUCCESS) error = clFlush(gpu->queue[b]);
+    }
+    
+    //queues are drained after error
+    for(b = 0; b < 2; b++){
+        if(error != CL_SUCCESS) clFinish(gpu->queue[b]);
+        if(done[b] != NULL) clReleaseEvent(done[b]);
+    }
+    return error == CL_SUCCESS ? 0 : -1;
+}
+#else
+TFzzGpu* fzz_createGpu(const TFzzSystem* sys){
+    (void)sys;
+    return NULL;
+}
+
+void fzz_destroyGpu(TFzzGpu* gpu){
+    (void)gpu;
+}
+
+int fzz_calculateBatchGpu(TFzzGpu* gpu, int count, const double* inputs, double* outputs){
+    (void)gpu;
+    (void)count;
+    (void)inputs;
+    (void)outputs;
+    return -1;
+}
+#endif
+
+const char* fzz_simd(){
+    return fzzSimdNames[fzzSimd];
+}
+
+int fzz_setSimd(const char* name){
+    int level = 0;
+    
+    assert(name != NULL && "Null name in fzz_setSimd(...)");
+    
+    for(level = 0; fzzSimdNames[level] != NULL; level++)
+        if(strcmp(fzzSimdNames[level], name) == 0) break;
+    if(fzzSimdNames[level] == NULL) return -1;
+    
+    //dispatched build has every version up to the best one
+    #ifdef FZZ_SIMD_DISPATCH
+    if(level != SIMD_NONE && (level < SIMD_SSE2 || level > fzzSimdBest)) return -1;
+    #else
+    if(level != SIMD_NONE && level != fzzSimdBest) return -1;
+    #endif
+    fzzSimd = level;
+    return 0;
+}
+
+///////////////////////////////////////////////////
+//////// Main functions ///////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Releases default fuzzy system
+ * Internal function
+ */
+void fzz_releaseDefault(){
+    if(fzzSystem != NULL) fzz_destroy(fzzSystem);
+    if(fzzContext != NULL) fzz_destroyContext(fzzContext);
+    free(fzzInput);
+    free(fzzOutput);
+    fzzSystem = NULL;
+    fzzContext = NULL;
+    fzzInput = NULL;
+    fzzOutput = NULL;
+}
+
+/**
+ * @brief Returns context of default fuzzy system
+ * Internal function, context is created again when system was modified
+ * @return context of current revision of default system
+ */
+TFzzContext* fzz_defaultContext(){
+    TFzzContext* ctx = NULL;
+    
+    if(fzzContext != NULL && fzzContext->revision == fzzSystem->revision) return fzzContext;
+    ctx = fzz_createContext(fzzSystem);
+    fzz_setStatsEx(ctx, fzzStatsFlags, fzzTraceLength);
+    
+    //statistics are kept when context is created again
+    if(fzzContext != NULL){
+        ctx->stats = fzzContext->stats;
+        fzz_destroyContext(fzzContext);
+    }
+    fzzContext = ctx;
+    return fzzContext;
+}
+
+void fzz_init(int inputs, int outputs){
+    //previous default system is replaced
+    fzz_releaseDefault();
+    fzzSystem = fzz_create(inputs, outputs);
+    
+    //arrays for storing system inputs and output
+    fzzInput = (double*)calloc(inputs, sizeof(double));
+    fzzOutput = (double*)calloc(outputs, sizeof(double));
+    assert(fzzInput != NULL && fzzOutput != NULL && "Memory allocation failed in fzz_init(...)");
+}
+
+void fzz_deinit(){
+    //default system and pool release
+    fzz_releaseDefault();
+    if(fzzPool != NULL) fzz_destroyPool(fzzPool);
+    fzzPool = NULL;
+}
+    
+void fzz_initInputFcns(int index, int length, const char* name){
+    fzz_initInputFcnsEx(fzzSystem, index, length, name);
+}
+
+void fzz_initOutputFcns(int index, int length, const char* name){
+    fzz_initOutputFcnsEx(fzzSystem, index, length, name);
+}
+
+void fzz_setInputFcn(int index, int fcSet, double left, double top, double right, const char* name){
+    fzz_setInputFcnEx(fzzSystem, index, fcSet, left, top, right, name);
+}
+
+void fzz_setOutputFcn(int index, int fcSet, double left, double top, double right, const char* name){
+    fzz_setOutputFcnEx(fzzSystem, index, fcSet, left, top, right, name);
+}
+
+void fzz_setInputShape(int index, int fcSet, TFzzShape shape, const double* params, const char* name){
+    fzz_setInputShapeEx(fzzSystem, index, fcSet, shape, params, name);
+}
+
+void fzz_setOutputShape(int index, int fcSet, TFzzShape shape, const double* params, const char* name){
+    fzz_setOutputShapeEx(fzzSystem, index, fcSet, shape, params, name);
+}
+
+void fzz_setDefuzzMethod(int output, TDefuzzMethod method){
+    fzz_setDefuzzMethodEx(fzzSystem, output, method);
+}
+
+void fzz_setOperators(TFzzOperator andOp, TFzzOperator orOp, TFzzOperator implication, TFzzOperator aggregation){
+    fzz_setOperatorsEx(fzzSystem, andOp, orOp, implication, aggregation);
+}
+
+void fzz_setRealtime(int samples){
+    fzz_setRealtimeEx(fzzSystem, samples);
+}
+
+long long fzz_worstCase(TFzzWorstCase* report){
+    return fzz_worstCaseEx(fzzSystem, report);
+}
+
+double fzz_optimizeRules(TFzzOptimizeStats* stats){
+    return fzz_optimizeRulesEx(fzzSystem, stats);
+}
+
+double fzz_train(int count, const double* inputs, const double* targets, const TFzzTrainParams* params, TFzzTrainStats* stats){
+    if(fzzThreads == 1) return fzz_trainEx(fzzSystem, NULL, count, inputs, targets, params, stats);
+    if(fzzPool == NULL) fzzPool = fzz_createPool(fzzThreads);
+    return fzz_trainEx(fzzSystem, fzzPool, count, inputs, targets, params, stats);
+}
+
+void fzz_addRule(const char* rule){
+    fzz_addRuleEx(fzzSystem, rule);
+}
+
+void fzz_setInput(int index, double value){
+    assert(index < fzzSystem->inLen && "Index out of range in fzz_setInput(...)");
+    fzzInput[index] = value;
+}
+
+double fzz_getOutput(int index){
+    assert(index < fzzSystem->outLen && "Index out of range in fzz_getOutput(...)");
+    return fzzOutput[index];
+}
+
+void fzz_calculateOutput(){
+    fzz_updateOutputEx(fzzSystem, fzz_defaultContext(), fzzInput, fzzOutput);
+}
+
+void fzz_calculateOutputFor(int index){
+    assert(index < fzzSystem->outLen && "Index out of range in fzz_calculateOutputFor(...)");
+    fzzOutput[index] = fzz_calculateOutputForEx(fzzSystem, fzz_defaultContext(), fzzInput, index);
+}
+
+void fzz_calculateBatch(int count, const double* inputs, double* outputs){
+    if(fzzThreads == 1){
+        fzz_calculateBatchEx(fzzSystem, fzz_defaultContext(), count, inputs, outputs);
+        return;
+    }
+    if(fzzPool == NULL) fzzPool = fzz_createPool(fzzThreads);
+    fzz_calculateBatchPoolEx(fzzSystem, fzzPool, count, inputs, outputs);
+}
+
+void fzz_setThreads(int threads){
+    //pool is created again with new number of threads
+    if(fzzPool != NULL) fzz_destroyPool(fzzPool);
+    fzzPool = NULL;
+    fzzThreads = threads;
+}
+
+double fzz_bake(int resolution){
+    return fzz_bakeEx(fzzSystem, resolution);
+}
+
+void fzz_unbake(){
+    fzz_unbakeEx(fzzSystem);
+}
+
+double fzz_compileFixed(){
+    return fzz_compileFixedEx(fzzSystem);
+}
+
+void fzz_calculateFixed(const short* input, short* output){
+    fzz_calculateFixedEx(fzzSystem, fzz_defaultContext(), input, output);
+}
+
+short fzz_inputToFixed(int index, double value){
+    return fzz_inputToFixedEx(fzzSystem, index, value);
+}
+
+double fzz_outputFromFixed(int index, short value){
+    return fzz_outputFromFixedEx(fzzSystem, index, value);
+}
+
+void fzz_setStats(int flags, int traceLength){
+    fzzStatsFlags = flags;
+    fzzTraceLength = traceLength;
+    fzz_setStatsEx(fzz_defaultContext(), flags, traceLength);
+}
+
+void fzz_getStats(TFzzStats* stats){
+    fzz_getStatsEx(fzz_defaultContext(), stats);
+}
+
+void fzz_resetStats(){
+    fzz_resetStatsEx(fzz_defaultContext());
+}
+
+///////////////////////////////////////////////////
+//////// Support functions ////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Prints corners of fuzzy set (center and sigma of Gaussian set)
+ * Internal function
+ * @param index index of fuzzy set
+ * @param fs fuzzy set
+ */
+void fzz_printFuzzySet(int index, const TFuzzySet* fs){
+    printf("Fuzzy set %d named \"%s\": ", index, fs->name);
+    switch(fs->shape){
+        case FZZ_TRIANGLE:
+            printf("[%f,0],[%f,1],[%f,0]\n", fs->left, fs->top, fs->right);
+            break;
+        case FZZ_GAUSSIAN:
+            printf("gaussian center %f sigma %f\n", fs->top, (fs->right - fs->top)/GAUSS_CUT);
+            break;
+        case FZZ_SINGLETON:
+            printf("singleton [%f,1]\n", fs->top);
+            break;
+        case FZZ_LEFT_SHOULDER:
+            printf("left_shoulder [%f,1],[%f,1],[%f,0]\n", fs->left, fs->topEnd, fs->right);
+            break;
+        case FZZ_RIGHT_SHOULDER:
+            printf("right_shoulder [%f,0],[%f,1],[%f,1]\n", fs->left, fs->top, fs->right);
+            break;
+        default:
+            printf("trapezoid [%f,0],[%f,1],[%f,1],[%f,0]\n", fs->left, fs->top, fs->topEnd, fs->right);
+            break;
+    }
+}
+
+void fzz_printInputSetEx(const TFzzSystem* sys, int index){
+    int i = 0;
+    
+    //index check
+    assert(index < sys->inLen && "Index out of range in fzz_printInputSet(...)");
+    
+    //header
+    printf("Input set for input %d named \"%s\":\n", index, sys->inSet[index].name);
+    
+    //fuzzy sets
+    for(i = 0; i < sys->inSet[index].length; i++){
+        fzz_printFuzzySet(i, &sys->inSet[index].fSet[i]);
+    }
+}
+
+void fzz_printOutputSetEx(const TFzzSystem* sys, int index){
+    int i = 0;
+    
+    //index check
+    assert(index < sys->outLen && "Index out of range in fzz_printOutputSet(...)");
+    
+    //header
+    printf("Output set for output %d named \"%s\":\n", index, sys->outSet[index].name);
+    
+    //fuzzy sets
+    for(i = 0; i < sys->outSet[index].length; i++){
+        fzz_printFuzzySet(i, &sys->outSet[index].fSet[i]);
+    }  
+}
+
+void fzz_printRulesEx(const TFzzSystem* sys){
+    int i = 0;
+    
+    //header
+    printf("System contains %d rules of inferential mechanism:\n", sys->ruLen);
+    
+    //rules
+    for(i = 0; i < sys->ruLen; i++){
+        printf("%3d: %s\n", i, sys->rule[i]);
+    }
+}
+
+void fzz_printSystemEx(const TFzzSystem* sys){
+    int i = 0;
+    
+    printf("\n");
+    printf("+----------------------------------------+\n");
+    printf("|              Fuzzy system              |\n");
+    printf("+----------------------------------------+\n\n");
+
+    //input sets
+    for(i = 0; i < sys->inLen; i++){
+        fzz_printInputSetEx(sys, i);
+        printf("\n");
+    }
+    
+    //output sets
+    for(i = 0; i < sys->outLen; i++){
+        fzz_printOutputSetEx(sys, i);
+        printf("\n");
+    }
+    
     //system rules
-    fzz_printRules();
+    fzz_printRulesEx(sys);
+}
+
+void fzz_printTraceEx(const TFzzContext* ctx){
+    const TTrace* trace = &ctx->trace;
+    const TFzzReal* record = NULL;
+    int stride = ctx->sys->inLen + ctx->sys->outLen;
+    int records = trace->count < (unsigned long long)trace->length ? (int)trace->count : trace->length;
+    int first = records < trace->length ? 0 : trace->next;
+    int i = 0;
+    int j = 0;
+    
+    //header
+    printf("Trace contains %d of %llu calculations:\n", records, trace->count);
+    
+    //calculations from the oldest one
+    for(i = 0; i < records; i++){
+        record = trace->values + ((first + i) % trace->length)*stride;
+        printf("%3llu: fired %d, %lld ns, inputs", trace->count - records + i, trace->fired[(first + i) % trace->length], trace->ns[(first + i) % trace->length]);
+        for(j = 0; j < ctx->sys->inLen; j++) printf(" %f", record[j]);
+        printf(", outputs");
+        for(j = 0; j < ctx->sys->outLen; j++) printf(" %f", record[ctx->sys->inLen + j]);
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Updates checksum (FNV-1a) by given data
+ * Internal function
+ * @param hash checksum of previous data
+ * @param data added data
+ * @param bytes size of added data
+ * @return updated checksum
+ */
+unsigned int fzz_checksum(unsigned int hash, const void* data, size_t bytes){
+    const unsigned char* byte = (const unsigned char*)data;
+    size_t i = 0;
+    for(i = 0; i < bytes; i++){
+        hash ^= byte[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Writes data to saved fuzzy system file
+ * Internal function
+ * @param w file writer
+ * @param data written data
+ * @param bytes size of data
+ */
+void fzz_fileWrite(TFileWriter* w, const void* data, size_t bytes){
+    if(bytes == 0) return;
+    if(fwrite(data, 1, bytes, w->file) != bytes) w->error = 1;
+    w->checksum = fzz_checksum(w->checksum, data, bytes);
+    w->offset += bytes;
+}
+
+/**
+ * @brief Pads saved fuzzy system file to ARENA_ALIGN, 
+ * has to be called before every data section
+ * Internal function
+ * @param w file writer
+ */
+void fzz_fileWriteAlign(TFileWriter* w){
+    static const char zeros[ARENA_ALIGN] = {0};
+    fzz_fileWrite(w, zeros, (ARENA_ALIGN - w->offset % ARENA_ALIGN) % ARENA_ALIGN);
+}
+
+/**
+ * @brief Takes data from loaded fuzzy system file
+ * Internal function
+ * @param r file reader
+ * @param bytes size of data
+ * @return pointer to data in file memory, NULL if file is too short
+ */
+void* fzz_fileRead(TFileReader* r, size_t bytes){
+    void* data = NULL;
+    if(r->offset > r->size || bytes > r->size - r->offset) return NULL;
+    data = r->data + r->offset;
+    r->offset += bytes;
+    return data;
+}
+
+/**
+ * @brief Takes string from loaded fuzzy system file
+ * Internal function
+ * @param r file reader
+ * @return pointer to string in file memory, NULL if it is not terminated
+ */
+const char* fzz_fileReadName(TFileReader* r){
+    const char* name = NULL;
+    const char* end = NULL;
+    if(r->offset >= r->size) return NULL;
+    name = r->data + r->offset;
+    end = (const char*)memchr(name, '\0', r->size - r->offset);
+    if(end == NULL) return NULL;
+    r->offset += end - name + 1;
+    return name;
+}
+
+/**
+ * @brief Skips padding of loaded fuzzy system file
+ * @see fzz_fileWriteAlign
+ * Internal function
+ * @param r file reader
+ */
+void fzz_fileReadAlign(TFileReader* r){
+    r->offset += (ARENA_ALIGN - r->offset % ARENA_ALIGN) % ARENA_ALIGN;
+}
+
+/**
+ * @brief Writes fuzzy sets of set of fuzzy sets to file
+ * Internal function
+ * @param w file writer
+ * @param set set of fuzzy sets
+ */
+void fzz_saveFcns(TFileWriter* w, const TFcnsSet* set){
+    TFileSet fs;
+    int i = 0;
+    
+    //membership functions
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->left, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->top, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->topEnd, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->right, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->kLeft, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileWriteAlign(w);
+    fzz_fileWrite(w, set->kRight, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    
+    //shapes of fuzzy sets (structure of arrays has open sides of input shoulders)
+    fzz_fileWriteAlign(w);
+    for(i = 0; i < set->length; i++){
+        memset(&fs, 0, sizeof(TFileSet));
+        fs.left = set->fSet[i].left;
+        fs.top = set->fSet[i].top;
+        fs.topEnd = set->fSet[i].topEnd;
+        fs.right = set->fSet[i].right;
+        fs.shape = set->fSet[i].shape;
+        fzz_fileWrite(w, &fs, sizeof(TFileSet));
+    }
+    
+    //rule index, lengths of lists followed by all lists
+    fzz_fileWriteAlign(w);
+    for(i = 0; i < set->length; i++)
+        fzz_fileWrite(w, &set->rules[i].length, sizeof(int));
+    fzz_fileWriteAlign(w);
+    for(i = 0; i < set->length; i++)
+        fzz_fileWrite(w, set->rules[i].rule, sizeof(int)*set->rules[i].length);
+}
+
+/**
+ * @brief Sets fuzzy sets of set of fuzzy sets to data of loaded file
+ * Internal function
+ * @param r file reader
+ * @param sys loaded fuzzy system
+ * @param set set of fuzzy sets
+ * @param saved saved set of fuzzy sets
+ * @param names reader of section of names
+ * @return 0 on success, -1 if file is invalid
+ */
+int fzz_loadFcns(TFileReader* r, TFzzSystem* sys, TFcnsSet* set, const TFileFcns* saved, TFileReader* names){
+    const TFileSet* sets = NULL;
+    const int* lengths = NULL;
+    int i = 0;
+    int j = 0;
+    
+    //set of fuzzy sets, each fuzzy set is saved in file
+    if(saved->length < 0 || (size_t)saved->length > r->size / sizeof(TFileSet)) return -1;
+    if(saved->defuzz < FZZ_COG_STEP || saved->defuzz > FZZ_WEIGHTED_AVERAGE) return -1;
+    set->length = saved->length;
+    set->name = fzz_fileReadName(names);
+    set->defuzz = (TDefuzzMethod)saved->defuzz;
+    if(set->name == NULL) return -1;
+    
+    //membership functions
+    fzz_fileReadAlign(r);
+    set->left = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileReadAlign(r);
+    set->top = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileReadAlign(r);
+    set->topEnd = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileReadAlign(r);
+    set->right = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileReadAlign(r);
+    set->kLeft = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    fzz_fileReadAlign(r);
+    set->kRight = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*FSETS_PAD(set->length));
+    if(set->left == NULL || set->top == NULL || set->topEnd == NULL || set->right == NULL) return -1;
+    if(set->kLeft == NULL || set->kRight == NULL) return -1;
+    fzz_fileReadAlign(r);
+    sets = (const TFileSet*)fzz_fileRead(r, sizeof(TFileSet)*set->length);
+    if(sets == NULL) return -1;
+    
+    //fuzzy sets are small descriptors
+    set->fSet = (TFuzzySet*)fzz_arenaAlloc(&sys->arena, sizeof(TFuzzySet)*set->length);
+    set->curved = 0;
+    for(i = 0; i < set->length; i++){
+        if(sets[i].shape < FZZ_TRIANGLE || sets[i].shape > FZZ_SINGLETON) return -1;
+        set->fSet[i].left = sets[i].left;
+        set->fSet[i].top = sets[i].top;
+        set->fSet[i].topEnd = sets[i].topEnd;
+        set->fSet[i].right = sets[i].right;
+        set->fSet[i].shape = sets[i].shape;
+        if(sets[i].shape == FZZ_GAUSSIAN || sets[i].shape == FZZ_SINGLETON) set->curved = 1;
+        set->fSet[i].name = fzz_fileReadName(names);
+        if(set->fSet[i].name == NULL) return -1;
+    }
+    fzz_detectPartition(set);
+    
+    //rule index, lists point to file memory
+    fzz_fileReadAlign(r);
+    lengths = (const int*)fzz_fileRead(r, sizeof(int)*set->length);
+    if(lengths == NULL) return -1;
+    set->rules = (TRuleList*)fzz_arenaAlloc(&sys->arena, sizeof(TRuleList)*set->length);
+    fzz_fileReadAlign(r);
+    for(i = 0; i < set->length; i++){
+        if(lengths[i] < 0) return -1;
+        set->rules[i].rule = (int*)fzz_fileRead(r, sizeof(int)*lengths[i]);
+        set->rules[i].length = lengths[i];
+        set->rules[i].capacity = lengths[i];
+        if(set->rules[i].rule == NULL) return -1;
+        for(j = 0; j < lengths[i]; j++)
+            if(set->rules[i].rule[j] < 0 || set->rules[i].rule[j] >= sys->ruLen) return -1;
+    }
+    return 0;
+}
+
+int fzz_saveSystemEx(const TFzzSystem* sys, const char* file){
+    TFileWriter w = {NULL, 0, 2166136261u, 0};
+    TFileHeader header;
+    TFileFcns fcns;
+    TFileRule rule;
+    const TFcnsSet* set = NULL;
+    int points = 1;
+    int i = 0;
+    int j = 0;
+    
+    //rules waiting for names of fuzzy sets can not be saved
+    if(sys->pendingLen > 0) return -1;
+    
+    //header, checksum and size are written when file is complete
+    memset(&header, 0, sizeof(TFileHeader));
+    memcpy(header.magic, FILE_MAGIC, 4);
+    header.version = FILE_VERSION;
+    header.byteOrder = FILE_BYTE_ORDER;
+    header.realSize = sizeof(TFzzReal);
+    header.inLen = sys->inLen;
+    header.outLen = sys->outLen;
+    header.ruLen = sys->ruLen;
+    for(i = 0; i < sys->ruLen; i++) header.antecedents += sys->ruleData[i].inLen;
+    header.andOp = sys->andOp;
+    header.orOp = sys->orOp;
+    header.implication = sys->implication;
+    header.aggregation = sys->aggregation;
+    header.samples = sys->samples;
+    header.lutRes = sys->lut.table != NULL ? sys->lut.res : 0;
+    w.file = fopen(file, "wb");
+    if(w.file == NULL) return -1;
+    if(fwrite(&header, sizeof(TFileHeader), 1, w.file) != 1) w.error = 1;
+    w.offset = sizeof(TFileHeader);
+    
+    //sets of fuzzy sets
+    for(i = 0; i < sys->inLen + sys->outLen; i++){
+        set = i < sys->inLen ? &sys->inSet[i] : &sys->outSet[i - sys->inLen];
+        fcns.length = set->length;
+        fcns.defuzz = set->defuzz;
+        fzz_fileWrite(&w, &fcns, sizeof(TFileFcns));
+    }
+    
+    //names of sets of fuzzy sets, each followed by names of its fuzzy sets
+    fzz_fileWriteAlign(&w);
+    header.namesSize = (unsigned int)w.offset;
+    for(i = 0; i < sys->inLen + sys->outLen; i++){
+        set = i < sys->inLen ? &sys->inSet[i] : &sys->outSet[i - sys->inLen];
+        fzz_fileWrite(&w, set->name, strlen(set->name) + 1);
+        for(j = 0; j < set->length; j++)
+            fzz_fileWrite(&w, set->fSet[j].name, strlen(set->fSet[j].name) + 1);
+    }
+    header.namesSize = (unsigned int)w.offset - header.namesSize;
+    for(i = 0; i < sys->inLen; i++) fzz_saveFcns(&w, &sys->inSet[i]);
+    for(i = 0; i < sys->outLen; i++) fzz_saveFcns(&w, &sys->outSet[i]);
+    
+    //compiled rules, conditions and texts of all rules
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++){
+        rule.inLen = sys->ruleData[i].inLen;
+        rule.connective = sys->ruleData[i].connective;
+        rule.output = sys->ruleData[i].output;
+        rule.outSet = sys->ruleData[i].outSet;
+        rule.textLength = (int)strlen(sys->rule[i]);
+        fzz_fileWrite(&w, &rule, sizeof(TFileRule));
+    }
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        fzz_fileWrite(&w, sys->ruleData[i].inputs, sizeof(int)*sys->ruleData[i].inLen);
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        fzz_fileWrite(&w, sys->ruleData[i].inSets, sizeof(int)*sys->ruleData[i].inLen);
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        fzz_fileWrite(&w, sys->ruleData[i].negated, sizeof(int)*sys->ruleData[i].inLen);
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        fzz_fileWrite(&w, sys->rule[i], strlen(sys->rule[i]) + 1);
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        fzz_fileWrite(&w, &sys->ruleData[i].weight, sizeof(TFzzReal));
+    
+    //coefficients of linear functions in consequents
+    fzz_fileWriteAlign(&w);
+    for(i = 0; i < sys->ruLen; i++)
+        if(sys->ruleData[i].coefs != NULL)
+            fzz_fileWrite(&w, sys->ruleData[i].coefs, sizeof(TFzzReal)*(sys->inLen + 1));
+    
+    //lookup table of baked system
+    if(header.lutRes > 0){
+        for(i = 0; i < sys->inLen; i++) points *= sys->lut.res;
+        fzz_fileWriteAlign(&w);
+        fzz_fileWrite(&w, sys->lut.from, sizeof(TFzzReal)*sys->inLen);
+        fzz_fileWriteAlign(&w);
+        fzz_fileWrite(&w, sys->lut.step, sizeof(TFzzReal)*sys->inLen);
+        fzz_fileWriteAlign(&w);
+        fzz_fileWrite(&w, sys->lut.stride, sizeof(int)*sys->inLen);
+        fzz_fileWriteAlign(&w);
+        fzz_fileWrite(&w, sys->lut.table, sizeof(TFzzReal)*points*sys->outLen);
+    }
+    
+    //completed header
+    header.size = w.offset;
+    header.checksum = fzz_checksum(w.checksum, &header, sizeof(TFileHeader));
+    if(fseek(w.file, 0, SEEK_SET) != 0) w.error = 1;
+    if(fwrite(&header, sizeof(TFileHeader), 1, w.file) != 1) w.error = 1;
+    if(fclose(w.file) != 0) w.error = 1;
+    return w.error ? -1 : 0;
+}
+
+/**
+ * @brief Sets fuzzy system to data of loaded file
+ * Internal function, only small descriptors are allocated, all 
+ * other data point to file memory
+ * @param r file reader
+ * @param sys loaded fuzzy system
+ * @param header header of loaded file
+ * @return 0 on success, -1 if file is invalid
+ */
+int fzz_loadData(TFileReader* r, TFzzSystem* sys, const TFileHeader* header){
+    TFileReader names = {NULL, 0, 0};
+    const TFileFcns* fcns = NULL;
+    const TFileRule* rules = NULL;
+    int* inputs = NULL;
+    int* inSets = NULL;
+    int* negated = NULL;
+    char* text = NULL;
+    const TFzzReal* weights = NULL;
+    TFzzReal* coefs = NULL;
+    size_t textSize = 0;
+    int functions = 0;
+    int points = 1;
+    int cond = 0;
+    int i = 0;
+    int j = 0;
+    
+    //sets of fuzzy sets
+    fcns = (const TFileFcns*)fzz_fileRead(r, sizeof(TFileFcns)*(sys->inLen + sys->outLen));
+    fzz_fileReadAlign(r);
+    names.data = (char*)fzz_fileRead(r, header->namesSize);
+    names.size = header->namesSize;
+    if(fcns == NULL || names.data == NULL) return -1;
+    for(i = 0; i < sys->inLen; i++)
+        if(fzz_loadFcns(r, sys, &sys->inSet[i], &fcns[i], &names) != 0) return -1;
+    for(i = 0; i < sys->outLen; i++)
+        if(fzz_loadFcns(r, sys, &sys->outSet[i], &fcns[sys->inLen + i], &names) != 0) return -1;
+    
+    //compiled rules point to common sections of conditions and texts
+    fzz_fileReadAlign(r);
+    rules = (const TFileRule*)fzz_fileRead(r, sizeof(TFileRule)*sys->ruLen);
+    fzz_fileReadAlign(r);
+    inputs = (int*)fzz_fileRead(r, sizeof(int)*header->antecedents);
+    fzz_fileReadAlign(r);
+    inSets = (int*)fzz_fileRead(r, sizeof(int)*header->antecedents);
+    fzz_fileReadAlign(r);
+    negated = (int*)fzz_fileRead(r, sizeof(int)*header->antecedents);
+    if(rules == NULL || inputs == NULL || inSets == NULL || negated == NULL) return -1;
+    for(i = 0; i < sys->ruLen; i++){
+        if(rules[i].textLength < 0) return -1;
+        textSize += (size_t)rules[i].textLength + 1;
+        if(rules[i].outSet == -1) functions++;
+    }
+    fzz_fileReadAlign(r);
+    text = (char*)fzz_fileRead(r, textSize);
+    fzz_fileReadAlign(r);
+    weights = (const TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*sys->ruLen);
+    fzz_fileReadAlign(r);
+    coefs = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*(sys->inLen + 1)*functions);
+    if(text == NULL || weights == NULL || coefs == NULL) return -1;
+    sys->rule = (char**)fzz_arenaAlloc(&sys->arena, sizeof(char*)*sys->ruLen);
+    sys->ruleData = (TRule*)fzz_arenaAlloc(&sys->arena, sizeof(TRule)*sys->ruLen);
+    for(i = 0; i < sys->ruLen; i++){
+        if(rules[i].inLen < 0 || rules[i].inLen > header->antecedents - cond) return -1;
+        if(rules[i].output < 0 || rules[i].output >= sys->outLen) return -1;
+        if(rules[i].outSet < -1 || rules[i].outSet >= sys->outSet[rules[i].output].length) return -1;
+        if(rules[i].connective != CONNECTIVE_AND && rules[i].connective != CONNECTIVE_OR) return -1;
+        if(!(weights[i] > 0 && weights[i] <= 1)) return -1;
+        for(j = cond; j < cond + rules[i].inLen; j++){
+            if(inputs[j] < 0 || inputs[j] >= sys->inLen) return -1;
+            if(inSets[j] < 0 || inSets[j] >= sys->inSet[inputs[j]].length) return -1;
+            //lists of rules with negated conditions are not saved
+            if(negated[j] != 0 && negated[j] != 1) return -1;
+            if(negated[j]) fzz_ruleListPush(sys, &sys->inSet[inputs[j]].negated, i);
+        }
+        if(text[rules[i].textLength] != '\0') return -1;
+        sys->ruleData[i].inputs = inputs + cond;
+        sys->ruleData[i].inSets = inSets + cond;
+        sys->ruleData[i].negated = negated + cond;
+        sys->ruleData[i].inLen = rules[i].inLen;
+        sys->ruleData[i].connective = rules[i].connective;
+        sys->ruleData[i].weight = weights[i];
+        sys->ruleData[i].output = rules[i].output;
+        sys->ruleData[i].outSet = rules[i].outSet;
+        sys->ruleData[i].coefs = NULL;
+        sys->rule[i] = text;
+        if(rules[i].outSet == -1){
+            //list of rules with linear functions is not saved
+            sys->ruleData[i].coefs = coefs;
+            coefs += sys->inLen + 1;
+            fzz_ruleListPush(sys, &sys->outSet[rules[i].output].functions, i);
+        }
+        fzz_ruleKind(sys, &sys->ruleData[i]);
+        cond += rules[i].inLen;
+        text += rules[i].textLength + 1;
+    }
+    
+    //lookup table of baked system
+    if(header->lutRes > 0){
+        fzz_fileReadAlign(r);
+        sys->lut.from = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*sys->inLen);
+        fzz_fileReadAlign(r);
+        sys->lut.step = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*sys->inLen);
+        fzz_fileReadAlign(r);
+        sys->lut.stride = (int*)fzz_fileRead(r, sizeof(int)*sys->inLen);
+        if(sys->lut.from == NULL || sys->lut.step == NULL || sys->lut.stride == NULL) return -1;
+        for(i = 0; i < sys->inLen; i++){
+            if(!isfinite(sys->lut.from[i]) || !isfinite(sys->lut.step[i]) || !(sys->lut.step[i] > 0)) return -1;
+            if(sys->lut.stride[i] != points) return -1;
+            if(points > (int)(r->size / sizeof(TFzzReal)) / header->lutRes) return -1;
+            points *= header->lutRes;
+        }
+        fzz_fileReadAlign(r);
+        sys->lut.table = (TFzzReal*)fzz_fileRead(r, sizeof(TFzzReal)*points*sys->outLen);
+        sys->lut.res = header->lutRes;
+        if(sys->lut.table == NULL) return -1;
+    }
+    return 0;
+}
+
+TFzzSystem* fzz_loadSystemEx(const char* file){
+    TFileReader r = {NULL, 0, 0};
+    TFzzSystem* sys = NULL;
+    const TFileHeader* header = NULL;
+    TFileHeader copy;
+    unsigned int checksum = 0;
+    #ifdef FZZ_MMAP
+    struct stat st;
+    int fd = -1;
+    #else
+    FILE* f = NULL;
+    long size = 0;
+    #endif
+    
+    //file memory, mapped where available
+    #ifdef FZZ_MMAP
+    fd = open(file, O_RDONLY);
+    if(fd < 0) return NULL;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TFileHeader)){
+        close(fd);
+        return NULL;
+    }
+    r.size = (size_t)st.st_size;
+    r.data = (char*)mmap(NULL, r.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(r.data == (char*)MAP_FAILED) return NULL;
+    #else
+    f = fopen(file, "rb");
+    if(f == NULL) return NULL;
+    if(fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    rewind(f);
+    if(size >= (long)sizeof(TFileHeader)) r.data = (char*)malloc(size);
+    if(r.data != NULL && fread(r.data, 1, size, f) != (size_t)size){
+        free(r.data);
+        r.data = NULL;
+    }
+    fclose(f);
+    if(r.data == NULL) return NULL;
+    r.size = (size_t)size;
+    #endif
+    
+    //header check, checksum covers data and header with zero checksum;
+    //every input, output, rule and condition has its record in file, 
+    //so counts are bounded by size of file before system is allocated
+    header = (const TFileHeader*)fzz_fileRead(&r, sizeof(TFileHeader));
+    memcpy(&copy, header, sizeof(TFileHeader));
+    copy.checksum = 0;
+    checksum = fzz_checksum(fzz_checksum(2166136261u, r.data + r.offset, r.size - r.offset), &copy, sizeof(TFileHeader));
+    if(memcmp(header->magic, FILE_MAGIC, 4) != 0 || header->version != FILE_VERSION ||
+       header->byteOrder != FILE_BYTE_ORDER || header->realSize != sizeof(TFzzReal) || header->size != r.size ||
+       header->checksum != checksum ||
+       header->inLen <= 0 || header->outLen <= 0 || header->ruLen < 0 || header->antecedents < 0 ||
+       (size_t)header->inLen + (size_t)header->outLen > r.size / sizeof(TFileFcns) ||
+       (size_t)header->ruLen > r.size / sizeof(TFileRule) ||
+       (size_t)header->antecedents > r.size / (3*sizeof(int)) ||
+       header->lutRes < 0 || header->lutRes == 1 || header->samples < 0 || header->samples == 1 ||
+       !fzz_validOperators(header->andOp, header->orOp, header->implication, header->aggregation)){
+        fzz_fileRelease(r.data, r.size);
+        return NULL;
+    }
+    
+    //system owns file memory from now, it is released with system
+    sys = fzz_create(header->inLen, header->outLen);
+    sys->mapping = r.data;
+    sys->mappingSize = r.size;
+    sys->ruLen = header->ruLen;
+    sys->ruCapacity = header->ruLen;
+    sys->andOp = header->andOp;
+    sys->orOp = header->orOp;
+    sys->implication = header->implication;
+    sys->aggregation = header->aggregation;
+    sys->samples = header->samples;
+    if(fzz_loadData(&r, sys, header) != 0){
+        fzz_destroy(sys);
+        return NULL;
+    }
+    return sys;
+}
+
+/**
+ * @brief Takes next word from line of model
+ * Internal function, word is terminated in line
+ * @param text current position in line, moved behind the word
+ * @return word, NULL if there are no more words
+ */
+char* fzz_modelWord(char** text){
+    char* word = *text;
+    
+    //words are separated by white characters
+    while(*word == ' ' || *word == '\t' || *word == '\r') word++;
+    if(*word == '\0'){
+        *text = word;
+        return NULL;
+    }
+    *text = word;
+    while(**text != '\0' && **text != ' ' && **text != '\t' && **text != '\r') (*text)++;
+    if(**text != '\0'){
+        **text = '\0';
+        (*text)++;
+    }
+    return word;
+}
+
+/**
+ * @brief Converts word of model to number
+ * Internal function
+ * @param word converted word
+ * @param value converted number
+ * @return 0 on success, -1 if word is not number
+ */
+int fzz_modelNumber(const char* word, double* value){
+    char* end = NULL;
+    if(word == NULL) return -1;
+    *value = strtod(word, &end);
+    return end != word && *end == '\0' ? 0 : -1;
+}
+
+/**
+ * @brief Converts word of model to non negative integer
+ * Internal function
+ * @param word converted word
+ * @param value converted integer
+ * @return 0 on success, -1 if word is not non negative integer
+ */
+int fzz_modelCount(const char* word, int* value){
+    char* end = NULL;
+    long count = 0;
+    if(word == NULL) return -1;
+    count = strtol(word, &end, 10);
+    if(end == word || *end != '\0' || count < 0 || count > 1000000) return -1;
+    *value = (int)count;
+    return 0;
+}
+
+/**
+ * @brief Processes one line of model
+ * Internal function
+ * @param p model parser
+ * @param line line of model (modified during processing)
+ * @return NULL on success, description of error otherwise
+ */
+const char* fzz_modelLine(TModelParser* p, char* line){
+    TDefuzzMethod method = FZZ_COG_STEP;
+    char* keyword = NULL;
+    char* name = NULL;
+    char* word = NULL;
+    double params[4];
+    int ops[4];
+    int shape = 0;
+    int inputs = 0;
+    int outputs = 0;
+    int length = 0;
+    int i = 0;
+    
+    //comments and empty lines are skipped
+    for(i = 0; line[i] != '\0'; i++){
+        if(line[i] == '#') line[i] = '\0';
+        if(line[i] == '\t') line[i] = ' ';
+    }
+    keyword = fzz_modelWord(&line);
+    if(keyword == NULL) return NULL;
+    if(p->sys == NULL && strcmp(keyword, "system"))
+        return "Model has to start with system declaration";
+    
+    //system <inputs> <outputs>
+    if(!strcmp(keyword, "system")){
+        if(p->sys != NULL) return "System is already declared";
+        if(fzz_modelCount(fzz_modelWord(&line), &inputs) != 0 || inputs == 0) return "Invalid number of inputs";
+        if(fzz_modelCount(fzz_modelWord(&line), &outputs) != 0 || outputs == 0) return "Invalid number of outputs";
+        p->sys = fzz_create(inputs, outputs);
+    }
+    
+    //input <name> <fuzzy sets>, output <name> <fuzzy sets> [method]
+    else if(!strcmp(keyword, "input") || !strcmp(keyword, "output")){
+        if(p->set != NULL && p->next < p->set->length) return "Fuzzy sets of previous input or output are missing";
+        name = fzz_modelWord(&line);
+        if(name == NULL) return "Name of input or output is missing";
+        if(fzz_modelCount(fzz_modelWord(&line), &length) != 0) return "Invalid number of fuzzy sets";
+        if(!strcmp(keyword, "input")){
+            if(p->inputs == p->sys->inLen) return "Too many inputs";
+            fzz_initInputFcnsEx(p->sys, p->inputs, length, name);
+            p->set = &p->sys->inSet[p->inputs];
+            p->fcSet = p->inputs++;
+            p->isInput = 1;
+        }else{
+            if(p->outputs == p->sys->outLen) return "Too many outputs";
+            word = fzz_modelWord(&line);
+            if(word != NULL){
+                for(i = 0; fzzDefuzzNames[i] != NULL && strcmp(word, fzzDefuzzNames[i]); i++);
+                if(fzzDefuzzNames[i] == NULL) return "Unknown defuzzification method";
+                method = (TDefuzzMethod)i;
+            }
+            fzz_initOutputFcnsEx(p->sys, p->outputs, length, name);
+            fzz_setDefuzzMethodEx(p->sys, p->outputs, method);
+            p->set = &p->sys->outSet[p->outputs];
+            p->fcSet = p->outputs++;
+            p->isInput = 0;
+        }
+        p->next = 0;
+    }
+    
+    //set <name> [shape] <parameters>, next fuzzy set of last input or output
+    else if(!strcmp(keyword, "set")){
+        if(p->set == NULL || p->next == p->set->length) return "Fuzzy set does not belong to any input or output";
+        name = fzz_modelWord(&line);
+        if(name == NULL) return "Name of fuzzy set is missing";
+        word = fzz_modelWord(&line);
+        shape = -1;
+        for(i = 0; word != NULL && fzzShapeNames[i] != NULL; i++)
+            if(!strcmp(word, fzzShapeNames[i])) shape = i;
+        i = 0;
+        if(shape < 0){
+            //triangle when shape is omitted, word is its left corner
+            shape = FZZ_TRIANGLE;
+            if(fzz_modelNumber(word, &params[i++]) != 0) return "Unknown shape of fuzzy set";
+        }
+        for(; i < fzzShapeParams[shape]; i++)
+            if(fzz_modelNumber(fzz_modelWord(&line), &params[i]) != 0) return "Invalid corners of fuzzy set";
+        if(!fzz_validShape((TFzzShape)shape, params)) return "Corners of fuzzy set are not ordered";
+        if(shape <= FZZ_RIGHT_SHOULDER && !(params[0] < params[fzzShapeParams[shape]-1])) return "Corners of fuzzy set are not ordered";
+        if(p->isInput) fzz_setInputShapeEx(p->sys, p->next, p->fcSet, (TFzzShape)shape, params, name);
+        else fzz_setOutputShapeEx(p->sys, p->next, p->fcSet, (TFzzShape)shape, params, name);
+        p->next++;
+    }
+    
+    //operators <and> <or> <implication> <aggregation>
+    else if(!strcmp(keyword, "operators")){
+        for(i = 0; i < 4; i++){
+            word = fzz_modelWord(&line);
+            for(ops[i] = 0; word != NULL && fzzOperatorNames[ops[i]] != NULL && strcmp(word, fzzOperatorNames[ops[i]]); ops[i]++);
+            if(word == NULL || fzzOperatorNames[ops[i]] == NULL) return "Unknown fuzzy operator";
+        }
+        if(!fzz_validOperators(ops[0], ops[1], ops[2], ops[3])) return "Invalid operators, and and implication have to be t-norms, or and aggregation s-norms";
+        fzz_setOperatorsEx(p->sys, (TFzzOperator)ops[0], (TFzzOperator)ops[1], (TFzzOperator)ops[2], (TFzzOperator)ops[3]);
+    }
+    
+    //realtime <samples>
+    else if(!strcmp(keyword, "realtime")){
+        if(fzz_modelCount(fzz_modelWord(&line), &length) != 0 || length == 1) return "Invalid number of samples";
+        fzz_setRealtimeEx(p->sys, length);
+    }
+    
+    //rule <rule>, the rest of line in syntax of fzz_addRule
+    else if(!strcmp(keyword, "rule")){
+        //names of rule are searched among all inputs, outputs and their fuzzy sets
+        if(p->inputs < p->sys->inLen || p->outputs < p->sys->outLen) return "Rule is declared before all inputs and outputs";
+        if(p->next < p->set->length) return "Rule is declared before fuzzy sets of last input or output";
+        while(*line == ' ' || *line == '\r') line++;
+        for(i = (int)strlen(line); i > 0 && (line[i-1] == ' ' || line[i-1] == '\r'); i--) line[i-1] = '\0';
+        return fzz_addRuleText(p->sys, line);
+    }
+    
+    else{
+        return "Unknown declaration";
+    }
+    
+    //whole line has to be processed
+    if(fzz_modelWord(&line) != NULL) return "Unexpected text at the end of line";
+    return NULL;
+}
+
+/**
+ * @brief Processes part of model text, complete lines are processed 
+ * immediately, the rest is kept for next part
+ * Internal function
+ * @param p model parser
+ * @param data part of model text
+ * @param length length of part
+ * @return 0 on success, -1 if model is invalid
+ */
+int fzz_modelFeed(TModelParser* p, const char* data, size_t length){
+    size_t i = 0;
+    
+    for(i = 0; i < length && p->error == NULL; i++){
+        //line is complete
+        if(data[i] == '\n'){
+            p->lineNumber++;
+            p->line[p->lineLength] = '\0';
+            p->error = fzz_modelLine(p, p->line);
+            p->lineLength = 0;
+            continue;
+        }
+        
+        //capacity of line is doubled when it is full
+        if(p->lineLength + 1 >= p->lineCapacity){
+            p->lineCapacity = p->lineCapacity > 0 ? 2*p->lineCapacity : 256;
+            p->line = (char*)realloc(p->line, p->lineCapacity);
+            assert(p->line != NULL && "Memory allocation failed in fzz_loadModel(...)");
+        }
+        p->line[p->lineLength++] = data[i];
+    }
+    return p->error == NULL ? 0 : -1;
+}
+
+/**
+ * @brief Finishes model processing
+ * Internal function, processes last line and checks that model is complete
+ * @param p model parser
+ * @param line line of error (output, can be NULL)
+ * @param error description of error (output, can be NULL)
+ * @return created fuzzy system, NULL if model is invalid
+ */
+TFzzSystem* fzz_modelFinish(TModelParser* p, int* line, const char** error){
+    //last line does not have to be terminated
+    if(p->error == NULL && p->lineLength > 0) fzz_modelFeed(p, "\n", 1);
+    if(p->error == NULL){
+        p->lineNumber++;
+        if(p->sys == NULL) p->error = "Model is empty";
+        else if(p->inputs < p->sys->inLen || p->outputs < p->sys->outLen) p->error = "Some inputs or outputs are not declared";
+        else if(p->next < p->set->length) p->error = "Fuzzy sets of last input or output are missing";
+    }
+    free(p->line);
+    
+    //results
+    if(line != NULL) *line = p->error == NULL ? 0 : p->lineNumber;
+    if(error != NULL) *error = p->error;
+    if(p->error != NULL && p->sys != NULL){
+        fzz_destroy(p->sys);
+        p->sys = NULL;
+    }
+    return p->sys;
+}
+
+TFzzSystem* fzz_parseModelEx(const char* text, int* line, const char** error){
+    TModelParser p;
+    
+    memset(&p, 0, sizeof(TModelParser));
+    fzz_modelFeed(&p, text, strlen(text));
+    return fzz_modelFinish(&p, line, error);
+}
+
+TFzzSystem* fzz_loadModelEx(const char* file, int* line, const char** error){
+    TModelParser p;
+    FILE* f = NULL;
+    char buffer[4096];
+    size_t length = 0;
+    
+    //file is streamed in blocks
+    memset(&p, 0, sizeof(TModelParser));
+    f = fopen(file, "r");
+    if(f == NULL){
+        p.error = "Can not open model file";
+    }else{
+        while((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            if(fzz_modelFeed(&p, buffer, length) != 0) break;
+        fclose(f);
+    }
+    return fzz_modelFinish(&p, line, error);
+}
+
+void fzz_printInputSet(int index){
+    fzz_printInputSetEx(fzzSystem, index);
+}
+
+void fzz_printOutputSet(int index){
+    fzz_printOutputSetEx(fzzSystem, index);
+}
+
+void fzz_printRules(){
+    fzz_printRulesEx(fzzSystem);
+}
+
+void fzz_printSystem(){
+    fzz_printSystemEx(fzzSystem);
+}
+
+void fzz_printTrace(){
+    fzz_printTraceEx(fzz_defaultContext());
+}
+
+int fzz_saveSystem(const char* file){
+    return fzz_saveSystemEx(fzzSystem, file);
+}
+
+int fzz_loadModel(const char* file){
+    TFzzSystem* sys = fzz_loadModelEx(file, NULL, NULL);
+    
+    //default system is kept when model can not be loaded
+    if(sys == NULL) return -1;
+    fzz_releaseDefault();
+    fzzSystem = sys;
+    
+    //arrays for storing system inputs and output
+    fzzInput = (double*)calloc(sys->inLen, sizeof(double));
+    fzzOutput = (double*)calloc(sys->outLen, sizeof(double));
+    assert(fzzInput != NULL && fzzOutput != NULL && "Memory allocation failed in fzz_loadModel(...)");
+    return 0;
+}
+
+int fzz_loadSystem(const char* file){
+    TFzzSystem* sys = fzz_loadSystemEx(file);
+    
+    //default system is kept when file can not be loaded
+    if(sys == NULL) return -1;
+    fzz_releaseDefault();
+    fzzSystem = sys;
+    
+    //arrays for storing system inputs and output
+    fzzInput = (double*)calloc(sys->inLen, sizeof(double));
+    fzzOutput = (double*)calloc(sys->outLen, sizeof(double));
+    assert(fzzInput != NULL && fzzOutput != NULL && "Memory allocation failed in fzz_loadSystem(...)");
+    return 0;
 }
 
 ///////////////////////////////////////////////////
@@ -22,10 +22,213 @@
  * @date 12.4.2014
  */
 
+#ifndef FZZLIB_H
+#define FZZLIB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////
+//////// Data types ///////////////////////////////
+///////////////////////////////////////////////////
+
+/*
+ * When library is compiled with FZZ_FLOAT defined, system and context
+ * store single precision numbers (half of memory) and calculation is 
+ * done in single precision, functions still take and return double.
+ * Outputs differ from double precision build by about 1e-5 of range
+ * of output. Fixed point calculation is described by fzz_compileFixed.
+ */
+
+/**
+ * @brief Fuzzy system (membership functions and compiled rules)
+ * System is modified only during its setup, output calculation
+ * only reads it, so one system can be used by many threads at once
+ */
+typedef struct TFzzSystem TFzzSystem;
+
+/**
+ * @brief Scratch data of output calculation
+ * Each thread calculating outputs of system needs its own context
+ */
+typedef struct TFzzContext TFzzContext;
+
+/**
+ * @brief Pool of worker threads for parallel batch calculation
+ * Every worker owns its context, pool can be used for any system
+ * but only by one thread at once
+ */
+typedef struct TFzzPool TFzzPool;
+
+/**
+ * @brief Shared fuzzy system which can be replaced while it is calculated
+ * @see fzz_createShared
+ */
+typedef struct TFzzShared TFzzShared;
+
+/**
+ * @brief Reader of shared fuzzy system, one per thread
+ */
+typedef struct TFzzReader TFzzReader;
+
+/**
+ * @brief GPU backend calculating batches of inputs of fuzzy system
+ * @see fzz_createGpu
+ */
+typedef struct TFzzGpu TFzzGpu;
+
+/**
+ * @brief Graph of fuzzy systems connected by links from outputs to inputs
+ * Graph only references its systems, it owns contexts of its nodes,
+ * so it can be used only by one thread at once
+ */
+typedef struct TFzzGraph TFzzGraph;
+
+/**
+ * @brief Defuzzification methods
+ */
+typedef enum{
+    FZZ_COG_STEP,          ///< center of gravity, numeric integration (default)
+    FZZ_COG_EXACT,         ///< center of gravity, computed exactly from break points
+    FZZ_MOM,               ///< mean of maxima of aggregated output fuzzy set
+    FZZ_BISECTOR,          ///< bisector of area, computed exactly from break points
+    FZZ_WEIGHTED_AVERAGE   ///< tops of fuzzy sets weighted by rule strength, no integration
+}TDefuzzMethod;
+
+/**
+ * @brief Shapes of membership functions, parameters are listed in order
+ */
+typedef enum{
+    FZZ_TRIANGLE,        ///< left, top, right
+    FZZ_TRAPEZOID,       ///< left, start of top, end of top, right
+    FZZ_LEFT_SHOULDER,   ///< start of top, end of top, right; input below start keeps full membership
+    FZZ_RIGHT_SHOULDER,  ///< left, start of top, end of top; input above end keeps full membership
+    FZZ_GAUSSIAN,        ///< center, sigma; membership is zero farther than 4 sigmas from center
+    FZZ_SINGLETON        ///< point; has no area, use it with mean of maxima or weighted average
+}TFzzShape;
+
+/**
+ * @brief Fuzzy operators, t-norms (and, implication) and s-norms (or, aggregation)
+ */
+typedef enum{
+    FZZ_MIN,          ///< t-norm min(a, b) (default and, implication by clipping)
+    FZZ_PRODUCT,      ///< t-norm a*b (implication by scaling)
+    FZZ_MAX,          ///< s-norm max(a, b) (default or, aggregation)
+    FZZ_PROBOR,       ///< s-norm a + b - a*b, probabilistic or
+    FZZ_BOUNDED_SUM   ///< s-norm min(1, a + b)
+}TFzzOperator;
+
+/**
+ * @brief Runtime statistics of output calculation, flags can be combined
+ */
+typedef enum{
+    FZZ_STATS_COUNT = 1,  ///< counters of calculations, rules and integration steps
+    FZZ_STATS_TIME = 2,   ///< time spent by stages of calculation
+    FZZ_STATS_TRACE = 4   ///< ring buffer of recent calculations
+}TFzzStatsFlag;
+
+/**
+ * @brief Number of bins of histogram of fired rules
+ * Bin 0 counts calculations without fired rule, bin i calculations 
+ * with 2^(i-1) to 2^i - 1 fired rules, the last bin also all above
+ */
+#define FZZ_STATS_BINS 16
+
+/**
+ * @brief Statistics of output calculation collected by one context
+ * Times are in nanoseconds, stage times are measured by stage
+ * functions (used by fzz_calculateOutputEx), total time by every
+ * calculation of outputs
+ */
+typedef struct{
+    unsigned long long evaluations;       ///< calculations of outputs
+    unsigned long long rulesEvaluated;    ///< rules whose antecedent was evaluated
+    unsigned long long rulesFired;        ///< rules which fired
+    unsigned long long integrationSteps;  ///< points of aggregated output fuzzy sets evaluated by defuzzification
+    unsigned long long firedHistogram[FZZ_STATS_BINS];
+    unsigned long long fuzzifyNs;
+    unsigned long long inferNs;
+    unsigned long long defuzzifyNs;
+    unsigned long long totalNs;
+}TFzzStats;
+
+/**
+ * @brief Report of optimization of rules
+ * @see fzz_optimizeRules
+ */
+typedef struct{
+    int rules;          ///< rules before optimization
+    int remaining;      ///< rules after optimization
+    int dead;           ///< removed rules which can never fire
+    int duplicate;      ///< removed duplicates of other rules
+    int subsumed;       ///< removed rules subsumed by other rules
+    int merged;         ///< rules merged into other rule with the same consequent
+    double deviation;   ///< maximal deviation of outputs from original system
+}TFzzOptimizeStats;
+
+/**
+ * @brief Upper bound of work of one calculation of outputs
+ * Counts are the most loop iterations fzz_calculateOutputEx can make
+ * for the model, rules and integrationSteps bound rulesEvaluated and 
+ * integrationSteps of TFzzStats
+ * @see fzz_worstCase
+ */
+typedef struct{
+    long long memberships;       ///< evaluations of membership functions of input fuzzy sets
+    long long rules;             ///< rules whose antecedent is evaluated
+    long long conditions;        ///< visits of conditions of rules (listing and evaluation)
+    long long integrationSteps;  ///< points of aggregated output fuzzy sets evaluated by defuzzification
+    long long outputSets;        ///< evaluations of output fuzzy sets or linear functions (and intersections of their sides)
+    long long comparisons;       ///< comparisons of sorting of break points, plateaus and fired fuzzy sets
+    long long operations;        ///< sum of all counts except integrationSteps
+}TFzzWorstCase;
+
+/**
+ * @brief Parameters of system tuned by training, flags can be combined
+ */
+typedef enum{
+    FZZ_TRAIN_INPUTS = 1,      ///< shape parameters of input fuzzy sets (except singletons)
+    FZZ_TRAIN_OUTPUTS = 2,     ///< shape parameters of output fuzzy sets of Mamdani outputs
+    FZZ_TRAIN_CONSEQUENTS = 4  ///< coefficients of linear functions in consequents (Sugeno)
+}TFzzTrainFlag;
+
+/**
+ * @brief Settings of training, zero members select defaults
+ * @see fzz_train
+ */
+typedef struct{
+    int flags;          ///< tuned parameters (TFzzTrainFlag), 0 for all
+    int epochs;         ///< maximal number of epochs (gradient steps), 0 for 100
+    double rate;        ///< initial learning rate, 0 for 0.01
+    double tolerance;   ///< training stops when error falls to tolerance
+}TFzzTrainParams;
+
+/**
+ * @brief Report of training
+ * Error is root mean square error of all outputs over dataset, outputs
+ * without fired rule and missing (NaN) targets are not counted
+ * @see fzz_train
+ */
+typedef struct{
+    int parameters;        ///< number of tuned parameters
+    int analytic;          ///< 1 when gradient was analytic (all outputs Sugeno), 0 when numeric
+    int epochs;            ///< epochs run
+    int accepted;          ///< epochs whose step decreased error
+    double initialError;   ///< error before training
+    double error;          ///< error after training
+}TFzzTrainStats;
+
 ///////////////////////////////////////////////////
 //////// Main functions ///////////////////////////
 ///////////////////////////////////////////////////
 
+/*
+ * Functions in this section work with default fuzzy system 
+ * created by fzz_init, they are wrappers of functions from
+ * section "Fuzzy system functions"
+ */
+
 /**
  * @brief Initialization of fuzzy system
  * Clears system data and sets number of inputs and outputs
@@ -41,19 +244,25 @@ void fzz_deinit();
 
 /**
  * @brief Initialization of membership functions input set
+ * Rules added before are compiled again as soon as names of all their
+ * fuzzy sets are set again (by fzz_setInputFcn or fzz_setInputShape); until
+ * then system has no rules and it can not be calculated or saved
  * @param index index of input membership functions set
  * @param length required number of membership functions in set
  * @param name membership functions set name
  */
-void fzz_initInputFcns(int index, int length, char* name);
+void fzz_initInputFcns(int index, int length, const char* name);
 
 /**
  * @brief Initialization of membership functions output set
+ * Rules added before are compiled again as soon as names of all their
+ * fuzzy sets are set again (by fzz_setOutputFcn or fzz_setOutputShape); until
+ * then system has no rules and it can not be calculated or saved
  * @param index index of output membership functions set
  * @param length required number of membership functions in set
  * @param name membership functions set name
  */
-void fzz_initOutputFcns(int index, int length, char* name);
+void fzz_initOutputFcns(int index, int length, const char* name);
 
 /**
  * @brief Sets membership function of fuzzy set in input set of membership functions
@@ -64,7 +273,7 @@ void fzz_initOutputFcns(int index, int length, char* name);
  * @param right x-axis position of second bottom point of triangular membership function 
  * @param name name of fuzzy set
  */
-void fzz_setInputFcn(int index, int fcSet, double left, double top, double right, char* name);
+void fzz_setInputFcn(int index, int fcSet, double left, double top, double right, const char* name);
 
 /**
  * @brief Sets membership function of fuzzy set in output set of membership functions
@@ -75,7 +284,76 @@ void fzz_setInputFcn(int index, int fcSet, double left, double top, double right
  * @param right x-axis position of second bottom point of triangular membership function 
  * @param name name of fuzzy set
  */
-void fzz_setOutputFcn(int index, int fcSet, double left, double top, double right, char* name);
+void fzz_setOutputFcn(int index, int fcSet, double left, double top, double right, const char* name);
+
+/**
+ * @brief Sets membership function of given shape of fuzzy set in input set 
+ * of membership functions
+ * Input fuzzified by shoulder seen as open, its outer point only limits 
+ * range of input (used by fzz_bake and fzz_compileFixed)
+ * @param index index of fuzzy set in set of membership functions
+ * @param fcSet index of input membership functions set
+ * @param shape shape of membership function
+ * @param params parameters of shape (see TFzzShape), points have to be nondecreasing
+ * @param name name of fuzzy set
+ */
+void fzz_setInputShape(int index, int fcSet, TFzzShape shape, const double* params, const char* name);
+
+/**
+ * @brief Sets membership function of given shape of fuzzy set in output set 
+ * of membership functions
+ * Output shoulder is cut in its outer point (vertical side). Exact center 
+ * of gravity and bisector are approximate for Gaussian fuzzy sets.
+ * @param index index of fuzzy set in set of membership functions
+ * @param fcSet index of output membership functions set
+ * @param shape shape of membership function
+ * @param params parameters of shape (see TFzzShape), points have to be nondecreasing
+ * @param name name of fuzzy set
+ */
+void fzz_setOutputShape(int index, int fcSet, TFzzShape shape, const double* params, const char* name);
+
+/**
+ * @brief Sets defuzzification method of output
+ * Method is not used by output with linear functions in consequents
+ * @param output index of output
+ * @param method defuzzification method
+ */
+void fzz_setDefuzzMethod(int output, TDefuzzMethod method);
+
+/**
+ * @brief Sets fuzzy operators of inference
+ * And and or combine conditions of antecedent, implication limits 
+ * consequent fuzzy set by strength of rule (min clips, product scales it)
+ * and aggregation combines rules of the same output fuzzy set and then
+ * implied fuzzy sets of output. Evaluation of every rule is specialized 
+ * for its connective and operator when rule is compiled, default 
+ * min, max, min, max is evaluated as fast as without operators. With 
+ * aggregation other than max, aggregated fuzzy set is not piecewise 
+ * linear, so exact center of gravity and bisector are approximate 
+ * and mean of maxima is searched in samples.
+ * @param andOp t-norm of and (FZZ_MIN or FZZ_PRODUCT)
+ * @param orOp s-norm of or (FZZ_MAX, FZZ_PROBOR or FZZ_BOUNDED_SUM)
+ * @param implication t-norm of implication (FZZ_MIN or FZZ_PRODUCT)
+ * @param aggregation s-norm of aggregation (FZZ_MAX, FZZ_PROBOR or FZZ_BOUNDED_SUM)
+ */
+void fzz_setOperators(TFzzOperator andOp, TFzzOperator orOp, TFzzOperator implication, TFzzOperator aggregation);
+
+/**
+ * @brief Sets real-time mode of default fuzzy system
+ * Calculation never allocates memory, everything is allocated when 
+ * context is created (default context is created again by the first 
+ * calculation after system changed). All loops are bounded by model: 
+ * fuzzy sets, rules and their conditions, break points of output 
+ * (sorted in place). In real-time mode center of gravity by steps and 
+ * mean of maxima of aggregation other than max sample grid of given
+ * number of points covering all fuzzy sets of output instead of 
+ * COG_STEP, so their cost does not depend on range of output; grid 
+ * has to be fine enough for the narrowest output fuzzy set.
+ * Worst case of calculation is reported by fzz_worstCase.
+ * @param samples number of samples of every output (at least 2), 
+ * 0 for COG_STEP
+ */
+void fzz_setRealtime(int samples);
 
 /**
  * @brief Adds rule for inferential mechanism
@@ -84,8 +362,68 @@ void fzz_setOutputFcn(int index, int fcSet, double left, double top, double righ
  * are names of input sets of membership function, "output" is name of output set 
  * of membership functions, "big" and "medium" are names of one of input fuzzy sets
  * and "slow" is name of one of output fuzzy set.
+ * Conditions can be joined by "or" instead of "and" (one rule can not mix
+ * them) and condition "input1 is not big" takes complement of membership
+ * (unless input has fuzzy set named "not"), see fzz_setOperators.
+ * Rule can end with weight, e.g. "then output is slow with 0.5", weight
+ * in range (0, 1] scales strength of rule (1 when omitted).
+ * Consequent can be also linear function of inputs (Takagi-Sugeno rule), 
+ * e.g. "then output is 0.3*input1 - input2 + 0.1", terms are numbers,
+ * input names or products number*name. Output with such rules is 
+ * calculated as average of values of functions weighted by strength
+ * of rules (no defuzzification), all its rules have to use functions; 
+ * fuzzy set name takes precedence over equal input name.
+ * Rule is compiled when added, so all input and output sets used in rule
+ * must be initialized before. Invalid rule is reported here, not during 
+ * output calculation.
  */
-void fzz_addRule(char* rule);
+void fzz_addRule(const char* rule);
+
+/**
+ * @brief Removes and merges redundant rules of fuzzy system
+ * Offline pass intended for large generated rule bases. Rules which can
+ * never fire (conditions joined by and require disjoint fuzzy sets of 
+ * the same input) are always removed. With max aggregation also duplicate
+ * rules and rules subsumed by rule with the same fuzzy set in consequent
+ * and at least the same weight are removed (e.g. "if a is x and b is y 
+ * then o is z" is subsumed by "if a is x then o is z"), and with max 
+ * or rules with one condition or conditions joined by or sharing 
+ * consequent and weight are merged to one rule joined by or. Passes are
+ * repeated until nothing changes, as merged rule can subsume other 
+ * rules. None of these changes outputs, deviation is measured for 4096 pseudo random 
+ * input vectors to verify it. Texts of merged rules are generated,
+ * lookup table and fixed point form are dropped.
+ * @param stats report of optimization (output, can be NULL)
+ * @return maximal deviation of outputs from original system, 
+ * HUGE_VAL if output became defined or undefined
+ */
+double fzz_optimizeRules(TFzzOptimizeStats* stats);
+
+/**
+ * @brief Returns worst case of calculation of outputs of default system
+ * Bound assumes all fuzzy sets of inputs and outputs are hit and all 
+ * rules fire, it is computed from model only; time budget is worst case 
+ * multiplied by cost of operation measured on target (for example 
+ * totalNs of TFzzStats divided by evaluated operations of typical input).
+ * Fixed point calculation is not covered.
+ * @see fzz_setRealtime
+ * @param report counts of worst case (output, can be NULL)
+ * @return upper bound of number of operations
+ */
+long long fzz_worstCase(TFzzWorstCase* report);
+
+/**
+ * @brief Tunes default fuzzy system to fit dataset
+ * Uses pool of fzz_setThreads
+ * @see fzz_trainEx
+ * @param count number of samples
+ * @param inputs input vectors of samples, count*inputs values
+ * @param targets required outputs of samples, count*outputs values
+ * @param params settings of training, NULL for defaults
+ * @param stats report of training, can be NULL
+ * @return error after training, -1 when no output is counted
+ */
+double fzz_train(int count, const double* inputs, const double* targets, const TFzzTrainParams* params, TFzzTrainStats* stats);
 
 /**
  * @brief Sets value of input for output calculation
@@ -104,10 +442,671 @@ double fzz_getOutput(int index);
 /**
  * @brief Calculates output of fuzzy system
  * Output calculation is composed from fuzzyfication,
- * inferential mechanism and defuzzyfication
+ * inferential mechanism and defuzzyfication; only inputs changed
+ * by fzz_setInput since last calculation are processed again
+ * @see fzz_updateOutputEx
  */
 void fzz_calculateOutput();
 
+/**
+ * @brief Calculates only one output of fuzzy system
+ * Only rules with consequent in given output are evaluated, 
+ * result is read by fzz_getOutput, other outputs are not changed
+ * @param index index of output
+ */
+void fzz_calculateOutputFor(int index);
+
+/**
+ * @brief Calculates outputs of fuzzy system for more input vectors
+ * Results are the same as when calling fzz_setInput, fzz_calculateOutput 
+ * and fzz_getOutput for each input vector
+ * @param count number of input vectors
+ * @param inputs input vectors, array double[count][number of inputs]
+ * @param outputs calculated outputs, array double[count][number of outputs]
+ */
+void fzz_calculateBatch(int count, const double* inputs, double* outputs);
+
+/**
+ * @brief Sets number of threads used by fzz_calculateBatch
+ * @param threads number of threads, 0 for number of processors, 
+ * 1 for calculation in calling thread only (default)
+ */
+void fzz_setThreads(int threads);
+
+/**
+ * @brief Bakes fuzzy system to lookup table
+ * Outputs are sampled in grid of points covering all input fuzzy sets,
+ * then fzz_calculateOutput only interpolates between grid points.
+ * Useful for systems with 1 or 2 inputs, size of table grows with
+ * resolution^inputs. Modification of system drops lookup table.
+ * @param resolution number of grid points for every input (>= 2)
+ * @return maximal interpolation error measured in centers of grid cells
+ */
+double fzz_bake(int resolution);
+
+/**
+ * @brief Drops lookup table, outputs are calculated exactly again
+ */
+void fzz_unbake();
+
+/**
+ * @brief Compiles fuzzy system to fixed point (Q15) form
+ * Fixed point calculation uses only 16 and 32 bit integers (one 64 bit 
+ * division per output), intended for processors without floating point 
+ * unit. Every input and output is normalized to 0..32767 covering all 
+ * its fuzzy sets, see fzz_inputToFixed and fzz_outputFromFixed. All rules
+ * are evaluated and whole range of every output is sampled in 257 points, 
+ * so time of calculation does not depend on inputs. Center of gravity
+ * is used for every output regardless of its defuzzification method,
+ * linear functions in consequents, Gaussian and singleton fuzzy sets,
+ * operators other than default and rules with or and not are not 
+ * supported. Error is given mainly by sampling of output (step is 1/256 of its 
+ * range), rounding of inputs and memberships adds 1/32767 of range.
+ * Measured error of typical systems is below 1% of output range 
+ * (part of it is integration error of FZZ_COG_STEP itself). 
+ * Modification of system drops fixed point form.
+ * @return maximal error against exact calculation measured 
+ * for 4096 pseudo random input vectors
+ */
+double fzz_compileFixed();
+
+/**
+ * @brief Calculates outputs of fuzzy system in fixed point
+ * System has to be compiled by fzz_compileFixed
+ * @param input normalized inputs (one per system input)
+ * @param output normalized outputs (one per system output), 
+ * -1 if output is not defined (no rule fired)
+ */
+void fzz_calculateFixed(const short* input, short* output);
+
+/**
+ * @brief Converts value of input to fixed point
+ * @param index index of input
+ * @param value value of input
+ * @return normalized value, saturated to 0..32767 (0 if value is not a number)
+ */
+short fzz_inputToFixed(int index, double value);
+
+/**
+ * @brief Converts fixed point output to value
+ * @param index index of output
+ * @param value normalized value of output
+ * @return value of output, NAN if value is negative (not defined)
+ */
+double fzz_outputFromFixed(int index, short value);
+
+/**
+ * @brief Enables runtime statistics of default fuzzy system
+ * @see fzz_setStatsEx
+ * @param flags combination of TFzzStatsFlag values, 0 disables statistics
+ * @param traceLength number of recent calculations kept in trace
+ */
+void fzz_setStats(int flags, int traceLength);
+
+/**
+ * @brief Returns runtime statistics of default fuzzy system
+ * Statistics are kept when system is modified
+ * @param stats copy of collected statistics
+ */
+void fzz_getStats(TFzzStats* stats);
+
+/**
+ * @brief Clears runtime statistics and trace of default fuzzy system
+ */
+void fzz_resetStats();
+
+///////////////////////////////////////////////////
+//////// Fuzzy system functions ///////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Creates new fuzzy system
+ * @param inputs number of system inputs
+ * @param outputs number of system outputs
+ * @return created system, must be released by fzz_destroy
+ */
+TFzzSystem* fzz_create(int inputs, int outputs);
+
+/**
+ * @brief Releases fuzzy system
+ * Contexts created for system must be released separately
+ * @param sys fuzzy system
+ */
+void fzz_destroy(TFzzSystem* sys);
+
+/**
+ * @brief Initialization of membership functions input set
+ * @see fzz_initInputFcns
+ * @param sys fuzzy system
+ */
+void fzz_initInputFcnsEx(TFzzSystem* sys, int index, int length, const char* name);
+
+/**
+ * @brief Initialization of membership functions output set
+ * @see fzz_initOutputFcns
+ * @param sys fuzzy system
+ */
+void fzz_initOutputFcnsEx(TFzzSystem* sys, int index, int length, const char* name);
+
+/**
+ * @brief Sets membership function of fuzzy set in input set of membership functions
+ * @see fzz_setInputFcn
+ * @param sys fuzzy system
+ */
+void fzz_setInputFcnEx(TFzzSystem* sys, int index, int fcSet, double left, double top, double right, const char* name);
+
+/**
+ * @brief Sets membership function of fuzzy set in output set of membership functions
+ * @see fzz_setOutputFcn
+ * @param sys fuzzy system
+ */
+void fzz_setOutputFcnEx(TFzzSystem* sys, int index, int fcSet, double left, double top, double right, const char* name);
+
+/**
+ * @brief Sets membership function of given shape of fuzzy set in input set
+ * @see fzz_setInputShape
+ * @param sys fuzzy system
+ */
+void fzz_setInputShapeEx(TFzzSystem* sys, int index, int fcSet, TFzzShape shape, const double* params, const char* name);
+
+/**
+ * @brief Sets membership function of given shape of fuzzy set in output set
+ * @see fzz_setOutputShape
+ * @param sys fuzzy system
+ */
+void fzz_setOutputShapeEx(TFzzSystem* sys, int index, int fcSet, TFzzShape shape, const double* params, const char* name);
+
+/**
+ * @brief Sets defuzzification method of output
+ * @see fzz_setDefuzzMethod
+ * @param sys fuzzy system
+ */
+void fzz_setDefuzzMethodEx(TFzzSystem* sys, int output, TDefuzzMethod method);
+
+/**
+ * @brief Sets fuzzy operators of inference
+ * @see fzz_setOperators
+ * @param sys fuzzy system
+ */
+void fzz_setOperatorsEx(TFzzSystem* sys, TFzzOperator andOp, TFzzOperator orOp, TFzzOperator implication, TFzzOperator aggregation);
+
+/**
+ * @brief Sets real-time mode of fuzzy system
+ * @see fzz_setRealtime
+ * @param sys fuzzy system
+ */
+void fzz_setRealtimeEx(TFzzSystem* sys, int samples);
+
+/**
+ * @brief Adds rule for inferential mechanism
+ * @see fzz_addRule
+ * @param sys fuzzy system
+ */
+void fzz_addRuleEx(TFzzSystem* sys, const char* rule);
+
+/**
+ * @brief Removes and merges redundant rules of fuzzy system
+ * @see fzz_optimizeRules
+ * @param sys fuzzy system
+ */
+double fzz_optimizeRulesEx(TFzzSystem* sys, TFzzOptimizeStats* stats);
+
+/**
+ * @brief Returns worst case of calculation of outputs of fuzzy system
+ * @see fzz_worstCase
+ * @param sys fuzzy system
+ */
+long long fzz_worstCaseEx(const TFzzSystem* sys, TFzzWorstCase* report);
+
+/**
+ * @brief Creates context for output calculation of given system
+ * @param sys fuzzy system
+ * @return created context, must be released by fzz_destroyContext
+ */
+TFzzContext* fzz_createContext(const TFzzSystem* sys);
+
+/**
+ * @brief Releases context of output calculation
+ * @param ctx context
+ */
+void fzz_destroyContext(TFzzContext* ctx);
+
+/**
+ * @brief Enables runtime statistics collected by context
+ * Statistics are disabled by default, disabled statistics cost one
+ * test per calculation stage. Every context is used by single thread,
+ * so collected statistics need no locks.
+ * @param ctx context
+ * @param flags combination of TFzzStatsFlag values, 0 disables statistics
+ * @param traceLength number of recent calculations kept in trace 
+ * (inputs, outputs, fired rules and time), used with FZZ_STATS_TRACE
+ */
+void fzz_setStatsEx(TFzzContext* ctx, int flags, int traceLength);
+
+/**
+ * @brief Returns runtime statistics collected by context
+ * @param ctx context
+ * @param stats copy of collected statistics
+ */
+void fzz_getStatsEx(const TFzzContext* ctx, TFzzStats* stats);
+
+/**
+ * @brief Clears runtime statistics and trace of context
+ * @param ctx context
+ */
+void fzz_resetStatsEx(TFzzContext* ctx);
+
+/**
+ * @brief Calculates output of fuzzy system
+ * System is not modified, so it can be called from more threads 
+ * at once for the same system when each thread uses its own context
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ * @param input array of input values (one per system input)
+ * @param output array for calculated outputs (one per system output)
+ */
+void fzz_calculateOutputEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output);
+
+/**
+ * @brief Calculates output of fuzzy system incrementally
+ * Context keeps results of previous call, only inputs which differ from
+ * previous call are fuzzified again and only rules referencing them
+ * are evaluated again; previous outputs are returned when no input 
+ * changed. Results are the same as from fzz_calculateOutputEx.
+ * Other calculations using the same context drop kept results.
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ * @param input array of input values (one per system input)
+ * @param output array for calculated outputs (one per system output)
+ */
+void fzz_updateOutputEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, double* output);
+
+/**
+ * @brief Calculates only one output of fuzzy system
+ * @see fzz_calculateOutputFor
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ * @param input array of input values (one per system input)
+ * @param output index of calculated output
+ * @return crisp value of output
+ */
+double fzz_calculateOutputForEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input, int output);
+
+/**
+ * @brief Calculates outputs of fuzzy system for more input vectors
+ * @see fzz_calculateBatch
+ * @param sys fuzzy system
+ * @param ctx context of calculation (reused for all input vectors)
+ */
+void fzz_calculateBatchEx(const TFzzSystem* sys, TFzzContext* ctx, int count, const double* inputs, double* outputs);
+
+/**
+ * @brief Creates pool of worker threads
+ * Calling thread works as one of workers, so threads - 1 threads
+ * are started; pool has only one worker when threads are not available
+ * @param threads number of workers, 0 for number of processors
+ * @return created pool
+ */
+TFzzPool* fzz_createPool(int threads);
+
+/**
+ * @brief Stops worker threads and releases pool
+ * @param pool released pool
+ */
+void fzz_destroyPool(TFzzPool* pool);
+
+/**
+ * @brief Returns number of workers of pool
+ * @param pool pool of worker threads
+ * @return number of workers including calling thread
+ */
+int fzz_poolThreads(const TFzzPool* pool);
+
+/**
+ * @brief Calculates outputs of fuzzy system for more input vectors in parallel
+ * Input vectors are split to ranges of workers, worker that finished
+ * its range steals half of remaining range of other worker. Results
+ * are the same as from fzz_calculateBatchEx.
+ * @see fzz_calculateBatch
+ * @param sys fuzzy system
+ * @param pool pool of worker threads
+ */
+void fzz_calculateBatchPoolEx(const TFzzSystem* sys, TFzzPool* pool, int count, const double* inputs, double* outputs);
+
+/**
+ * @brief Bakes fuzzy system to lookup table
+ * @see fzz_bake
+ * @param sys fuzzy system
+ */
+double fzz_bakeEx(TFzzSystem* sys, int resolution);
+
+/**
+ * @brief Drops lookup table of fuzzy system
+ * @see fzz_unbake
+ * @param sys fuzzy system
+ */
+void fzz_unbakeEx(TFzzSystem* sys);
+
+/**
+ * @brief Compiles fuzzy system to fixed point (Q15) form
+ * @see fzz_compileFixed
+ * @param sys fuzzy system
+ */
+double fzz_compileFixedEx(TFzzSystem* sys);
+
+/**
+ * @brief Calculates outputs of fuzzy system in fixed point
+ * @see fzz_calculateFixed
+ * @param sys fuzzy system compiled by fzz_compileFixedEx
+ * @param ctx context of calculation
+ */
+void fzz_calculateFixedEx(const TFzzSystem* sys, TFzzContext* ctx, const short* input, short* output);
+
+/**
+ * @brief Converts value of input to fixed point
+ * @see fzz_inputToFixed
+ * @param sys fuzzy system compiled by fzz_compileFixedEx
+ */
+short fzz_inputToFixedEx(const TFzzSystem* sys, int index, double value);
+
+/**
+ * @brief Converts fixed point output to value
+ * @see fzz_outputFromFixed
+ * @param sys fuzzy system compiled by fzz_compileFixedEx
+ */
+double fzz_outputFromFixedEx(const TFzzSystem* sys, int index, short value);
+
+/**
+ * @brief Tunes membership functions and consequents of system to fit dataset
+ * Gradient descent minimizes squared error of outputs, rate grows after
+ * step decreasing error and step increasing error is taken back with 
+ * halved rate. Gradient is analytic when all outputs are Sugeno (like 
+ * ANFIS), numeric otherwise (central differences, two batch calculations
+ * of dataset per parameter); dataset is calculated on pool. Points of 
+ * shapes stay ordered, texts of rules with tuned coefficients are written
+ * again; lookup table and fixed point form are dropped.
+ * @param sys fuzzy system (not loaded from file)
+ * @param pool pool of worker threads, NULL for calling thread
+ * @param count number of samples
+ * @param inputs input vectors of samples, count*inputs values
+ * @param targets required outputs of samples, count*outputs values
+ * @param params settings of training, NULL for defaults
+ * @param stats report of training, can be NULL
+ * @return error after training, -1 when no output is counted
+ */
+double fzz_trainEx(TFzzSystem* sys, TFzzPool* pool, int count, const double* inputs, const double* targets, const TFzzTrainParams* params, TFzzTrainStats* stats);
+
+///////////////////////////////////////////////////
+//////// Graph functions //////////////////////////
+///////////////////////////////////////////////////
+
+/*
+ * Graph connects outputs of systems (nodes) to inputs of other systems
+ * and evaluates whole cascade in one call; links must not form cycle.
+ * Inputs of graph are inputs of nodes which are not linked, outputs of
+ * graph are outputs of all nodes (intermediate ones too), both in order
+ * of nodes and their inputs or outputs. Crisp link passes output value.
+ * Fuzzy link passes aggregated levels of output fuzzy sets as memberships
+ * of input fuzzy sets with the same index (output and input need the same
+ * number of fuzzy sets), so defuzzification and fuzzification are skipped
+ * for rules of the linked input; crisp value is still used by linear 
+ * functions of inputs. Nodes with fuzzy link are evaluated by stage 
+ * functions (lookup table is not used and statistics are not recorded).
+ */
+
+/**
+ * @brief Creates empty graph of fuzzy systems
+ * @return created graph
+ */
+TFzzGraph* fzz_createGraph();
+
+/**
+ * @brief Releases graph and contexts of its nodes (systems are kept)
+ * @param graph released graph
+ */
+void fzz_destroyGraph(TFzzGraph* graph);
+
+/**
+ * @brief Adds fuzzy system to graph as new node
+ * System can be modified later, contexts are created again for new 
+ * revision; one system can be added more times under different names
+ * @param graph graph of fuzzy systems
+ * @param sys fuzzy system (must live as long as graph)
+ * @param name unique name of node (without '.')
+ * @return index of node
+ */
+int fzz_addGraphNode(TFzzGraph* graph, const TFzzSystem* sys, const char* name);
+
+/**
+ * @brief Links output of one node to input of another node
+ * @param graph graph of fuzzy systems
+ * @param from output written as "node.output"
+ * @param to input written as "node.input"
+ * @param fuzzy 1 for fuzzy link, 0 for crisp link
+ * @return 0 on success, -1 if name is not found, input is already 
+ * linked, link would make cycle or fuzzy sets of fuzzy link differ
+ */
+int fzz_linkGraph(TFzzGraph* graph, const char* from, const char* to, int fuzzy);
+
+/**
+ * @brief Returns number of inputs of graph (not linked inputs of nodes)
+ * @param graph graph of fuzzy systems
+ * @return number of inputs
+ */
+int fzz_graphInputs(TFzzGraph* graph);
+
+/**
+ * @brief Returns number of outputs of graph (outputs of all nodes)
+ * @param graph graph of fuzzy systems
+ * @return number of outputs
+ */
+int fzz_graphOutputs(TFzzGraph* graph);
+
+/**
+ * @brief Returns index of graph input
+ * @param graph graph of fuzzy systems
+ * @param name input written as "node.input"
+ * @return index in input array of graph, -1 if not found or linked
+ */
+int fzz_graphInputIndex(TFzzGraph* graph, const char* name);
+
+/**
+ * @brief Returns index of graph output
+ * @param graph graph of fuzzy systems
+ * @param name output written as "node.output"
+ * @return index in output array of graph, -1 if not found
+ */
+int fzz_graphOutputIndex(TFzzGraph* graph, const char* name);
+
+/**
+ * @brief Calculates outputs of all nodes of graph
+ * Nodes are evaluated in order of levels, level of node is one 
+ * above the highest level of nodes linked to its inputs
+ * @param graph graph of fuzzy systems
+ * @param input array of graph input values
+ * @param output array for calculated graph outputs
+ */
+void fzz_calculateGraph(TFzzGraph* graph, const double* input, double* output);
+
+/**
+ * @brief Calculates outputs of all nodes of graph in parallel
+ * Independent nodes of the same level are evaluated by workers of pool,
+ * levels are separated by waiting for all workers, so it pays off for
+ * wide levels of large systems only; results are the same 
+ * as from fzz_calculateGraph
+ * @param graph graph of fuzzy systems
+ * @param pool pool of worker threads
+ * @param input array of graph input values
+ * @param output array for calculated graph outputs
+ */
+void fzz_calculateGraphPool(TFzzGraph* graph, TFzzPool* pool, const double* input, double* output);
+
+///////////////////////////////////////////////////
+//////// Shared system functions //////////////////
+///////////////////////////////////////////////////
+
+/*
+ * Shared system publishes complete fuzzy system to reader threads. 
+ * Readers calculate outputs of published system without locks, new 
+ * system is published by atomic exchange and readers take it by their 
+ * next calculation; every reader pins system it calculates, replaced 
+ * system is released when no reader pins it (when next system is 
+ * published or reader is destroyed). Published system is read only,
+ * new system is built separately (e.g. by fzz_parseModelEx or 
+ * fzz_loadSystemEx) and it must have the same inputs and outputs.
+ */
+
+/**
+ * @brief Creates shared fuzzy system
+ * @param sys fuzzy system, owned by shared system since then
+ * @return created shared system
+ */
+TFzzShared* fzz_createShared(TFzzSystem* sys);
+
+/**
+ * @brief Releases shared system and all its fuzzy systems
+ * @param shared shared system without readers
+ */
+void fzz_destroyShared(TFzzShared* shared);
+
+/**
+ * @brief Publishes new fuzzy system, it replaces current system
+ * Writers are serialized, readers are never blocked
+ * @param shared shared system
+ * @param sys new fuzzy system, owned by shared system since then
+ */
+void fzz_publishShared(TFzzShared* shared, TFzzSystem* sys);
+
+/**
+ * @brief Creates reader of shared system
+ * @param shared shared system
+ * @return created reader, used by one thread at once
+ */
+TFzzReader* fzz_createReader(TFzzShared* shared);
+
+/**
+ * @brief Releases reader and unpins its system
+ * @param reader released reader
+ */
+void fzz_destroyReader(TFzzReader* reader);
+
+/**
+ * @brief Calculates outputs of current system of shared system
+ * Context of reader is created again by the first calculation after
+ * new system was published, other calculations do not allocate memory
+ * @see fzz_calculateOutputEx
+ * @param reader reader of shared system
+ * @param input array of input values
+ * @param output array for calculated outputs
+ */
+void fzz_calculateOutputShared(TFzzReader* reader, const double* input, double* output);
+
+///////////////////////////////////////////////////
+//////// GPU functions ////////////////////////////
+///////////////////////////////////////////////////
+
+/*
+ * GPU backend calculates large batches of inputs by OpenCL kernel, 
+ * library has to be compiled with FZZ_OPENCL and linked with OpenCL 
+ * library (otherwise fzz_createGpu returns NULL). Model of system is 
+ * uploaded once, inputs are streamed in chunks, transfer of the next 
+ * chunk overlaps calculation of the previous one. Sugeno outputs and 
+ * weighted average are calculated the same way as on CPU, center of 
+ * gravity and bisector are integrated by GPU_SAMPLES midpoints of 
+ * fired range of output, which is close to FZZ_COG_EXACT. Systems 
+ * with FZZ_MOM output or singleton output fuzzy sets (except of 
+ * weighted average) are not supported; NULL returned by fzz_createGpu 
+ * means that batch has to be calculated on CPU (fzz_calculateBatchEx).
+ */
+
+/**
+ * @brief Creates GPU backend of fuzzy system and uploads its model
+ * GPU is preferred, other OpenCL device is used if there is no GPU;
+ * double precision needs device with cl_khr_fp64
+ * @param sys fuzzy system, not modified while backend exists
+ * @return created backend, NULL if system or device is not supported
+ */
+TFzzGpu* fzz_createGpu(const TFzzSystem* sys);
+
+/**
+ * @brief Releases GPU backend
+ * @param gpu released backend (can be NULL)
+ */
+void fzz_destroyGpu(TFzzGpu* gpu);
+
+/**
+ * @brief Calculates outputs of batch of inputs on GPU
+ * @see fzz_calculateBatchEx
+ * @param gpu GPU backend
+ * @param count number of input vectors
+ * @param inputs input vectors (count*inLen values)
+ * @param outputs calculated output vectors (count*outLen values)
+ * @return 0 on success, -1 on OpenCL error
+ */
+int fzz_calculateBatchGpu(TFzzGpu* gpu, int count, const double* inputs, double* outputs);
+
+///////////////////////////////////////////////////
+//////// Vector instructions //////////////////////
+///////////////////////////////////////////////////
+
+/*
+ * On x86-64 library is built with all versions of fuzzification
+ * (SSE2, AVX2 and AVX-512) and the best one supported by processor is
+ * chosen when library is loaded, hot loops of defuzzification are
+ * cloned for the same instruction sets (with GCC on Linux). Library
+ * compiled with FZZ_NO_DISPATCH uses only instructions enabled for
+ * compiler, FZZ_NO_SIMD (or FZZ_FLOAT) disables vector fuzzification.
+ * All versions calculate the same outputs (unless compiler fuses 
+ * multiply-add in scalar code, e.g. with -march=native).
+ */
+
+/**
+ * @brief Returns vector instructions used for fuzzification
+ * @return "avx512", "avx2", "sse2", "neon" or "none" (scalar code)
+ */
+const char* fzz_simd();
+
+/**
+ * @brief Sets vector instructions used for fuzzification
+ * Intended for tests and benchmarks of versions of fuzzification,
+ * must not be called during calculation of outputs
+ * @param name name of instructions (as returned by fzz_simd)
+ * @return 0 on success, -1 if instructions are not supported
+ */
+int fzz_setSimd(const char* name);
+
+///////////////////////////////////////////////////
+//////// Stage functions //////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Fuzzyfication stage of fzz_calculateOutputEx
+ * Stages are called in order fzz_fuzzifyEx, fzz_inferEx and
+ * fzz_defuzzifyEx, results are passed in context, lookup table
+ * of baked system is not used; intended for profiling
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ * @param input array of input values (one per system input)
+ */
+void fzz_fuzzifyEx(const TFzzSystem* sys, TFzzContext* ctx, const double* input);
+
+/**
+ * @brief Inferential mechanism stage of fzz_calculateOutputEx
+ * @see fzz_fuzzifyEx
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ */
+void fzz_inferEx(const TFzzSystem* sys, TFzzContext* ctx);
+
+/**
+ * @brief Defuzzyfication stage of fzz_calculateOutputEx
+ * @see fzz_fuzzifyEx
+ * @param sys fuzzy system
+ * @param ctx context of calculation
+ * @param output array for calculated outputs (one per system output)
+ */
+void fzz_defuzzifyEx(const TFzzSystem* sys, TFzzContext* ctx, double* output);
+
 ///////////////////////////////////////////////////
 //////// Support functions ////////////////////////
 ///////////////////////////////////////////////////
@@ -134,24 +1133,156 @@ void fzz_printRules();
  */
 void fzz_printSystem();
 
+/**
+ * @brief Prints trace of recent calculations of default fuzzy system to console
+ * @see fzz_setStats
+ */
+void fzz_printTrace();
+
+/**
+ * @brief Prints input set of fuzzy sets of given system to console
+ * @param sys fuzzy system
+ * @param index index of input set of fuzzy sets
+ */
+void fzz_printInputSetEx(const TFzzSystem* sys, int index);
+
+/**
+ * @brief Prints output set of fuzzy sets of given system to console
+ * @param sys fuzzy system
+ * @param index index of output set of fuzzy sets
+ */
+void fzz_printOutputSetEx(const TFzzSystem* sys, int index);
+
+/**
+ * @brief Prints list of inferential mechanism rules of given system to console
+ * @param sys fuzzy system
+ */
+void fzz_printRulesEx(const TFzzSystem* sys);
+
+/**
+ * @brief Prints info about entire given fuzzy system to console
+ * @param sys fuzzy system
+ */
+void fzz_printSystemEx(const TFzzSystem* sys);
+
+/**
+ * @brief Prints trace of recent calculations of context to console
+ * Calculations are printed from the oldest one
+ * @param ctx context with enabled trace
+ */
+void fzz_printTraceEx(const TFzzContext* ctx);
+
+/**
+ * @brief Saves default fuzzy system to binary file
+ * @see fzz_saveSystemEx
+ * @param file path of file
+ * @return 0 on success, -1 if file can not be written
+ */
+int fzz_saveSystem(const char* file);
+
+/**
+ * @brief Replaces default fuzzy system by system loaded from binary file
+ * @see fzz_loadSystemEx
+ * @param file path of file
+ * @return 0 on success, -1 if file can not be loaded (default system is kept)
+ */
+int fzz_loadSystem(const char* file);
+
+/**
+ * @brief Saves compiled fuzzy system to binary file
+ * File holds membership functions, compiled rules, rule index and lookup
+ * table of baked system; it is saved in native byte order and layout
+ * with version and checksum in header, so it can be loaded only 
+ * by the same library build on the same platform
+ * @param sys fuzzy system
+ * @param file path of file
+ * @return 0 on success, -1 if file can not be written or rules wait for 
+ * names of fuzzy sets (see fzz_initInputFcns)
+ */
+int fzz_saveSystemEx(const TFzzSystem* sys, const char* file);
+
+/**
+ * @brief Loads fuzzy system saved by fzz_saveSystemEx
+ * File is memory mapped (read to memory where mapping is not available)
+ * and system data point directly to it, rules are not parsed again.
+ * Loaded system is read only, it can not be modified, baked or unbaked.
+ * @param file path of file
+ * @return loaded fuzzy system (released by fzz_destroy), NULL if file 
+ * can not be read, has different version or platform or is damaged
+ */
+TFzzSystem* fzz_loadSystemEx(const char* file);
+
+/**
+ * @brief Replaces default fuzzy system by system loaded from model file
+ * @see fzz_loadModelEx
+ * @param file path of model file
+ * @return 0 on success, -1 if model can not be loaded (default system is kept)
+ */
+int fzz_loadModel(const char* file);
+
+/**
+ * @brief Creates fuzzy system described by model file
+ * Model is processed in one pass, line by line. Every line holds one
+ * declaration, words are separated by spaces or tabs, # starts comment:
+ *   system <number of inputs> <number of outputs>
+ *   input <name> <number of fuzzy sets>
+ *   output <name> <number of fuzzy sets> [cog_step | cog_exact | mom | bisector | weighted_average]
+ *   set <name> <left> <top> <right>
+ *   set <name> <triangle | trapezoid | left_shoulder | right_shoulder | gaussian | singleton> <parameters>
+ *   operators <and> <or> <implication> <aggregation>
+ *   realtime <samples>
+ *   rule <rule in syntax of fzz_addRule>
+ * System has to be declared first, inputs and outputs are numbered in
+ * order of declaration and set lines following input or output declare
+ * its fuzzy sets (triangle when shape is omitted, parameters of shapes
+ * are listed by TFzzShape); operators are min, product, max, probor 
+ * or bounded_sum (see fzz_setOperators), realtime sets real-time mode
+ * (see fzz_setRealtime); length of names and lines 
+ * is not limited
+ * @param file path of model file
+ * @param line line of error, 0 on success (output, can be NULL)
+ * @param error description of error, NULL on success (output, can be NULL)
+ * @return created fuzzy system, NULL if model is invalid
+ */
+TFzzSystem* fzz_loadModelEx(const char* file, int* line, const char** error);
+
+/**
+ * @brief Creates fuzzy system described by model text
+ * @see fzz_loadModelEx
+ * @param text model text
+ * @param line line of error, 0 on success (output, can be NULL)
+ * @param error description of error, NULL on success (output, can be NULL)
+ * @return created fuzzy system, NULL if model is invalid
+ */
+TFzzSystem* fzz_parseModelEx(const char* text, int* line, const char** error);
+
 ///////////////////////////////////////////////////
 //////// Tests ////////////////////////////////////
 ///////////////////////////////////////////////////
 
 /**
  * @brief First output calculation test 
- * Note: test is not automated
+ * Note: test is not automated, its system is checked against golden 
+ * surface by test.c (make test)
  */
 void fzz_test1();
 
 /**
  * @brief Second output calculation test 
- * Note: test is not automated
+ * Note: test is not automated, its system is checked against golden 
+ * surface by test.c (make test)
  */
 void fzz_test2();
 
 /**
  * @brief Third output calculation test 
- * Note: test is not automated
+ * Note: test is not automated, its system is checked against golden 
+ * surface by test.c (make test)
  */
 void fzz_test3();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
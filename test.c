@@ -0,0 +1,1287 @@
+/*
+ * This file is part of FuzzyLibrary thats implements common fuzzy system.
+ * Copyright (C) 2014, Petr Kačer <kacerpetr@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief Automated regression and accuracy test of fzzlib library
+ * Golden surfaces are outputs of systems of fzz_test1, fzz_test2,
+ * fzz_test3 and of main.c example in grids of inputs calculated by
+ * FZZ_COG_STEP, every engine is compared with them with its own
+ * tolerance (every supported version of vector fuzzification too).
+ * Random models compare engines with each other, graph, shared system
+ * and training are checked against direct calculation, invalid models
+ * and corrupted saved systems have to be rejected. Prints
+ * one line per check and returns nonzero if any check failed; usage:
+ * test_double [--update] [golden file], --update writes golden surfaces
+ * (make test builds and runs double, native vector, float and library
+ * variants)
+ */
+
+///////////////////////////////////////////////////
+//////// Includes /////////////////////////////////
+///////////////////////////////////////////////////
+
+#include "fzzlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//readers of shared system calculate in threads (as pool of fzzlib)
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(FZZ_NO_THREADS)
+#include <pthread.h>
+#define TEST_THREADS
+#endif
+
+///////////////////////////////////////////////////
+//////// Defines //////////////////////////////////
+///////////////////////////////////////////////////
+
+#define GOLDEN_FILE "test_golden.txt"
+#define SAVED_FILE "test_system.fzb"
+#define FUZZ_MODELS 300
+#define FUZZ_SAMPLES 400
+#define POOL_THREADS 4
+#define LUT_RESOLUTION 257
+#define REALTIME_SAMPLES 101
+#define SHARED_READERS 4
+#define SHARED_ROUNDS 20
+#define SHARED_PUBLISHES 200
+#define TRAIN_SAMPLES 101
+#define FUZZ_ENGINES 8
+#define SIMD_LEVELS 5
+
+/**
+ * @brief Layout of saved system file (see TFileHeader in fzzlib.c)
+ * Corrupted files get valid checksum, FNV-1a of data after header
+ * and then of header with zero checksum
+ */
+#define FILE_HEADER_SIZE 72
+#define FILE_CHECKSUM_OFFSET 20
+#define FILE_CORRUPTIONS 7
+
+/**
+ * @brief Worst case operations of loaded corrupted system which is still calculated
+ */
+#define WORST_CASE_LIMIT 1000000
+
+/**
+ * @brief Tolerances of engines against golden surfaces
+ * Engines calculating the same center of gravity differ only by
+ * rounding (single precision build rounds more), exact center of
+ * gravity differs by integration error of FZZ_COG_STEP, lookup table
+ * by interpolation, fixed point and real-time mode by sampling of 
+ * output (see fzz_compileFixed and fzz_setRealtime); GPU samples fired
+ * range of output
+ */
+#ifdef FZZ_FLOAT
+#define TOL_SAME 1e-4
+#else
+#define TOL_SAME 1e-9
+#endif
+#define TOL_EXACT 1e-3
+#define TOL_LUT 1e-2
+#define TOL_FIXED 5e-3
+#define TOL_REALTIME 5e-3
+#define TOL_GPU 1e-3
+#define TOL_FUZZ_EXACT 2e-2
+
+/**
+ * @brief Versions of vector fuzzification give the same values
+ * Not when compiler fuses multiply-add (scalar and vector code are
+ * rounded differently), golden surfaces still check them
+ */
+#ifdef __FMA__
+#define SIMD_EXACT 0
+#else
+#define SIMD_EXACT 1
+#endif
+
+///////////////////////////////////////////////////
+//////// Data types ///////////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief System with golden surface
+ * Inputs are sampled in grid, every input from from[i] by step[i]
+ * in steps[i] points
+ */
+typedef struct{
+    const char* name;
+    const char* model;
+    int inputs;
+    int outputs;
+    double from[2];
+    double step[2];
+    int steps[2];
+}TTestSurface;
+
+/**
+ * @brief Reader thread of shared system
+ * Every output has to be output of one of published systems
+ */
+typedef struct{
+    TFzzShared* shared;
+    const double* inputs;
+    const double* first;
+    const double* second;
+    int points;
+    int failed;
+}TTestReader;
+
+///////////////////////////////////////////////////
+//////// Global variables /////////////////////////
+///////////////////////////////////////////////////
+
+//pseudo random generator state
+unsigned int testSeed = 12345;
+
+//number of failed checks
+int testFailures = 0;
+
+//number of readers of shared system which finished calculation
+int testReadersDone = 0;
+
+//names of shapes and operators in model file
+const char* testShapeNames[] = {"triangle", "trapezoid", "left_shoulder", "right_shoulder", "gaussian", "singleton"};
+const char* testOperatorNames[] = {"min", "product", "max", "probor", "bounded_sum"};
+const char* testDefuzzNames[] = {"cog_step", "cog_exact", "mom", "bisector", "weighted_average"};
+
+//vector instructions of fuzzification, unsupported ones are skipped
+const char* testSimdNames[] = {"none", "sse2", "avx2", "avx512", "neon"};
+
+//engines compared on random models with FZZ_COG_STEP calculation and their results
+const char* testFuzzEngines[] = {"update", "output_for", "batch", "pool", "saved", "optimized", "cog_exact", "simd"};
+const double testFuzzTolerances[] = {0, 0, 0, 0, 0, 0, TOL_FUZZ_EXACT, 0};
+double testFuzzErrors[FUZZ_ENGINES];
+int testFuzzValues[FUZZ_ENGINES];
+int testFuzzUndefined[FUZZ_ENGINES];
+
+//systems of fzz_test1, fzz_test2, fzz_test3 and main.c example
+const TTestSurface testSurfaces[] = {
+    {"test1",
+     "system 1 1\n"
+     "input input 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "output output 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "rule if input is negative then output is pozitive\n"
+     "rule if input is zero then output is zero\n"
+     "rule if input is pozitive then output is negative\n",
+     1, 1, {-2.5, 0}, {0.01, 0}, {501, 1}},
+    {"test2",
+     "system 1 2\n"
+     "input input 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "output output1 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "output output2 3\n"
+     "set negative -4 -2 0\nset zero -2 0 2\nset pozitive 0 2 4\n"
+     "rule if input is negative then output1 is pozitive\n"
+     "rule if input is zero then output1 is zero\n"
+     "rule if input is pozitive then output1 is negative\n"
+     "rule if input is negative then output2 is negative\n"
+     "rule if input is zero then output2 is negative\n"
+     "rule if input is pozitive then output2 is pozitive\n",
+     1, 2, {-2.5, 0}, {0.01, 0}, {501, 1}},
+    {"test3",
+     "system 2 1\n"
+     "input input1 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "input input2 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "output output 3\n"
+     "set negative -2 -1 0\nset zero -1 0 1\nset pozitive 0 1 2\n"
+     "rule if input1 is negative and input2 is negative then output is negative\n"
+     "rule if input1 is negative and input2 is zero then output is negative\n"
+     "rule if input1 is negative and input2 is pozitive then output is zero\n"
+     "rule if input1 is zero and input2 is negative then output is negative\n"
+     "rule if input1 is zero and input2 is zero then output is zero\n"
+     "rule if input1 is zero and input2 is pozitive then output is pozitive\n"
+     "rule if input1 is pozitive and input2 is negative then output is zero\n"
+     "rule if input1 is pozitive and input2 is zero then output is pozitive\n"
+     "rule if input1 is pozitive and input2 is pozitive then output is pozitive\n",
+     2, 1, {-1.5, -1.5}, {0.05, 0.05}, {61, 61}},
+    {"example",
+     "system 2 1\n"
+     "input distance 3\n"
+     "set small -0.5 0 0.5\nset medium 0 0.5 1\nset big 0.5 1 1.5\n"
+     "input speed 3\n"
+     "set slow -1 0 1\nset medium 0 1 2\nset fast 1 2 3\n"
+     "output throttle 5\n"
+     "set negativeBig -1.5 -1 -0.5\nset negative -1 -0.5 0\nset zero -0.5 0 0.5\n"
+     "set pozitive 0 0.5 1\nset pozitiveBig 0.5 1 1.5\n"
+     "rule if distance is small and speed is slow then throttle is zero\n"
+     "rule if distance is small and speed is medium then throttle is negative\n"
+     "rule if distance is small and speed is fast then throttle is negativeBig\n"
+     "rule if distance is medium and speed is slow then throttle is pozitive\n"
+     "rule if distance is medium and speed is medium then throttle is zero\n"
+     "rule if distance is medium and speed is fast then throttle is negative\n"
+     "rule if distance is big and speed is slow then throttle is pozitiveBig\n"
+     "rule if distance is big and speed is medium then throttle is pozitive\n"
+     "rule if distance is big and speed is fast then throttle is zero\n",
+     2, 1, {-0.75, -1.5}, {0.05, 0.1}, {51, 46}}
+};
+
+//invalid models and lines of their errors
+const char* testMalformedModels[] = {
+    "system 1 1\ninput a 1\nset x 0 1 2\nrule if a is x then o is y\n",
+    "system 1 1\nrule if a is x then o is y\n",
+    "system 2 1\ninput a 1\nset x 0 1 2\noutput o 1\nset y 0 1 2\nrule if a is x then o is y\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 2\nset y 0 1 2\nrule if a is x then o is y\n",
+    "",
+    "input a 1\n",
+    "system 0 1\n",
+    "system 1 1\nsystem 1 1\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\ninput b 1\n",
+    "system 1 1\ninput a 2\nset x 0 1 2\noutput o 1\n",
+    "system 1 1\ninput a 1\nset x 2 1 0\n",
+    "system 1 1\ninput a 1\nset x 0 nan 2\n",
+    "system 1 1\ninput a 1\nset x circle 0 1 2\n",
+    "system 1 1\ninput a 1\nset x 0 1\n",
+    "system 1 1\ninput a 1\nset x 0 1 2 3\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 1 centroid\n",
+    "system 1 1\noperators min max min\n",
+    "system 1 1\noperators max min min max\n",
+    "system 1 1\nrealtime 1\n",
+    "system 1 1\nunknown\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 1\nset y 0 1 2\nrule if a is z then o is y\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 1\nset y 0 1 2\nrule if b is x then o is y\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 1\nset y 0 1 2\nrule if a is x\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\n",
+    "system 1 1\ninput a 1\nset x 0 1 2\noutput o 2\nset y 0 1 2\n"
+};
+const int testMalformedLines[] = {4, 2, 6, 6, 1, 1, 1, 2, 4, 4, 3, 3, 3, 3, 3, 4, 2, 2, 2, 2, 6, 6, 6, 4, 6};
+
+///////////////////////////////////////////////////
+//////// Functions ////////////////////////////////
+///////////////////////////////////////////////////
+
+/**
+ * @brief Deterministic pseudo random number generator
+ * @return number in range <0, 1)
+ */
+double testRandom(){
+    testSeed = testSeed*1103515245u + 12345u;
+    return (double)((testSeed >> 8) & 0xFFFFFF) / 16777216.0;
+}
+
+/**
+ * @brief Creates fuzzy system from model text
+ * @param model model text
+ * @return created fuzzy system
+ */
+TFzzSystem* testParse(const char* model){
+    TFzzSystem* sys = NULL;
+    const char* error = NULL;
+    int line = 0;
+
+    sys = fzz_parseModelEx(model, &line, &error);
+    if(sys == NULL){
+        fprintf(stderr, "Invalid model (%s on line %d):\n%s", error, line, model);
+        exit(2);
+    }
+    return sys;
+}
+
+/**
+ * @brief Calculates batch of inputs in temporary context
+ * @param sys fuzzy system
+ * @param count number of input vectors
+ * @param inputs input vectors
+ * @param outputs calculated output vectors
+ */
+void testBatch(const TFzzSystem* sys, int count, const double* inputs, double* outputs){
+    TFzzContext* ctx = fzz_createContext(sys);
+
+    fzz_calculateBatchEx(sys, ctx, count, inputs, outputs);
+    fzz_destroyContext(ctx);
+}
+
+/**
+ * @brief Number of points of grid of golden surface
+ * @param surface golden surface
+ * @return number of input vectors
+ */
+int testPoints(const TTestSurface* surface){
+    return surface->steps[0]*surface->steps[1];
+}
+
+/**
+ * @brief Input vectors of grid of golden surface
+ * Points are computed from indexes, so they do not accumulate error
+ * @param surface golden surface
+ * @return allocated input vectors
+ */
+double* testGrid(const TTestSurface* surface){
+    double* inputs = (double*)malloc(sizeof(double)*testPoints(surface)*surface->inputs);
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    for(i = 0; i < surface->steps[0]; i++){
+        for(j = 0; j < surface->steps[1]; j++, k++){
+            inputs[k*surface->inputs] = surface->from[0] + i*surface->step[0];
+            if(surface->inputs > 1) inputs[k*surface->inputs + 1] = surface->from[1] + j*surface->step[1];
+        }
+    }
+    return inputs;
+}
+
+/**
+ * @brief Maximal difference of values of engine from reference values
+ * Undefined value (NaN, no rule fired) has to be undefined in both
+ * @param reference reference values
+ * @param values values of engine
+ * @param count number of values
+ * @param undefined number of values defined only in one of them (output)
+ * @param worst index of value with maximal difference (output)
+ * @return maximal absolute difference
+ */
+double testError(const double* reference, const double* values, int count, int* undefined, int* worst){
+    double error = 0;
+    int i = 0;
+
+    *undefined = 0;
+    *worst = -1;
+    for(i = 0; i < count; i++){
+        if(isnan(reference[i]) || isnan(values[i])){
+            if(isnan(reference[i]) != isnan(values[i])){
+                if(*undefined == 0 && error == 0) *worst = i;
+                (*undefined)++;
+            }
+            continue;
+        }
+        if(fabs(reference[i] - values[i]) > error){
+            error = fabs(reference[i] - values[i]);
+            *worst = i;
+        }
+    }
+    return error;
+}
+
+/**
+ * @brief Reports result of check
+ * @param surface name of surface or group of checks
+ * @param engine name of engine
+ * @param count number of compared values
+ * @param error maximal absolute difference
+ * @param undefined number of values defined only by reference or engine
+ * @param tolerance maximal allowed difference
+ * @return 1 if check passed, 0 otherwise (counted as failure)
+ */
+int testReport(const char* surface, const char* engine, int count, double error, int undefined, double tolerance){
+    int ok = error <= tolerance && undefined == 0;
+
+    printf("%-8s %-12s values %7d max error %.3e tolerance %.0e undefined mismatch %d %s\n",
+           surface, engine, count, error, tolerance, undefined, ok ? "ok" : "FAILED");
+    if(!ok) testFailures++;
+    return ok;
+}
+
+/**
+ * @brief Reports result of check which does not compare values
+ * @param surface name of surface or group of checks
+ * @param engine name of engine
+ * @param count number of cases
+ * @param failed number of failed cases
+ * @return 1 if check passed, 0 otherwise (counted as failure)
+ */
+int testReportCases(const char* surface, const char* engine, int count, int failed){
+    printf("%-8s %-12s cases  %7d failed %d %s\n", surface, engine, count, failed, failed == 0 ? "ok" : "FAILED");
+    if(failed != 0) testFailures++;
+    return failed == 0;
+}
+
+/**
+ * @brief Compares values of engine with golden values and reports it
+ * @param surface name of golden surface
+ * @param engine name of engine
+ * @param golden golden values
+ * @param values values of engine
+ * @param count number of values
+ * @param tolerance maximal absolute difference
+ */
+void testCompare(const char* surface, const char* engine, const double* golden, const double* values, int count, double tolerance){
+    int undefined = 0;
+    int worst = 0;
+    double error = testError(golden, values, count, &undefined, &worst);
+
+    if(!testReport(surface, engine, count, error, undefined, tolerance))
+        printf("    worst value %d: %.12g expected %.12g\n", worst, values[worst], golden[worst]);
+}
+
+/**
+ * @brief Writes golden surfaces calculated by FZZ_COG_STEP
+ * @param file path of golden file
+ * @return 0 on success, -1 if file can not be written
+ */
+int testUpdate(const char* file){
+    const TTestSurface* surface = NULL;
+    TFzzSystem* sys = NULL;
+    TFzzContext* ctx = NULL;
+    FILE* f = NULL;
+    double* inputs = NULL;
+    double output[2];
+    int s = 0;
+    int i = 0;
+    int j = 0;
+
+    f = fopen(file, "w");
+    if(f == NULL) return -1;
+    fprintf(f, "# golden surfaces of fzzlib (FZZ_COG_STEP), written by test --update\n");
+    for(s = 0; s < (int)(sizeof(testSurfaces)/sizeof(testSurfaces[0])); s++){
+        surface = &testSurfaces[s];
+        sys = testParse(surface->model);
+        ctx = fzz_createContext(sys);
+        inputs = testGrid(surface);
+        fprintf(f, "surface %s %d\n", surface->name, testPoints(surface));
+        for(i = 0; i < testPoints(surface); i++){
+            fzz_calculateOutputEx(sys, ctx, inputs + i*surface->inputs, output);
+            for(j = 0; j < surface->inputs; j++) fprintf(f, "%.12g ", inputs[i*surface->inputs + j]);
+            for(j = 0; j < surface->outputs; j++) fprintf(f, j + 1 < surface->outputs ? "%.12g " : "%.12g\n", output[j]);
+        }
+        free(inputs);
+        fzz_destroyContext(ctx);
+        fzz_destroy(sys);
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @brief Reads golden surface from golden file
+ * @param f opened golden file, positioned before surface
+ * @param surface expected surface
+ * @return allocated outputs of surface, NULL if file does not match
+ */
+double* testReadGolden(FILE* f, const TTestSurface* surface){
+    double* inputs = testGrid(surface);
+    double* golden = (double*)malloc(sizeof(double)*testPoints(surface)*surface->outputs);
+    char line[256];
+    char name[64];
+    double value = 0;
+    int points = 0;
+    int i = 0;
+    int j = 0;
+
+    //header of surface (comments are skipped)
+    do{
+        if(fgets(line, sizeof(line), f) == NULL) line[0] = '\0';
+    }while(line[0] == '#');
+    if(sscanf(line, "surface %63s %d", name, &points) != 2 || strcmp(name, surface->name) != 0 || points != testPoints(surface)){
+        free(inputs);
+        free(golden);
+        return NULL;
+    }
+
+    //inputs have to match grid
+    for(i = 0; i < points; i++){
+        for(j = 0; j < surface->inputs; j++){
+            if(fscanf(f, "%lf", &value) != 1 || fabs(value - inputs[i*surface->inputs + j]) > 1e-9){
+                free(inputs);
+                free(golden);
+                return NULL;
+            }
+        }
+        for(j = 0; j < surface->outputs; j++){
+            if(fscanf(f, "%63s", name) != 1){
+                free(inputs);
+                free(golden);
+                return NULL;
+            }
+            golden[i*surface->outputs + j] = strtod(name, NULL);
+        }
+    }
+    fgets(line, sizeof(line), f);
+    free(inputs);
+    return golden;
+}
+
+/**
+ * @brief Compares every engine with golden surface
+ * @param surface golden surface
+ * @param golden golden outputs
+ */
+void testSurface(const TTestSurface* surface, const double* golden){
+    int points = testPoints(surface);
+    int values = points*surface->outputs;
+    TFzzSystem* sys = testParse(surface->model);
+    TFzzSystem* loaded = NULL;
+    TFzzContext* ctx = fzz_createContext(sys);
+    TFzzPool* pool = NULL;
+    TFzzGpu* gpu = NULL;
+    double* inputs = testGrid(surface);
+    double* outputs = (double*)malloc(sizeof(double)*values);
+    const char* simd = fzz_simd();
+    char engine[32];
+    double nanInputs[4];
+    double nanOutputs[4];
+    short fixedIn[2];
+    short fixedOut[2];
+    int i = 0;
+    int j = 0;
+
+    //single calculation
+    for(i = 0; i < points; i++) fzz_calculateOutputEx(sys, ctx, inputs + i*surface->inputs, outputs + i*surface->outputs);
+    testCompare(surface->name, "calculate", golden, outputs, values, TOL_SAME);
+
+    //incremental calculation, neighbouring points of grid share inputs
+    for(i = 0; i < points; i++) fzz_updateOutputEx(sys, ctx, inputs + i*surface->inputs, outputs + i*surface->outputs);
+    testCompare(surface->name, "update", golden, outputs, values, TOL_SAME);
+
+    //selected output
+    for(i = 0; i < points; i++)
+        for(j = 0; j < surface->outputs; j++)
+            outputs[i*surface->outputs + j] = fzz_calculateOutputForEx(sys, ctx, inputs + i*surface->inputs, j);
+    testCompare(surface->name, "output_for", golden, outputs, values, TOL_SAME);
+
+    //batch and parallel batch
+    fzz_calculateBatchEx(sys, ctx, points, inputs, outputs);
+    testCompare(surface->name, "batch", golden, outputs, values, TOL_SAME);
+    pool = fzz_createPool(POOL_THREADS);
+    fzz_calculateBatchPoolEx(sys, pool, points, inputs, outputs);
+    testCompare(surface->name, "pool", golden, outputs, values, TOL_SAME);
+    fzz_destroyPool(pool);
+
+    //every supported version of fuzzification
+    for(i = 0; i < SIMD_LEVELS; i++){
+        if(fzz_setSimd(testSimdNames[i]) != 0) continue;
+        fzz_calculateBatchEx(sys, ctx, points, inputs, outputs);
+        sprintf(engine, "simd_%s", testSimdNames[i]);
+        testCompare(surface->name, engine, golden, outputs, values, TOL_SAME);
+    }
+    fzz_setSimd(simd);
+
+    //saved and loaded system
+    if(fzz_saveSystemEx(sys, SAVED_FILE) == 0 && (loaded = fzz_loadSystemEx(SAVED_FILE)) != NULL){
+        testBatch(loaded, points, inputs, outputs);
+        testCompare(surface->name, "saved", golden, outputs, values, TOL_SAME);
+        fzz_destroy(loaded);
+    }else{
+        printf("%-8s %-12s FAILED (system can not be saved and loaded)\n", surface->name, "saved");
+        testFailures++;
+    }
+    remove(SAVED_FILE);
+
+    //fixed point
+    fzz_compileFixedEx(sys);
+    for(i = 0; i < points; i++){
+        for(j = 0; j < surface->inputs; j++) fixedIn[j] = fzz_inputToFixedEx(sys, j, inputs[i*surface->inputs + j]);
+        fzz_calculateFixedEx(sys, ctx, fixedIn, fixedOut);
+        for(j = 0; j < surface->outputs; j++) outputs[i*surface->outputs + j] = fzz_outputFromFixedEx(sys, j, fixedOut[j]);
+    }
+    testCompare(surface->name, "fixed", golden, outputs, values, TOL_FIXED);
+    if(fzz_inputToFixedEx(sys, 0, NAN) != 0 || fzz_inputToFixedEx(sys, 0, -INFINITY) != 0 || fzz_inputToFixedEx(sys, 0, INFINITY) != 32767){
+        printf("%-8s %-12s FAILED (input out of range is not saturated)\n", surface->name, "fixed");
+        testFailures++;
+    }
+
+    //lookup table, input which is not a number gives the same outputs as 
+    //without table (every input in turn)
+    for(i = 0; i < surface->inputs; i++)
+        for(j = 0; j < surface->inputs; j++) nanInputs[i*surface->inputs + j] = i == j ? NAN : surface->from[j];
+    fzz_calculateBatchEx(sys, ctx, surface->inputs, nanInputs, nanOutputs);
+    fzz_bakeEx(sys, LUT_RESOLUTION);
+    fzz_calculateBatchEx(sys, ctx, points, inputs, outputs);
+    testCompare(surface->name, "lut", golden, outputs, values, TOL_LUT);
+    fzz_calculateBatchEx(sys, ctx, surface->inputs, nanInputs, outputs);
+    testCompare(surface->name, "lut_nan", nanOutputs, outputs, surface->inputs*surface->outputs, 0);
+    fzz_unbakeEx(sys);
+
+    //real-time mode, fixed number of samples of every output
+    fzz_setRealtimeEx(sys, REALTIME_SAMPLES);
+    fzz_destroyContext(ctx);
+    ctx = fzz_createContext(sys);
+    for(i = 0; i < points; i++) fzz_calculateOutputEx(sys, ctx, inputs + i*surface->inputs, outputs + i*surface->outputs);
+    testCompare(surface->name, "realtime", golden, outputs, values, TOL_REALTIME);
+    fzz_calculateBatchEx(sys, ctx, points, inputs, outputs);
+    testCompare(surface->name, "rt_batch", golden, outputs, values, TOL_REALTIME);
+    fzz_setRealtimeEx(sys, 0);
+
+    //exact center of gravity
+    for(j = 0; j < surface->outputs; j++) fzz_setDefuzzMethodEx(sys, j, FZZ_COG_EXACT);
+    fzz_destroyContext(ctx);
+    ctx = fzz_createContext(sys);
+    fzz_calculateBatchEx(sys, ctx, points, inputs, outputs);
+    testCompare(surface->name, "cog_exact", golden, outputs, values, TOL_EXACT);
+
+    //GPU (only when library is built with OpenCL and device is present)
+    gpu = fzz_createGpu(sys);
+    if(gpu != NULL){
+        if(fzz_calculateBatchGpu(gpu, points, inputs, outputs) == 0){
+            testCompare(surface->name, "gpu", golden, outputs, values, TOL_GPU);
+        }else{
+            printf("%-8s %-12s FAILED (OpenCL error)\n", surface->name, "gpu");
+            testFailures++;
+        }
+        fzz_destroyGpu(gpu);
+    }
+
+    free(inputs);
+    free(outputs);
+    fzz_destroyContext(ctx);
+    fzz_destroy(sys);
+}
+
+/**
+ * @brief Writes random fuzzy set to model text
+ * @param text model text
+ * @param name name of fuzzy set
+ * @param center center of fuzzy set
+ * @param width half of width of fuzzy set
+ * @param singletons 1 if singleton can be chosen
+ * @return number of written characters
+ */
+int testRandomSet(char* text, int name, double center, double width, int singletons){
+    int shape = (int)(testRandom()*(singletons ? 6 : 5));
+    double a = center - width*(0.6 + 0.6*testRandom());
+    double b = center + width*(0.6 + 0.6*testRandom());
+
+    //triangle is the most common shape
+    if(testRandom() < 0.4) shape = 0;
+    switch(shape){
+        case 1: return sprintf(text, "set s%d trapezoid %.4f %.4f %.4f %.4f\n", name, a, center - 0.2*width, center + 0.2*width, b);
+        case 2: return sprintf(text, "set s%d left_shoulder %.4f %.4f %.4f\n", name, a, center, b);
+        case 3: return sprintf(text, "set s%d right_shoulder %.4f %.4f %.4f\n", name, a, center, b);
+        case 4: return sprintf(text, "set s%d gaussian %.4f %.4f\n", name, center, width*(0.3 + 0.3*testRandom()));
+        case 5: return sprintf(text, "set s%d singleton %.4f\n", name, center);
+        default: return sprintf(text, "set s%d %s %.4f %.4f %.4f\n", name, testShapeNames[shape], a, center, b);
+    }
+}
+
+/**
+ * @brief Writes random model text
+ * Model has 1 to 3 inputs and 1 or 2 outputs, output is Mamdani with
+ * random defuzzification method or Sugeno; operators, connectives,
+ * negations and weights of rules are random
+ * @param text model text (output)
+ * @param inLen number of inputs (output)
+ * @param outLen number of outputs (output)
+ * @param methods defuzzification methods of outputs, -1 for Sugeno (output)
+ * @return number of written characters
+ */
+int testRandomModel(char* text, int* inLen, int* outLen, int* methods){
+    int inputs = 1 + (int)(testRandom()*3);
+    int outputs = 1 + (int)(testRandom()*2);
+    int sets[3];
+    int outSets[2];
+    int rules = 5 + (int)(testRandom()*40);
+    int len = 0;
+    int conds = 0;
+    int connective = 0;
+    int i = 0;
+    int j = 0;
+
+    *inLen = inputs;
+    *outLen = outputs;
+    len += sprintf(text + len, "system %d %d\n", inputs, outputs);
+    for(i = 0; i < inputs; i++){
+        sets[i] = 2 + (int)(testRandom()*5);
+        len += sprintf(text + len, "input i%d %d\n", i, sets[i]);
+        for(j = 0; j < sets[i]; j++) len += testRandomSet(text + len, j, j, 1, 0);
+    }
+    for(i = 0; i < outputs; i++){
+        outSets[i] = testRandom() < 0.25 ? 0 : 2 + (int)(testRandom()*5);
+        methods[i] = -1;
+        if(outSets[i] == 0){
+            len += sprintf(text + len, "output o%d 0\n", i);
+            continue;
+        }
+        methods[i] = (int)(testRandom()*5);
+        len += sprintf(text + len, "output o%d %d %s\n", i, outSets[i], testDefuzzNames[methods[i]]);
+        for(j = 0; j < outSets[i]; j++) len += testRandomSet(text + len, j, 2*j, 1.5, 1);
+    }
+    if(testRandom() < 0.5){
+        len += sprintf(text + len, "operators %s %s %s %s\n", testOperatorNames[(int)(testRandom()*2)],
+                       testOperatorNames[2 + (int)(testRandom()*3)], testOperatorNames[(int)(testRandom()*2)],
+                       testOperatorNames[2 + (int)(testRandom()*3)]);
+    }
+
+    //rules
+    for(i = 0; i < rules; i++){
+        conds = 1 + (int)(testRandom()*inputs);
+        connective = testRandom() < 0.3;
+        len += sprintf(text + len, "rule if");
+        for(j = 0; j < conds; j++){
+            len += sprintf(text + len, "%s i%d is %ss%d", j == 0 ? "" : connective ? " or" : " and",
+                           j, testRandom() < 0.1 ? "not " : "", (int)(testRandom()*sets[j]));
+        }
+        j = (int)(testRandom()*outputs);
+        if(outSets[j] == 0) len += sprintf(text + len, " then o%d is %.3f + %.3f*i0", j, 2*testRandom() - 1, 2*testRandom() - 1);
+        else len += sprintf(text + len, " then o%d is s%d", j, (int)(testRandom()*outSets[j]));
+        len += sprintf(text + len, testRandom() < 0.2 ? " with %.2f\n" : "\n", 0.1 + 0.9*testRandom());
+    }
+    return len;
+}
+
+/**
+ * @brief Adds compared values of random model to result of engine
+ * @param engine index of engine (see testFuzz)
+ * @param reference reference values
+ * @param values values of engine
+ * @param count number of values
+ * @return 1 if values of model are within tolerance of engine
+ */
+int testFuzzCompare(int engine, const double* reference, const double* values, int count){
+    int undefined = 0;
+    int worst = 0;
+    double error = testError(reference, values, count, &undefined, &worst);
+
+    testFuzzValues[engine] += count;
+    testFuzzUndefined[engine] += undefined;
+    if(error > testFuzzErrors[engine]) testFuzzErrors[engine] = error;
+    if(error <= testFuzzTolerances[engine] && undefined == 0) return 1;
+    printf("    %s worst value %d: %.12g expected %.12g\n", testFuzzEngines[engine], worst, values[worst], reference[worst]);
+    return 0;
+}
+
+/**
+ * @brief Compares engines with each other on random models
+ * Engines calculating the same value have to give the same results,
+ * exact center of gravity is compared with FZZ_COG_STEP; one line is
+ * reported per engine, models of failed checks are printed
+ * @param models number of random models
+ */
+void testFuzz(int models){
+    static char text[65536];
+    TFzzSystem* sys = NULL;
+    TFzzSystem* other = NULL;
+    TFzzContext* ctx = NULL;
+    TFzzPool* pool = fzz_createPool(POOL_THREADS);
+    double inputs[FUZZ_SAMPLES*3];
+    double reference[FUZZ_SAMPLES*2];
+    double outputs[FUZZ_SAMPLES*2];
+    const char* simd = fzz_simd();
+    int methods[2];
+    int inLen = 0;
+    int outLen = 0;
+    int exact = 0;
+    int failed = 0;
+    int ok = 1;
+    int m = 0;
+    int i = 0;
+    int j = 0;
+
+    for(m = 0; m < models; m++){
+        testRandomModel(text, &inLen, &outLen, methods);
+        sys = testParse(text);
+        ctx = fzz_createContext(sys);
+        ok = 1;
+
+        //input vectors also outside of fuzzy sets, some of them hit centers 
+        //exactly, about half of inputs changes between neighbouring vectors
+        for(i = 0; i < FUZZ_SAMPLES*inLen; i++){
+            if(i >= inLen && testRandom() < 0.5) inputs[i] = inputs[i - inLen];
+            else inputs[i] = testRandom() < 0.05 ? (int)(testRandom()*7) : 7*testRandom() - 1;
+        }
+        for(i = 0; i < FUZZ_SAMPLES; i++) fzz_calculateOutputEx(sys, ctx, inputs + i*inLen, reference + i*outLen);
+
+        //engines calculating the same value
+        for(i = 0; i < FUZZ_SAMPLES; i++) fzz_updateOutputEx(sys, ctx, inputs + i*inLen, outputs + i*outLen);
+        ok &= testFuzzCompare(0, reference, outputs, FUZZ_SAMPLES*outLen);
+        for(i = 0; i < FUZZ_SAMPLES; i++)
+            for(j = 0; j < outLen; j++) outputs[i*outLen + j] = fzz_calculateOutputForEx(sys, ctx, inputs + i*inLen, j);
+        ok &= testFuzzCompare(1, reference, outputs, FUZZ_SAMPLES*outLen);
+        fzz_calculateBatchEx(sys, ctx, FUZZ_SAMPLES, inputs, outputs);
+        ok &= testFuzzCompare(2, reference, outputs, FUZZ_SAMPLES*outLen);
+        fzz_calculateBatchPoolEx(sys, pool, FUZZ_SAMPLES, inputs, outputs);
+        ok &= testFuzzCompare(3, reference, outputs, FUZZ_SAMPLES*outLen);
+        if(fzz_saveSystemEx(sys, SAVED_FILE) == 0 && (other = fzz_loadSystemEx(SAVED_FILE)) != NULL){
+            testBatch(other, FUZZ_SAMPLES, inputs, outputs);
+            ok &= testFuzzCompare(4, reference, outputs, FUZZ_SAMPLES*outLen);
+            fzz_destroy(other);
+        }else{
+            testFuzzUndefined[4]++;
+            ok = 0;
+        }
+        remove(SAVED_FILE);
+        other = testParse(text);
+        fzz_optimizeRulesEx(other, NULL);
+        testBatch(other, FUZZ_SAMPLES, inputs, outputs);
+        ok &= testFuzzCompare(5, reference, outputs, FUZZ_SAMPLES*outLen);
+        fzz_destroy(other);
+
+        //exact center of gravity instead of integration by steps
+        other = testParse(text);
+        exact = 0;
+        for(j = 0; j < outLen; j++){
+            if(methods[j] != FZZ_COG_STEP) continue;
+            fzz_setDefuzzMethodEx(other, j, FZZ_COG_EXACT);
+            exact = 1;
+        }
+        if(exact && strstr(text, "singleton") == NULL){
+            testBatch(other, FUZZ_SAMPLES, inputs, outputs);
+            ok &= testFuzzCompare(6, reference, outputs, FUZZ_SAMPLES*outLen);
+        }
+        fzz_destroy(other);
+
+        //other versions of fuzzification
+        for(i = 0; SIMD_EXACT && i < SIMD_LEVELS; i++){
+            if(strcmp(testSimdNames[i], simd) == 0 || fzz_setSimd(testSimdNames[i]) != 0) continue;
+            fzz_calculateBatchEx(sys, ctx, FUZZ_SAMPLES, inputs, outputs);
+            ok &= testFuzzCompare(7, reference, outputs, FUZZ_SAMPLES*outLen);
+        }
+        fzz_setSimd(simd);
+
+        if(!ok && failed++ < 5) printf("    model %d:\n%s", m, text);
+        fzz_destroyContext(ctx);
+        fzz_destroy(sys);
+    }
+
+    for(i = 0; i < FUZZ_ENGINES; i++)
+        testReport("fuzz", testFuzzEngines[i], testFuzzValues[i], testFuzzErrors[i], testFuzzUndefined[i], testFuzzTolerances[i]);
+    fzz_destroyPool(pool);
+}
+
+/**
+ * @brief Initializes input and output of test1 system again
+ * Rules wait until all their fuzzy sets are set again, then system
+ * has to give the same outputs; system with waiting rules can not be saved
+ */
+void testReinit(){
+    const TTestSurface* surface = &testSurfaces[0];
+    TFzzSystem* sys = testParse(surface->model);
+    double* inputs = testGrid(surface);
+    int points = testPoints(surface);
+    double* reference = (double*)malloc(sizeof(double)*points);
+    double* outputs = (double*)malloc(sizeof(double)*points);
+    int failed = 0;
+
+    testBatch(sys, points, inputs, reference);
+    fzz_initInputFcnsEx(sys, 0, 3, "input");
+    fzz_setInputFcnEx(sys, 0, 0, -2, -1, 0, "negative");
+    fzz_setInputFcnEx(sys, 1, 0, -1, 0, 1, "zero");
+    if(fzz_saveSystemEx(sys, SAVED_FILE) != -1) failed++;
+    fzz_setInputFcnEx(sys, 2, 0, 0, 1, 2, "pozitive");
+    fzz_initOutputFcnsEx(sys, 0, 3, "output");
+    fzz_setOutputFcnEx(sys, 0, 0, -2, -1, 0, "negative");
+    fzz_setOutputFcnEx(sys, 1, 0, -1, 0, 1, "zero");
+    fzz_setOutputFcnEx(sys, 2, 0, 0, 1, 2, "pozitive");
+    testBatch(sys, points, inputs, outputs);
+    testCompare(surface->name, "reinit", reference, outputs, points, 0);
+
+    //rules with fuzzy set which is not set again keep waiting
+    fzz_initInputFcnsEx(sys, 0, 2, "input");
+    fzz_setInputFcnEx(sys, 0, 0, -2, -1, 0, "negative");
+    fzz_setInputFcnEx(sys, 1, 0, 0, 1, 2, "pozitive");
+    if(fzz_saveSystemEx(sys, SAVED_FILE) != -1) failed++;
+    testReportCases(surface->name, "reinit_wait", 2, failed);
+    remove(SAVED_FILE);
+
+    free(inputs);
+    free(reference);
+    free(outputs);
+    fzz_destroy(sys);
+}
+
+/**
+ * @brief Calculates graph of two systems
+ * Output of test1 system is linked to the first input of test3 system,
+ * graph has to give the same outputs as chained calculation of nodes
+ */
+void testGraph(){
+    TFzzSystem* first = testParse(testSurfaces[0].model);
+    TFzzSystem* second = testParse(testSurfaces[2].model);
+    TFzzContext* firstCtx = fzz_createContext(first);
+    TFzzContext* secondCtx = fzz_createContext(second);
+    TFzzGraph* graph = fzz_createGraph();
+    double* inputs = testGrid(&testSurfaces[2]);
+    double* reference = NULL;
+    double* outputs = NULL;
+    double chained[2];
+    int points = testPoints(&testSurfaces[2]);
+    int i = 0;
+
+    fzz_addGraphNode(graph, first, "first");
+    fzz_addGraphNode(graph, second, "second");
+    if(fzz_linkGraph(graph, "first.output", "second.input1", 0) != 0 || fzz_graphInputs(graph) != 2 || fzz_graphOutputs(graph) != 2
+        || fzz_graphInputIndex(graph, "first.input") != 0 || fzz_graphInputIndex(graph, "second.input2") != 1){
+        printf("%-8s %-12s FAILED (graph can not be linked)\n", "graph", "crisp");
+        testFailures++;
+    }else{
+        reference = (double*)malloc(sizeof(double)*2*points);
+        outputs = (double*)malloc(sizeof(double)*2*points);
+        for(i = 0; i < points; i++){
+            fzz_calculateOutputEx(first, firstCtx, inputs + 2*i, reference + 2*i);
+            chained[0] = reference[2*i];
+            chained[1] = inputs[2*i + 1];
+            fzz_calculateOutputEx(second, secondCtx, chained, reference + 2*i + 1);
+            fzz_calculateGraph(graph, inputs + 2*i, outputs + 2*i);
+        }
+        testCompare("graph", "crisp", reference, outputs, 2*points, 0);
+        free(reference);
+        free(outputs);
+    }
+
+    free(inputs);
+    fzz_destroyGraph(graph);
+    fzz_destroyContext(firstCtx);
+    fzz_destroyContext(secondCtx);
+    fzz_destroy(first);
+    fzz_destroy(second);
+}
+
+/**
+ * @brief Calculates all points by reader of shared system
+ * Thread function
+ * @param data reader (TTestReader)
+ * @return NULL
+ */
+void* testReaderThread(void* data){
+    TTestReader* test = (TTestReader*)data;
+    TFzzReader* reader = fzz_createReader(test->shared);
+    double output = 0;
+    int r = 0;
+    int i = 0;
+
+    for(r = 0; r < SHARED_ROUNDS; r++){
+        for(i = 0; i < test->points; i++){
+            fzz_calculateOutputShared(reader, test->inputs + 2*i, &output);
+            if(output == test->first[i] || output == test->second[i]) continue;
+            if(output != output && (test->first[i] != test->first[i] || test->second[i] != test->second[i])) continue;
+            test->failed++;
+        }
+    }
+    fzz_destroyReader(reader);
+    #ifdef TEST_THREADS
+    __atomic_add_fetch(&testReadersDone, 1, __ATOMIC_SEQ_CST);
+    #endif
+    return NULL;
+}
+
+/**
+ * @brief Publishes systems of example and test3 in turn while readers calculate
+ * Without threads readers calculate between publications
+ */
+void testShared(){
+    const TTestSurface* surface = &testSurfaces[3];
+    TFzzSystem* first = testParse(testSurfaces[3].model);
+    TFzzSystem* second = testParse(testSurfaces[2].model);
+    TFzzShared* shared = NULL;
+    TTestReader readers[SHARED_READERS];
+    #ifdef TEST_THREADS
+    pthread_t threads[SHARED_READERS];
+    #endif
+    double* inputs = testGrid(surface);
+    int points = testPoints(surface);
+    double* outputs = (double*)malloc(sizeof(double)*2*points);
+    int publishes = 0;
+    int failed = 0;
+    int i = 0;
+
+    //outputs of both systems
+    testBatch(first, points, inputs, outputs);
+    testBatch(second, points, inputs, outputs + points);
+    shared = fzz_createShared(first);
+    fzz_destroy(second);
+    for(i = 0; i < SHARED_READERS; i++){
+        readers[i].shared = shared;
+        readers[i].inputs = inputs;
+        readers[i].first = outputs;
+        readers[i].second = outputs + points;
+        readers[i].points = points;
+        readers[i].failed = 0;
+    }
+
+    #ifdef TEST_THREADS
+    for(i = 0; i < SHARED_READERS; i++) pthread_create(&threads[i], NULL, testReaderThread, &readers[i]);
+    //systems are published until all readers finish
+    for(publishes = 0; publishes < SHARED_PUBLISHES || __atomic_load_n(&testReadersDone, __ATOMIC_SEQ_CST) < SHARED_READERS; publishes++)
+        fzz_publishShared(shared, testParse(testSurfaces[publishes % 2 == 0 ? 2 : 3].model));
+    for(i = 0; i < SHARED_READERS; i++) pthread_join(threads[i], NULL);
+    #else
+    for(publishes = 0; publishes < SHARED_READERS; publishes++){
+        fzz_publishShared(shared, testParse(testSurfaces[publishes % 2 == 0 ? 2 : 3].model));
+        testReaderThread(&readers[publishes]);
+    }
+    #endif
+    printf("    %d systems published\n", publishes);
+    for(i = 0; i < SHARED_READERS; i++) failed += readers[i].failed;
+    testReportCases("shared", "publish", SHARED_READERS*SHARED_ROUNDS*points, failed);
+
+    fzz_destroyShared(shared);
+    free(inputs);
+    free(outputs);
+}
+
+/**
+ * @brief Trains system of test1 to linear function
+ * Error has to fall at least to half, on calling thread and on pool
+ */
+void testTrain(){
+    TFzzSystem* sys = NULL;
+    TFzzTrainStats stats;
+    TFzzPool* pool = fzz_createPool(POOL_THREADS);
+    double inputs[TRAIN_SAMPLES];
+    double targets[TRAIN_SAMPLES];
+    double error = 0;
+    int failed = 0;
+    int p = 0;
+    int i = 0;
+
+    for(i = 0; i < TRAIN_SAMPLES; i++){
+        inputs[i] = -1.5 + 3.0*i/(TRAIN_SAMPLES - 1);
+        targets[i] = 0.4*inputs[i];
+    }
+    for(p = 0; p < 2; p++){
+        sys = testParse(testSurfaces[0].model);
+        memset(&stats, 0, sizeof(TFzzTrainStats));
+        error = fzz_trainEx(sys, p == 0 ? NULL : pool, TRAIN_SAMPLES, inputs, targets, NULL, &stats);
+        if(!(error >= 0 && error == stats.error && stats.error < 0.5*stats.initialError && stats.accepted > 0)){
+            printf("    %s: error %g from %g, %d accepted epochs\n", p == 0 ? "thread" : "pool", stats.error, stats.initialError, stats.accepted);
+            failed++;
+        }
+        fzz_destroy(sys);
+    }
+    testReportCases("train", "error", 2, failed);
+    fzz_destroyPool(pool);
+}
+
+/**
+ * @brief Parses invalid models
+ * Every model has to be rejected with error on expected line
+ */
+void testMalformed(){
+    TFzzSystem* sys = NULL;
+    const char* error = NULL;
+    int count = (int)(sizeof(testMalformedModels)/sizeof(testMalformedModels[0]));
+    int failed = 0;
+    int line = 0;
+    int i = 0;
+
+    for(i = 0; i < count; i++){
+        error = NULL;
+        sys = fzz_parseModelEx(testMalformedModels[i], &line, &error);
+        if(sys != NULL || error == NULL || line != testMalformedLines[i]){
+            printf("    model %d: line %d (%s), expected line %d\n", i, line, error != NULL ? error : "accepted", testMalformedLines[i]);
+            failed++;
+        }
+        if(sys != NULL) fzz_destroy(sys);
+    }
+    testReportCases("model", "malformed", count, failed);
+}
+
+/**
+ * @brief Writes memory to file
+ * @param file name of file
+ * @param data written data
+ * @param size size of data
+ */
+void testWriteFile(const char* file, const unsigned char* data, size_t size){
+    FILE* f = fopen(file, "wb");
+
+    if(f == NULL) return;
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+/**
+ * @brief Sets checksum of saved system file (FNV-1a)
+ * @param data file memory
+ * @param size size of file
+ */
+void testSeal(unsigned char* data, size_t size){
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+
+    memset(data + FILE_CHECKSUM_OFFSET, 0, sizeof(unsigned int));
+    for(i = FILE_HEADER_SIZE; i < size; i++) hash = (hash ^ data[i])*16777619u;
+    for(i = 0; i < FILE_HEADER_SIZE; i++) hash = (hash ^ data[i])*16777619u;
+    memcpy(data + FILE_CHECKSUM_OFFSET, &hash, sizeof(unsigned int));
+}
+
+/**
+ * @brief Loads saved system and calculates it
+ * Inputs are spread over range of golden surface, the last one is NaN;
+ * system with worst case above WORST_CASE_LIMIT is not calculated
+ * @param surface golden surface of saved system
+ * @return 1 if system was loaded, 0 if it was rejected
+ */
+int testLoadCalculate(const TTestSurface* surface){
+    TFzzSystem* sys = fzz_loadSystemEx(SAVED_FILE);
+    TFzzContext* ctx = NULL;
+    TFzzWorstCase report;
+    double inputs[2];
+    double outputs[2];
+    int i = 0;
+    int j = 0;
+
+    if(sys == NULL) return 0;
+    //valid system with huge number of samples is only slow
+    if(fzz_worstCaseEx(sys, &report) > WORST_CASE_LIMIT){
+        fzz_destroy(sys);
+        return 1;
+    }
+    ctx = fzz_createContext(sys);
+    for(i = 0; i <= 8; i++){
+        for(j = 0; j < surface->inputs; j++)
+            inputs[j] = i < 8 ? surface->from[j] + i*surface->steps[j]*surface->step[j]/7 : NAN;
+        fzz_calculateOutputEx(sys, ctx, inputs, outputs);
+        fzz_updateOutputEx(sys, ctx, inputs, outputs);
+        fzz_calculateOutputForEx(sys, ctx, inputs, 0);
+    }
+    fzz_destroyContext(ctx);
+    fzz_destroy(sys);
+    return 1;
+}
+
+/**
+ * @brief Loads corrupted and truncated copies of saved systems
+ * Every word of saved file (unbaked and baked) is changed to several 
+ * values; copy with checksum not fixed up has to be rejected, copy with
+ * fixed checksum has to be rejected or loaded and calculated (without
+ * crash), truncated copy has to be rejected
+ * @param surface golden surface of saved system
+ */
+void testCorrupted(const TTestSurface* surface){
+    TFzzSystem* sys = testParse(surface->model);
+    unsigned char* data = NULL;
+    unsigned char* copy = NULL;
+    unsigned int values[FILE_CORRUPTIONS];
+    unsigned int word = 0;
+    FILE* f = NULL;
+    long size = 0;
+    int count = 0;
+    int failed = 0;
+    int loaded = 0;
+    int baked = 0;
+    int i = 0;
+    int k = 0;
+
+    for(baked = 0; baked < 2; baked++){
+        if(baked) fzz_bakeEx(sys, 9);
+        if(fzz_saveSystemEx(sys, SAVED_FILE) != 0 || (f = fopen(SAVED_FILE, "rb")) == NULL){
+            testReportCases(surface->name, "corrupted", 1, 1);
+            break;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        rewind(f);
+        data = (unsigned char*)malloc(size);
+        copy = (unsigned char*)malloc(size);
+        if(fread(data, 1, size, f) != (size_t)size) failed++;
+        fclose(f);
+
+        //unchanged copy, also with checksum fixed up again
+        count += 2;
+        if(!testLoadCalculate(surface)) failed++;
+        memcpy(copy, data, size);
+        testSeal(copy, size);
+        testWriteFile(SAVED_FILE, copy, size);
+        if(!testLoadCalculate(surface)) failed++;
+
+        //changed words with and without fixed checksum
+        for(i = 0; i + (int)sizeof(unsigned int) <= size; i += sizeof(unsigned int)){
+            memcpy(&word, data + i, sizeof(unsigned int));
+            values[0] = 0;
+            values[1] = 1;
+            values[2] = 0xFFFFFFFFu;
+            values[3] = 0x7FFFFFFFu;
+            values[4] = 0x80000000u;
+            values[5] = word ^ 1;
+            values[6] = word + 1;
+            for(k = 0; k < FILE_CORRUPTIONS; k++){
+                if(values[k] == word || i == FILE_CHECKSUM_OFFSET) continue;
+                memcpy(copy, data, size);
+                memcpy(copy + i, &values[k], sizeof(unsigned int));
+                testWriteFile(SAVED_FILE, copy, size);
+                count++;
+                if(testLoadCalculate(surface)) failed++;
+                testSeal(copy, size);
+                testWriteFile(SAVED_FILE, copy, size);
+                count++;
+                loaded += testLoadCalculate(surface);
+            }
+        }
+
+        //truncated copies
+        for(i = 0; i < size; i += 7){
+            testWriteFile(SAVED_FILE, data, i);
+            count++;
+            if(testLoadCalculate(surface)) failed++;
+        }
+        free(data);
+        free(copy);
+    }
+    remove(SAVED_FILE);
+    fzz_destroy(sys);
+    printf("    %d corrupted copies with fixed checksum loaded\n", loaded);
+    testReportCases(surface->name, "corrupted", count, failed);
+}
+
+/**
+ * @brief Main function
+ * Compares engines with golden surfaces and with each other
+ */
+int main(int argc, const char* argv[]){
+    const char* file = GOLDEN_FILE;
+    FILE* f = NULL;
+    double* golden = NULL;
+    int update = 0;
+    int s = 0;
+    int i = 0;
+
+    for(i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--update") == 0) update = 1;
+        else file = argv[i];
+    }
+    if(update){
+        if(testUpdate(file) != 0){
+            fprintf(stderr, "Golden file %s can not be written\n", file);
+            return 2;
+        }
+        printf("Golden surfaces written to %s\n", file);
+        return 0;
+    }
+
+    printf("vector instructions: %s\n", fzz_simd());
+
+    //golden surfaces
+    f = fopen(file, "r");
+    if(f == NULL){
+        fprintf(stderr, "Golden file %s can not be read\n", file);
+        return 2;
+    }
+    for(s = 0; s < (int)(sizeof(testSurfaces)/sizeof(testSurfaces[0])); s++){
+        golden = testReadGolden(f, &testSurfaces[s]);
+        if(golden == NULL){
+            fprintf(stderr, "Golden file %s does not match surface %s\n", file, testSurfaces[s].name);
+            fclose(f);
+            return 2;
+        }
+        testSurface(&testSurfaces[s], golden);
+        free(golden);
+    }
+    fclose(f);
+
+    //random models
+    testFuzz(FUZZ_MODELS);
+
+    //input and output initialized again, graph, shared system and training
+    testReinit();
+    testGraph();
+    testShared();
+    testTrain();
+
+    //invalid models and saved systems
+    testMalformed();
+    testCorrupted(&testSurfaces[3]);
+
+    printf("%s: %d failed checks\n", testFailures == 0 ? "PASSED" : "FAILED", testFailures);
+    return testFailures == 0 ? 0 : 1;
+}